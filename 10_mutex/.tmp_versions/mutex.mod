@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/10_mutex/mutex.ko
-/home/xieli/linux/linux_drivers/10_mutex/mutex.o
@@ -1,52 +0,0 @@
-#include <linux/module.h>
-#include <linux/vermagic.h>
-#include <linux/compiler.h>
-
-MODULE_INFO(vermagic, VERMAGIC_STRING);
-
-__visible struct module __this_module
-__attribute__((section(".gnu.linkonce.this_module"))) = {
-	.name = KBUILD_MODNAME,
-	.init = init_module,
-#ifdef CONFIG_MODULE_UNLOAD
-	.exit = cleanup_module,
-#endif
-	.arch = MODULE_ARCH_INIT,
-};
-
-static const struct modversion_info ____versions[]
-__used
-__attribute__((section("__versions"))) = {
-	{ 0xfa985410, __VMLINUX_SYMBOL_STR(module_layout) },
-	{ 0x495be299, __VMLINUX_SYMBOL_STR(class_destroy) },
-	{ 0xe6e17706, __VMLINUX_SYMBOL_STR(device_destroy) },
-	{ 0x7485e15e, __VMLINUX_SYMBOL_STR(unregister_chrdev_region) },
-	{ 0xb37da9a1, __VMLINUX_SYMBOL_STR(cdev_del) },
-	{ 0xc2165d85, __VMLINUX_SYMBOL_STR(__arm_iounmap) },
-	{ 0x17d73699, __VMLINUX_SYMBOL_STR(device_create) },
-	{ 0x3c8c7d13, __VMLINUX_SYMBOL_STR(__class_create) },
-	{ 0xfeb25d8b, __VMLINUX_SYMBOL_STR(cdev_add) },
-	{ 0xb6828306, __VMLINUX_SYMBOL_STR(cdev_init) },
-	{ 0x29537c9e, __VMLINUX_SYMBOL_STR(alloc_chrdev_region) },
-	{ 0xd8e484f0, __VMLINUX_SYMBOL_STR(register_chrdev_region) },
-	{ 0xc61ff1f2, __VMLINUX_SYMBOL_STR(gpiod_direction_output_raw) },
-	{ 0xde6fb46c, __VMLINUX_SYMBOL_STR(of_get_named_gpio_flags) },
-	{ 0xfbed6f8c, __VMLINUX_SYMBOL_STR(of_find_node_opts_by_path) },
-	{ 0xf3bb59b5, __VMLINUX_SYMBOL_STR(__mutex_init) },
-	{ 0xfa2a45e, __VMLINUX_SYMBOL_STR(__memzero) },
-	{ 0xfbc74f64, __VMLINUX_SYMBOL_STR(__copy_from_user) },
-	{ 0x389329b3, __VMLINUX_SYMBOL_STR(gpiod_set_raw_value) },
-	{ 0x3089e8ae, __VMLINUX_SYMBOL_STR(gpio_to_desc) },
-	{ 0x27e1a049, __VMLINUX_SYMBOL_STR(printk) },
-	{ 0x1a9ebf5, __VMLINUX_SYMBOL_STR(mutex_lock_interruptible) },
-	{ 0x49fcab7e, __VMLINUX_SYMBOL_STR(mutex_unlock) },
-	{ 0xefd6cf06, __VMLINUX_SYMBOL_STR(__aeabi_unwind_cpp_pr0) },
-};
-
-static const char __module_depends[]
-__used
-__attribute__((section(".modinfo"))) =
-"depends=";
-
-
-MODULE_INFO(srcversion, "A4580466D19B25C874919C4");
@@ -16,8 +16,10 @@
 #include "sys/types.h"
 #include "sys/stat.h"
 #include "fcntl.h"
+#include "sys/ioctl.h"
 #include "stdlib.h"
 #include "string.h"
+#include "../common/led_lease.h"
 
 /* Private constants ---------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
@@ -40,7 +42,7 @@ int main(int argc, char *argv[])
 	unsigned char databuf = 0;
 	unsigned char cnt = 0;
 
-	if (argc != 3)
+	if ((argc != 3) && (argc != 4))
 	{
 		printf("Error usage!\r\n");
 		return -1;
@@ -56,6 +58,17 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	/* 驱动以shared=1加载时多个进程可同时打开，需要独占时租用LED */
+	if ((argc == 4) && (strcmp(argv[3], "lease") == 0))
+	{
+		if (ioctl(fd, LED_LEASE_ACQUIRE) < 0)
+		{
+			printf("LED lease failed!\r\n");
+			close(fd);
+			return -1;
+		}
+	}
+
 	databuf = atoi(argv[2]);
 	retvalue = write(fd, &databuf, sizeof(databuf));
 	if (retvalue < 0)
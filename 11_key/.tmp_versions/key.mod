@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/11_key/key.ko
-/home/xieli/linux/linux_drivers/11_key/key.o
@@ -28,8 +28,9 @@
 #include <asm/uaccess.h>
 #include <asm/io.h>
 
+#include "../common/drv_chrdev.h"
+
 /* Private constants ---------------------------------------------------------*/
-#define KEY_CNT			1			/*!< 设备号个数 */
 #define KEY_NAME		"key"	/*!< 设备名 */
 #define	KEY_VALUE		0xF0		/*!< 按键值 */
 #define INVALID_KEY		0x00		/*!< 无效值 */
@@ -37,12 +38,7 @@
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int key_gpio;			/*!< key的GPIO编号 */
 	atomic_t key_value;		/*!< 按键值 */
@@ -194,44 +190,19 @@ static int key_release(struct inode *inode, struct file *filp)
  *============================================================================*/
 static int __init _key_init(void)
 {
+	int ret = 0;
+
 	/* 初始化原子变量 */
 	atomic_set(&keydev.key_value, INVALID_KEY);
 
 	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (keydev.major)	/*!< 定义了设备号 */
-	{
-		keydev.devid = MKDEV(keydev.major, 0);
-		register_chrdev_region(keydev.devid, KEY_CNT, KEY_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&keydev.devid, 0, KEY_CNT, KEY_NAME);	/*!< 申请设备号 */
-		keydev.major = MAJOR(keydev.devid);	/*!< 获取主设备号 */
-		keydev.minor = MINOR(keydev.devid);	/*!< 获取次设备号 */
-	}
-	printk("keydev.major=%d, keydev.minor=%d\r\n", keydev.major, keydev.minor);
-
-	/* 2. 初始化cdev */
-	keydev.cdev.owner = THIS_MODULE;
-	cdev_init(&keydev.cdev, &keydev_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&keydev.cdev, keydev.devid, KEY_CNT);
-
-	/* 4. 创建类 */
-	keydev.class = class_create(THIS_MODULE, KEY_NAME);
-	if (IS_ERR(keydev.class))
-	{
-		return PTR_ERR(keydev.class);
-	}
-
-	/* 5. 创建设备 */
-	keydev.device = device_create(keydev.class, NULL, keydev.devid, NULL, KEY_NAME);
-	if (IS_ERR(keydev.device))
+	ret = drv_chrdev_add(&keydev.chrdev, NULL, KEY_NAME, &keydev_fops, &keydev);
+	if (ret < 0)
 	{
-		return PTR_ERR(keydev.device);
+		return ret;
 	}
+	printk("keydev.major=%d, keydev.minor=%d\r\n", keydev.chrdev.major,
+			MINOR(keydev.chrdev.devid));
 
 	return 0;
 }
@@ -245,12 +216,7 @@ static int __init _key_init(void)
  *============================================================================*/
 static void __exit _key_exit(void)
 {
-	/* 注销字符设备 */
-	cdev_del(&keydev.cdev);
-	unregister_chrdev_region(keydev.devid, KEY_CNT);
-
-	device_destroy(keydev.class, keydev.devid);
-	class_destroy(keydev.class);
+	drv_chrdev_del(&keydev.chrdev);
 }
 
 /**
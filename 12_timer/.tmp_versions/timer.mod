@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/12_timer/timer.ko
-/home/xieli/linux/linux_drivers/12_timer/timer.o
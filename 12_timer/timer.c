@@ -26,30 +26,31 @@
 #include <linux/of_gpio.h>
 #include <linux/semaphore.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 
+#include "../common/drv_chrdev.h"
+
 /* Private constants ---------------------------------------------------------*/
-#define TIMER_CNT		1			/*!< 设备号个数 */
 #define TIMER_NAME		"timer"		/*!< 设备名 */
 #define CLOSE_CMD		(_IO(0xEF, 0x1))	/*!< 关闭定时器 */
 #define OPEN_CMD		(_IO(0xEF, 0x2))	/*!< 打开定时器 */
-#define SETPERIOD_CMD	(_IO(0xEF, 0x3))	/*!< 设置定时器 */
+#define SETPERIOD_CMD	(_IO(0xEF, 0x3))	/*!< 设置定时器周期，单位us */
+#define DEFAULT_PERIOD_US	1000000			/*!< 默认周期1s */
+#define MIN_PERIOD_US		20				/*!< 最小周期，防止中断风暴 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int led_gpio;			/*!< LED的GPIO编号 */
-	int timer_period;		/*!< 定时器周期，ms */
-	struct timer_list timer;/*!< 定义一个定时器 */
+	u32 timer_period;		/*!< 定时器周期，us */
+	int led_state;			/*!< 当前LED电平 */
+	struct hrtimer timer;	/*!< 高精度定时器 */
 	spinlock_t lock;		/*!< 定义自旋锁 */
 }timer_dev_t;
 
@@ -133,7 +134,7 @@ static int timer_open(struct inode *inode, struct file *filp)
 
     filp->private_data = &timer;	/*!< 设置私有数据 */
 
-	timer.timer_period = 1000;	/*!< 周期1s */
+	timer.timer_period = DEFAULT_PERIOD_US;	/*!< 周期1s */
 	ret = led_init();
 	
 	return ret;
@@ -151,29 +152,34 @@ static int timer_open(struct inode *inode, struct file *filp)
 static long timer_unlocked_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	timer_dev_t *dev = (timer_dev_t*)filp->private_data;
-	int timer_period = 0;
+	u32 timer_period = 0;
 	unsigned long flags = 0;
 
 	switch (cmd)
 	{	
 	case CLOSE_CMD:
-		del_timer_sync(&dev->timer);
+		hrtimer_cancel(&dev->timer);
 		break;
 	case OPEN_CMD:
 		spin_lock_irqsave(&dev->lock, flags);
 		timer_period = dev->timer_period;
 		spin_unlock_irqrestore(&dev->lock, flags);
-		mod_timer(&dev->timer, jiffies + msecs_to_jiffies(timer_period));
+		/* 以绝对时间启动，后续到期点都以此为基准 */
+		hrtimer_start(&dev->timer, ktime_add_us(ktime_get(), timer_period), HRTIMER_MODE_ABS);
 		break;
 	case SETPERIOD_CMD:
+		if (arg < MIN_PERIOD_US)
+		{
+			return -EINVAL;
+		}
 		spin_lock_irqsave(&dev->lock, flags);
 		dev->timer_period = arg;
 		spin_unlock_irqrestore(&dev->lock, flags);
-		mod_timer(&dev->timer, jiffies + msecs_to_jiffies(arg));		
+		hrtimer_start(&dev->timer, ktime_add_us(ktime_get(), arg), HRTIMER_MODE_ABS);
 		break;
 
 	default:
-		break;
+		return -ENOTTY;
 	}
 
 	return 0;
@@ -182,26 +188,26 @@ static long timer_unlocked_ioctl(struct file *filp, unsigned int cmd, unsigned l
 /**=============================================================================
  * @brief           定时器回调函数
  *
- * @param[in]       none
+ * @param[in]       hrtimer:到期的定时器
  *
- * @return          none
+ * @return          HRTIMER_RESTART:继续运行
  *============================================================================*/
-static void timer_callback(unsigned long arg)
+static enum hrtimer_restart timer_callback(struct hrtimer *hrtimer)
 {
-	static int sta = 0;
-	int timer_period = 0;
+	u32 timer_period = 0;
 	unsigned long flags;
-	timer_dev_t *dev = (timer_dev_t *)arg;
+	timer_dev_t *dev = container_of(hrtimer, timer_dev_t, timer);
 	
-	gpio_set_value(dev->led_gpio, sta);
-	sta = !sta;
+	gpio_set_value(dev->led_gpio, dev->led_state);
+	dev->led_state = !dev->led_state;
 
-	/*!< 重启定时器 */
+	/*!< 在上一次到期点上累加周期，而不是相对当前时间，避免漂移 */
 	spin_lock_irqsave(&dev->lock, flags);
 	timer_period = dev->timer_period;
 	spin_unlock_irqrestore(&dev->lock, flags);
-	mod_timer(&dev->timer, jiffies + msecs_to_jiffies(dev->timer_period));
+	hrtimer_forward_now(hrtimer, ns_to_ktime((u64)timer_period * NSEC_PER_USEC));
 
+	return HRTIMER_RESTART;
 }
 
 /**=============================================================================
@@ -213,49 +219,23 @@ static void timer_callback(unsigned long arg)
  *============================================================================*/
 static int __init timer_init(void)
 {
+	int ret = 0;
+
 	/* 初始化自旋锁 */
 	spin_lock_init(&timer.lock);
 
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (timer.major)	/*!< 定义了设备号 */
-	{
-		timer.devid = MKDEV(timer.major, 0);
-		register_chrdev_region(timer.devid, TIMER_CNT, TIMER_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&timer.devid, 0, TIMER_CNT, TIMER_NAME);	/*!< 申请设备号 */
-		timer.major = MAJOR(timer.devid);	/*!< 获取主设备号 */
-		timer.minor = MINOR(timer.devid);	/*!< 获取次设备号 */
-	}
-	printk("timer.major=%d, timer.minor=%d\r\n", timer.major, timer.minor);
-
-	/* 2. 初始化cdev */
-	timer.cdev.owner = THIS_MODULE;
-	cdev_init(&timer.cdev, &timer_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&timer.cdev, timer.devid, TIMER_CNT);
-
-	/* 4. 创建类 */
-	timer.class = class_create(THIS_MODULE, TIMER_NAME);
-	if (IS_ERR(timer.class))
-	{
-		return PTR_ERR(timer.class);
-	}
+	/* 初始化timer，open之后就可能启动 */
+	hrtimer_init(&timer.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	timer.timer.function = timer_callback;
 
-	/* 5. 创建设备 */
-	timer.device = device_create(timer.class, NULL, timer.devid, NULL, TIMER_NAME);
-	if (IS_ERR(timer.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&timer.chrdev, NULL, TIMER_NAME, &timer_fops, &timer);
+	if (ret < 0)
 	{
-		return PTR_ERR(timer.device);
+		return ret;
 	}
-
-	/*6. 初始化timer */
-	init_timer(&timer.timer);
-	timer.timer.function = timer_callback;
-	timer.timer.data = (unsigned long)&timer;
+	printk("timer.major=%d, timer.minor=%d\r\n", timer.chrdev.major,
+			MINOR(timer.chrdev.devid));
 
 	return 0;
 }
@@ -269,18 +249,15 @@ static int __init timer_init(void)
  *============================================================================*/
 static void __exit timer_exit(void)
 {
+	/* 先注销设备，再停止定时器 */
+	drv_chrdev_del(&timer.chrdev);
+	hrtimer_cancel(&timer.timer);
+
 	iounmap(IMX6U_CCM_CCGR1);
 	iounmap(SW_MUX_GPIO1_IO03);
 	iounmap(SW_PAD_GPIO1_IO03);
 	iounmap(GPIO1_DR);
 	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&timer.cdev);
-	unregister_chrdev_region(timer.devid, TIMER_CNT);
-
-	device_destroy(timer.class, timer.devid);
-	class_destroy(timer.class);
 }
 
 /**
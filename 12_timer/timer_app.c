@@ -23,7 +23,7 @@
 /* Private constants ---------------------------------------------------------*/
 #define CLOSE_CMD		(_IO(0xEF, 0x1))	/*!< 关闭定时器 */
 #define OPEN_CMD		(_IO(0xEF, 0x2))	/*!< 打开定时器 */
-#define SETPERIOD_CMD	(_IO(0xEF, 0x3))	/*!< 设置定时器 */
+#define SETPERIOD_CMD	(_IO(0xEF, 0x3))	/*!< 设置定时器周期，单位us */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
@@ -90,7 +90,7 @@ int main(int argc, char *argv[])
 
 		case 3:
 			cmd = SETPERIOD_CMD;
-			printf("Input Timer Period:");
+			printf("Input Timer Period(us):");
 			ret = scanf("%d", &arg);
 			if (ret != 1)
 			{
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/13_irq/key_irq.ko
-/home/xieli/linux/linux_drivers/13_irq/key_irq.o
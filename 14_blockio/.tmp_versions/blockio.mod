@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/14_blockio/blockio.ko
-/home/xieli/linux/linux_drivers/14_blockio/blockio.o
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/15_noblockio/noblockio.ko
-/home/xieli/linux/linux_drivers/15_noblockio/noblockio.o
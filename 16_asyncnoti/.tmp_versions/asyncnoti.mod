@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/16_asyncnoti/asyncnoti.ko
-/home/xieli/linux/linux_drivers/16_asyncnoti/asyncnoti.o
@@ -30,12 +30,18 @@
 #include <linux/of_irq.h>
 #include <linux/semaphore.h>
 #include <linux/timer.h>
+#include <linux/mm.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 
+#include "../common/drv_chrdev.h"
+#include "../common/key_state.h"
+#include "../common/drv_evq.h"
+
 /* Private constants ---------------------------------------------------------*/
-#define KEYIRQ_CNT		1					/*!< 设备号个数 */
 #define KEYIRQ_NAME		"asyncnoti"			/*!< 设备名 */
 #define KEY0_VALUE       0x01            	/*!< 按键值 */
 #define INVALID_KEY     0xFF           		/*!< 无效值 */
@@ -52,22 +58,15 @@ typedef struct {
 }keyirq_desc_t;
 
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	atomic_t key_value;		/*!< 按键值 */
-	atomic_t release_key;	/*!< 释放的按键 */
 	struct timer_list timer;/*!< 定义一个定时器 */
 	keyirq_desc_t desc[KEY_NUM];	/*!< 按键描述数组 */
 	unsigned char cur_key;	/*!< 当前按键号 */
-
-	wait_queue_head_t r_wait;	/*!< 读等待队列头 */
-
-	struct fasync_struct *async_queue;	/*!< 异步相关结构体 */
+	key_state_page_t *state;	/*!< 按键状态页 */
+	drv_evq_t evq;			/*!< 松开事件队列，read/poll/SIGIO都从这里取 */
+	struct dentry *dbg;		/*!< debugfs目录 */
 }keyirq_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -79,12 +78,14 @@ static ssize_t keyirq_read(struct file *filp, char __user *buf, size_t cnt, loff
 unsigned int keyirq_poll(struct file *filp, struct poll_table_struct *wait);
 static int keyirq_fasync(int fd, struct file *filp, int on);
 static int keyirq_release(struct inode *node, struct file *filp);
+static int keyirq_mmap(struct file *filp, struct vm_area_struct *vma);
 static void timer_callback(unsigned long arg);
 
 static struct file_operations keyirq_fops = {
 	.owner = THIS_MODULE,
 	.open = keyirq_open,
 	.read = keyirq_read,
+	.mmap = keyirq_mmap,
 	.poll = keyirq_poll,
 	.fasync = keyirq_fasync,
 	.release = keyirq_release,
@@ -109,16 +110,43 @@ static irqreturn_t key0_handler(int irq, void *arg)
 }
 
 /**=============================================================================
- * @brief           KeyIO初始化
+ * @brief           释放前n个按键的中断和GPIO
  *
- * @param[in]       none
+ * @param[in]       n:已申请的按键数
+ * @param[in]		irqs:前n个按键中已申请中断的个数
  *
  * @return          none
  *============================================================================*/
+static void key_gpio_free(unsigned char n, unsigned char irqs)
+{
+	unsigned char i = 0;
+
+	for (i = 0; i < irqs; i++)
+	{
+		free_irq(keyirq.desc[i].irqnum, &keyirq);
+	}
+
+	/* 中断都已释放，不会再启动定时器 */
+	del_timer_sync(&keyirq.timer);
+
+	for (i = 0; i < n; i++)
+	{
+		gpio_free(keyirq.desc[i].gpio);
+	}
+}
+
+/**=============================================================================
+ * @brief           KeyIO初始化，失败时释放已申请的GPIO和中断
+ *
+ * @param[in]       none
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
 static int key_gpio_init(void)
 {
 	int ret = 0;
-	uint8_t i = 0;	
+	uint8_t i = 0;
+	uint8_t n = 0;
 
 	/* 设置KEY所使用的GPIO */
 	/* 1. 获取设备节点：keyirq */
@@ -140,21 +168,37 @@ static int key_gpio_init(void)
 		if (keyirq.desc[i].gpio < 0)
 		{
 			printk("can't get key-gpio[%d]\r\n", i);
+			return -EINVAL;
 		}
 	}
 
+	/* 定时器在中断处理函数中启动，要在申请中断之前初始化 */
+	init_timer(&keyirq.timer);
+	keyirq.timer.function = timer_callback;
+
 	/* 3. 设置KEY使用IO，并且设置中断模式 */
-	for (i = 0; i < KEY_NUM; i++)
+	for (n = 0; n < KEY_NUM; n++)
 	{
-		memset(keyirq.desc[i].name, 0, sizeof(keyirq.desc[i].name));
-		sprintf(keyirq.desc[i].name, "KEY%d", i);
-		gpio_request(keyirq.desc[i].gpio, keyirq.desc[i].name);
-		gpio_direction_input(keyirq.desc[i].gpio);
-		keyirq.desc[i].irqnum = irq_of_parse_and_map(keyirq.nd, i);
+		memset(keyirq.desc[n].name, 0, sizeof(keyirq.desc[n].name));
+		sprintf(keyirq.desc[n].name, "KEY%d", n);
+		ret = gpio_request(keyirq.desc[n].gpio, keyirq.desc[n].name);
+		if (ret < 0)
+		{
+			printk("can't request key-gpio[%d]\r\n", n);
+			goto fail_gpio;
+		}
+		gpio_direction_input(keyirq.desc[n].gpio);
+		keyirq.desc[n].irqnum = irq_of_parse_and_map(keyirq.nd, n);
 #if 0
-		keyirq.desc[i].irqnum = gpio_to_irq(keyirq.desc[i].gpio);
+		keyirq.desc[n].irqnum = gpio_to_irq(keyirq.desc[n].gpio);
 #endif
-		printk("key%d:gpio=%d, irqnum=%d\r\n", i, keyirq.desc[i].gpio, keyirq.desc[i].irqnum);
+		printk("key%d:gpio=%d, irqnum=%d\r\n", n, keyirq.desc[n].gpio, keyirq.desc[n].irqnum);
+		if (keyirq.desc[n].irqnum == 0)
+		{
+			gpio_free(keyirq.desc[n].gpio);
+			ret = -EINVAL;
+			goto fail_gpio;
+		}
 	}
 	keyirq.desc[0].handler = key0_handler;
 	keyirq.desc[0].value = KEY0_VALUE;
@@ -170,18 +214,18 @@ static int key_gpio_init(void)
 		if (ret < 0)
 		{
 			printk("irq %d request failed!\r\n", keyirq.desc[i].irqnum);
-			return -EFAULT;
+			goto fail_irq;
 		}
 	}
 
-	/* 创建定时器 */
-	init_timer(&keyirq.timer);
-	keyirq.timer.function = timer_callback;
-
-	/* 初始化等待队列头 */
-	init_waitqueue_head(&keyirq.r_wait);
-
 	return 0;
+
+fail_irq:
+	key_gpio_free(KEY_NUM, i);
+	return ret;
+fail_gpio:
+	key_gpio_free(n, 0);
+	return ret;
 }
 
 /**=============================================================================
@@ -194,63 +238,26 @@ static int key_gpio_init(void)
  *============================================================================*/
 static int keyirq_open(struct inode *inode, struct file *filp)
 {
-    filp->private_data = &keyirq;	/*!< 设置私有数据 */
+	filp->private_data = &keyirq;	/*!< 设置私有数据 */
 	
 	return 0;
 }
 
 /**=============================================================================
- * @brief           从设备读取数据
+ * @brief           从设备读取数据，每条记录为1字节的松开键值，一次可以读出多条
  *
- * @param[in]       none
+ * @param[in]       filp:设备文件
+ * @param[out]		buf:用户空间缓冲区
+ * @param[in]		cnt:缓冲区大小
+ * @param[in]		offt:未使用
  *
- * @return          none
+ * @return          读取的字节数;负数:失败
  *============================================================================*/
 static ssize_t keyirq_read(struct file *filp, char __user *buf, size_t cnt, loff_t *offt)
 {
-	int ret = 0;
-	unsigned char key_value = 0;
-	unsigned char release_key = 0;
-	keyirq_dev_t *dev = (keyirq_dev_t*)filp->private_data;	
-	
-	if (filp->f_flags & O_NONBLOCK)	/*!< 非阻塞访问 */
-	{
-		if (atomic_read(&dev->release_key) == 0)
-		{
-			return -EAGAIN;
-		}
-	}
-	else
-	{
-		ret = wait_event_interruptible(dev->r_wait, atomic_read(&dev->release_key));
-		if (ret)
-		{
-			return ret;
-		}
-	}
-
-	key_value = atomic_read(&dev->key_value);
-	release_key = atomic_read(&dev->release_key);
-
-	if (release_key)
-	{
-			if (key_value & 0x80)
-			{
-					key_value &= ~0x80;
-					ret = copy_to_user(buf, &key_value, sizeof(key_value));
-			}
-			else
-			{
-					return -EINVAL;
-			}
-			atomic_set(&dev->release_key, 0);
-	}
-	else
-	{
-			return -EINVAL;
-	}
+	keyirq_dev_t *dev = (keyirq_dev_t*)filp->private_data;
 
-	return 0;	
+	return drv_evq_read(&dev->evq, filp, buf, cnt);
 }
 
 /**=============================================================================
@@ -263,17 +270,9 @@ static ssize_t keyirq_read(struct file *filp, char __user *buf, size_t cnt, loff
  *============================================================================*/
 unsigned int keyirq_poll(struct file *filp, struct poll_table_struct *wait)
 {
-	unsigned int mask = 0;
 	keyirq_dev_t *dev = (keyirq_dev_t*)filp->private_data;
 
-	poll_wait(filp, &dev->r_wait, wait);
-
-	if (atomic_read(&dev->release_key))	
-	{	
-		mask = POLLIN | POLLRDNORM;
-	}
-
-	return mask;
+	return drv_evq_poll(&dev->evq, filp, wait);
 }
 
 /**=============================================================================
@@ -289,7 +288,7 @@ static int keyirq_fasync(int fd, struct file *filp, int on)
 {
 	keyirq_dev_t *dev = (keyirq_dev_t*)filp->private_data;
 
-	return fasync_helper(fd, filp, on, &dev->async_queue);
+	return drv_evq_fasync(fd, filp, on, &dev->evq);
 }
 
 /**=============================================================================
@@ -304,6 +303,21 @@ static int keyirq_release(struct inode *node, struct file *filp)
 	return keyirq_fasync(-1, filp, 0);	/*!< 删除异步通知 */
 }
 
+/**=============================================================================
+ * @brief           mmap函数，把按键状态页只读映射到用户空间
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		vma:用户空间虚拟内存区域
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int keyirq_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	keyirq_dev_t *dev = (keyirq_dev_t*)filp->private_data;
+
+	return key_state_mmap(dev->state, vma);
+}
+
 /**=============================================================================
  * @brief           定时器回调函数
  *
@@ -321,30 +335,15 @@ static void timer_callback(unsigned long arg)
 	key_desc = &dev->desc[num];
 	if (!gpio_get_value(key_desc->gpio))
 	{
+		key_state_update(dev->state, num, 1);
 		atomic_set(&dev->key_value, key_desc->value);
 	}
 	else
 	{
+		key_state_update(dev->state, num, 0);
 		atomic_set(&dev->key_value, 0x80 | key_desc->value);
-		atomic_set(&dev->release_key, 1);	/*!< 标记松开按键 */
-	}
-
-	if (atomic_read(&dev->release_key))
-	{
-		if (dev->async_queue)
-		{
-			kill_fasync(&dev->async_queue, SIGIO, POLL_IN);	/*!< 向应用程序发出信号 */
-		}
+		drv_evq_push(&dev->evq, key_desc->value);	/*!< 松开事件入队，唤醒读者并发出SIGIO */
 	}
-
-#if 0
-	/* 唤醒进程 */
-	if (atomic_read(&dev->release_key))
-	{
-		wake_up_interruptible(&dev->r_wait);
-	}
-#endif
-
 }
 
 /**=============================================================================
@@ -356,48 +355,45 @@ static void timer_callback(unsigned long arg)
  *============================================================================*/
 static int __init keyirq_init(void)
 {
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (keyirq.major)	/*!< 定义了设备号 */
-	{
-		keyirq.devid = MKDEV(keyirq.major, 0);
-		register_chrdev_region(keyirq.devid, KEYIRQ_CNT, KEYIRQ_NAME);
-	}
-	else					/*!< 未定义设备号 */
+	int ret = 0;
+
+	/* 申请按键状态页 */
+	keyirq.state = key_state_alloc();
+	if (keyirq.state == NULL)
 	{
-		alloc_chrdev_region(&keyirq.devid, 0, KEYIRQ_CNT, KEYIRQ_NAME);	/*!< 申请设备号 */
-		keyirq.major = MAJOR(keyirq.devid);	/*!< 获取主设备号 */
-		keyirq.minor = MINOR(keyirq.devid);	/*!< 获取次设备号 */
+		return -ENOMEM;
 	}
-	printk("keyirq.major=%d, keyirq.minor=%d\r\n", keyirq.major, keyirq.minor);
-
-	/* 2. 初始化cdev */
-	keyirq.cdev.owner = THIS_MODULE;
-	cdev_init(&keyirq.cdev, &keyirq_fops);
 
-	/* 3. 添加一个cdev */
-	cdev_add(&keyirq.cdev, keyirq.devid, KEYIRQ_CNT);
+	/* 事件队列要在中断申请之前初始化 */
+	drv_evq_init(&keyirq.evq, 1);
+	keyirq.dbg = debugfs_create_dir(KEYIRQ_NAME, NULL);
+	drv_evq_debugfs(&keyirq.evq, keyirq.dbg);
 
-	/* 4. 创建类 */
-	keyirq.class = class_create(THIS_MODULE, KEYIRQ_NAME);
-	if (IS_ERR(keyirq.class))
+	/* 初始化keyirq */
+	atomic_set(&keyirq.key_value, INVALID_KEY);
+	ret = key_gpio_init();
+	if (ret < 0)
 	{
-		return PTR_ERR(keyirq.class);
+		goto fail_state;
 	}
 
-	/* 5. 创建设备 */
-	keyirq.device = device_create(keyirq.class, NULL, keyirq.devid, NULL, KEYIRQ_NAME);
-	if (IS_ERR(keyirq.device))
+	/* 最后注册字符设备驱动，节点出现时中断已经就绪 */
+	ret = drv_chrdev_add(&keyirq.chrdev, NULL, KEYIRQ_NAME, &keyirq_fops, &keyirq);
+	if (ret < 0)
 	{
-		return PTR_ERR(keyirq.device);
+		goto fail_gpio;
 	}
-
-	/*6. 初始化keyirq */
-	atomic_set(&keyirq.key_value, INVALID_KEY);
-	atomic_set(&keyirq.release_key, 0);
-	key_gpio_init();
+	printk("keyirq.major=%d, keyirq.minor=%d\r\n", keyirq.chrdev.major,
+			MINOR(keyirq.chrdev.devid));
 
 	return 0;
+
+fail_gpio:
+	key_gpio_free(KEY_NUM, KEY_NUM);
+fail_state:
+	debugfs_remove_recursive(keyirq.dbg);
+	key_state_free(keyirq.state);
+	return ret;
 }
 
 /**=============================================================================
@@ -409,23 +405,13 @@ static int __init keyirq_init(void)
  *============================================================================*/
 static void __exit keyirq_exit(void)
 {
-	unsigned char i = 0;
-
-	/* 删除定时器 */
-	del_timer_sync(&keyirq.timer);
-
-	/* 释放中断 */
-	for (i = 0; i < KEY_NUM; i++)
-	{
-		free_irq(keyirq.desc[i].irqnum, &keyirq);
-	}
-
-	/* 注销字符设备 */
-	cdev_del(&keyirq.cdev);
-	unregister_chrdev_region(keyirq.devid, KEYIRQ_CNT);
+	/* 按申请的相反顺序：字符设备，中断、定时器和GPIO */
+	drv_chrdev_del(&keyirq.chrdev);
+	key_gpio_free(KEY_NUM, KEY_NUM);
+	debugfs_remove_recursive(keyirq.dbg);
 
-	device_destroy(keyirq.class, keyirq.devid);
-	class_destroy(keyirq.class);
+	/* 释放按键状态页 */
+	key_state_free(keyirq.state);
 }
 
 /**
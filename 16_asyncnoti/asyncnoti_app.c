@@ -32,7 +32,7 @@ static int fd = 0;
 /* Private function ----------------------------------------------------------*/
 
 /**=============================================================================
- * @brief           信号处理函数
+ * @brief           信号处理函数，每个事件为1字节的按键值，一次取出全部事件
  *
  * @param[in]       none
  *
@@ -40,17 +40,17 @@ static int fd = 0;
  *============================================================================*/
 static void sigio_signal_func(int signum)
 {
-	int err = 0;
-	unsigned int key_value = 0;
+	int i = 0;
+	ssize_t cnt = 0;
+	unsigned char key_value[32];
 
-	err = read(fd, &key_value, sizeof(key_value));
-	if (err < 0)
+	/* 非阻塞读，队列取空后返回-1(EAGAIN) */
+	while ((cnt = read(fd, key_value, sizeof(key_value))) > 0)
 	{
-
-	}
-	else
-	{
-		printf("sigio signal! key value=%d\r\n", key_value);	
+		for (i = 0; i < cnt; i++)
+		{
+			printf("sigio signal! key value=%d\r\n", key_value[i]);
+		}
 	}
 }
 
@@ -88,7 +88,7 @@ int main(int argc, char *argv[])
 	signal(SIGIO, sigio_signal_func);
 
 	fcntl(fd, F_SETOWN, getpid());	/*!< 将当前进程号告诉内核 */
-	flags = fcntl(fd, F_GETFD);	/*!< 获取当前的进程状态 */
+	flags = fcntl(fd, F_GETFL);	/*!< 获取当前的文件状态，保留O_NONBLOCK */
 	fcntl(fd, F_SETFL, flags | FASYNC);	/*!< 进程启用异步通知 */
 
 	while (1)
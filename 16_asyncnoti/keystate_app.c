@@ -0,0 +1,127 @@
+/**
+  ******************************************************************************
+  * @file			keystate_app.c
+  * @brief			通过mmap无系统调用采样按键状态
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-24
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "stdint.h"
+#include "sys/types.h"
+#include "sys/stat.h"
+#include "sys/mman.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+
+/* Private constants ---------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+#define READ_ONCE_U32(x)	(*(const volatile uint32_t*)&(x))
+
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 按键状态页，与驱动中的key_state_page_t一致
+*/
+typedef struct {
+	uint32_t seq;			/*!< 序列号，奇数表示正在更新 */
+	uint32_t keys;			/*!< 按键状态位图 */
+	uint32_t events;		/*!< 状态变化次数 */
+	uint32_t reserved;		/*!< 保留 */
+	uint64_t stamp_ns;		/*!< 最近一次变化的时间 */
+}key_state_page_t;
+
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           读取一份一致的按键状态快照
+ *
+ * @param[in]       state:映射的状态页
+ * @param[out]		snap:快照
+ *
+ * @return          none
+ *============================================================================*/
+static void key_state_snapshot(const key_state_page_t *state, key_state_page_t *snap)
+{
+	uint32_t seq = 0;
+
+	do
+	{
+		while ((seq = READ_ONCE_U32(state->seq)) & 1)	/*!< 写者正在更新 */
+		{
+		}
+		__sync_synchronize();
+		snap->keys = state->keys;
+		snap->events = state->events;
+		snap->stamp_ns = state->stamp_ns;
+		__sync_synchronize();
+	} while (READ_ONCE_U32(state->seq) != seq);
+
+	snap->seq = seq;
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int fd;
+	char *filename;
+	uint32_t last = 0;
+	key_state_page_t snap;
+	const key_state_page_t *state;
+
+	if (argc != 2)
+	{
+		printf("Error usage!\r\n");
+		return -1;
+	}
+
+	filename = argv[1];
+
+	/* 打开KEY驱动 */
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("Can't open file %s\r\n", filename);
+		return -1;
+	}
+
+	state = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+	if (state == MAP_FAILED)
+	{
+		printf("Can't mmap file %s\r\n", filename);
+		close(fd);
+		return -1;
+	}
+
+	/* 每10ms采样一次，只在状态变化时打印 */
+	while (1)
+	{
+		key_state_snapshot(state, &snap);
+		if (snap.events != last)
+		{
+			last = snap.events;
+			printf("keys=0x%08x events=%u stamp=%llu\r\n", snap.keys,
+					snap.events, (unsigned long long)snap.stamp_ns);
+		}
+		usleep(10000);
+	}
+
+	munmap((void*)state, sysconf(_SC_PAGESIZE));
+	close(fd);
+
+	return 0;
+}
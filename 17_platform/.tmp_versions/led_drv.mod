@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/17_platform/led_drv.ko
-/home/xieli/linux/linux_drivers/17_platform/led_drv.o
@@ -28,22 +28,22 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/drv_ref.h"
+#include "../common/gpio_pattern.h"
+#include "../common/led_bank.h"
+#include "../common/led_stats.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define GPIOLED_CNT		1			/*!< 设备号个数 */
 #define GPIOLED_NAME	"platled"	/*!< 设备名 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int led_gpio;			/*!< LED的GPIO编号 */
+	drv_ref_t ref;			/*!< 解绑后打开的文件返回-ENODEV */
 }led_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -54,11 +54,23 @@ static void __iomem *SW_PAD_GPIO1_IO03;
 static void __iomem *GPIO1_DR;
 static void __iomem *GPIO1_GDIR;
 
+static led_bank_t led_bank;
+static led_stats_t led_stats;
+static gpio_pattern_t led_pattern;	/*!< 波形序列器，所有LED一起闪 */
+
+static unsigned int led_pins = (1 << 3);	/*!< 管理的LED引脚，默认GPIO1_IO03 */
+module_param(led_pins, uint, S_IRUGO);
+MODULE_PARM_DESC(led_pins, "bitmask of GPIO1 pins driven as LEDs, pins other than IO03 must be muxed by pinctrl");
+
+static bool led_verify = false;	/*!< 写DR前回读，检查LED引脚并保留同一bank其他驱动的引脚 */
+module_param(led_verify, bool, S_IRUGO);
+MODULE_PARM_DESC(led_verify, "read GPIO1_DR before every write: warn when the LED pins were changed by someone else and keep the other pins current; needed when another driver toggles a pin on GPIO1");
 static led_dev_t leddev;
 
 /* Private function ----------------------------------------------------------*/
 static int led_open(struct inode *inode, struct file *flip);
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
 static int led_probe(struct platform_device *dev);
 static int led_remove(struct platform_device *dev);
 
@@ -66,6 +78,7 @@ static struct file_operations leddev_fops = {
 	.owner = THIS_MODULE,
 	.open = led_open,
 	.write = led_write,
+	.unlocked_ioctl = led_ioctl,
 };
 
 /* paltform驱动结构体 */
@@ -87,19 +100,20 @@ static struct platform_driver led_driver = {
  *============================================================================*/
 static void led_switch(uint8_t on)
 {
-	uint32_t val = 0;
-
-    val = readl(GPIO1_DR);
-	if (on)
-	{
-		val &= ~(1<<3);
-	}
-	else
-	{
-		val |= (1<<3);
-	}
+	led_bank_update(&led_bank, led_pins, on ? led_pins : 0);
+}
 
-    writel(val, GPIO1_DR);
+/**=============================================================================
+ * @brief           波形序列器的输出函数，在定时器回调中调用
+ *
+ * @param[in]       pat:序列器
+ * @param[in]		on:1---打开;0---关闭
+ *
+ * @return          none
+ *============================================================================*/
+static void led_pattern_output(gpio_pattern_t *pat, u32 on)
+{
+	led_switch(on);
 }
 
 /**=============================================================================
@@ -126,22 +140,66 @@ static int led_open(struct inode *inode, struct file *filp)
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
-	uint8_t databuf;
+	ssize_t ret = 0;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
+	ret = drv_ref_enter(&leddev.ref);
+	if (ret)
 	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
+		goto out;
 	}
 
-    printk("databuf=%d\r\n", databuf);
+	gpio_pattern_stop(&led_pattern);	/*!< 写开关值时退出波形模式 */
 
-	/* 开关LED */
-	databuf?led_switch(0):led_switch(1);
+	/* 1字节开关全部LED，或struct led_bank_cmd按掩码一次更新多个LED */
+	ret = led_bank_write(&led_bank, buf, cnt);
+	drv_ref_leave(&leddev.ref);
 
-	return 0;
+out:
+	led_stats_end(&led_stats, start, ret);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           ioctl函数，处理波形命令
+ *
+ * @param[in]       filp:设备文件
+ * @parma[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	long ret = 0;
+
+	ret = drv_ref_enter(&leddev.ref);
+	if (ret)
+	{
+		return ret;
+	}
+
+	ret = gpio_pattern_ioctl(&led_pattern, cmd, arg);
+	drv_ref_leave(&leddev.ref);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           取消寄存器映射
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void led_unmap(void)
+{
+	iounmap(IMX6U_CCM_CCGR1);
+	iounmap(SW_MUX_GPIO1_IO03);
+	iounmap(SW_PAD_GPIO1_IO03);
+	iounmap(GPIO1_DR);
+	iounmap(GPIO1_GDIR);
 }
 
 /**=============================================================================
@@ -153,6 +211,7 @@ static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt,
  *============================================================================*/
 static int led_probe(struct platform_device *dev)
 {
+	int ret = 0;
 	int i = 0;
 	int ressize[5];
 	u32 val = 0;
@@ -188,52 +247,30 @@ static int led_probe(struct platform_device *dev)
 	writel(5, SW_MUX_GPIO1_IO03);
 	writel(0x10B0, SW_PAD_GPIO1_IO03);
 
-	/* 4. 设置GPIO1_IO03输出功能 */
-	val = readl(GPIO1_DR);
-	val &= ~(1 << 3);
-	val |= (1 << 3);
+	/* 4. 设置LED引脚输出功能 */
+	val = readl(GPIO1_GDIR);
+	val |= led_pins;
 	writel(val, GPIO1_GDIR);
 
 	/* 5. 默认关闭LED */
-	val = readl(GPIO1_DR);
-	val |= (1 << 3);
-	writel(val, GPIO1_DR);
+	drv_ref_init(&leddev.ref);
+	led_bank_init(&led_bank, GPIO1_DR, led_pins, led_verify);
+	led_switch(0);
+	gpio_pattern_init(&led_pattern, -1);
+	gpio_pattern_set_output(&led_pattern, led_pattern_output, NULL);
 
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (leddev.major)	/*!< 定义了设备号 */
-	{
-		leddev.devid = MKDEV(leddev.major, 0);
-		register_chrdev_region(leddev.devid, GPIOLED_CNT, GPIOLED_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&leddev.devid, 0, GPIOLED_CNT, GPIOLED_NAME);	/*!< 申请设备号 */
-		leddev.major = MAJOR(leddev.devid);	/*!< 获取主设备号 */
-		leddev.minor = MINOR(leddev.devid);	/*!< 获取次设备号 */
-	}
-	printk("leddev.major=%d, leddev.minor=%d\r\n", leddev.major, leddev.minor);
-
-	/* 2. 初始化cdev */
-	leddev.cdev.owner = THIS_MODULE;
-	cdev_init(&leddev.cdev, &leddev_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&leddev.cdev, leddev.devid, GPIOLED_CNT);
+	led_stats_init(&led_stats, GPIOLED_NAME);
 
-	/* 4. 创建类 */
-	leddev.class = class_create(THIS_MODULE, GPIOLED_NAME);
-	if (IS_ERR(leddev.class))
-	{
-		return PTR_ERR(leddev.class);
-	}
-
-	/* 5. 创建设备 */
-	leddev.device = device_create(leddev.class, NULL, leddev.devid, NULL, GPIOLED_NAME);
-	if (IS_ERR(leddev.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&leddev.chrdev, &dev->dev, GPIOLED_NAME, &leddev_fops, &leddev);
+	if (ret < 0)
 	{
-		return PTR_ERR(leddev.device);
+		led_stats_exit(&led_stats);
+		led_unmap();
+		return ret;
 	}
+	printk("leddev.major=%d, leddev.minor=%d\r\n", leddev.chrdev.major,
+			MINOR(leddev.chrdev.devid));
 
 	return 0;
 }
@@ -247,18 +284,15 @@ static int led_probe(struct platform_device *dev)
  *============================================================================*/
 static int led_remove(struct platform_device *dev)
 {
-	iounmap(IMX6U_CCM_CCGR1);
-	iounmap(SW_MUX_GPIO1_IO03);
-	iounmap(SW_PAD_GPIO1_IO03);
-	iounmap(GPIO1_DR);
-	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&leddev.cdev);
-	unregister_chrdev_region(leddev.devid, GPIOLED_CNT);
-
-	device_destroy(leddev.class, leddev.devid);
-	class_destroy(leddev.class);	
+	/* 先注销设备，之后不会再有新的open；已经打开的文件在kill之后返回-ENODEV，
+	 * 不会再写DR或启动波形 */
+	drv_chrdev_del(&leddev.chrdev);
+	drv_ref_kill(&leddev.ref);
+	led_stats_exit(&led_stats);
+
+	gpio_pattern_stop(&led_pattern);	/*!< 定时器停止后才能解除映射 */
+	led_switch(0);
+	led_unmap();
 
 	return 0;
 }
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/18_dtsplatform/led_drv.ko
-/home/xieli/linux/linux_drivers/18_dtsplatform/led_drv.o
@@ -18,6 +18,8 @@
 #include "fcntl.h"
 #include "stdlib.h"
 #include "string.h"
+#include "sys/ioctl.h"
+#include "../common/gpio_pattern.h"
 
 /* Private constants ---------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
@@ -39,9 +41,11 @@ int main(int argc, char *argv[])
 	char *filename;
 	unsigned char databuf = 0;
 
-	if (argc != 3)
+	if ((argc != 3) && !((argc == 6) && !strcmp(argv[2], "blink")))
 	{
 		printf("Error usage!\r\n");
+		printf("  %s <dev> <0|1>\r\n", argv[0]);
+		printf("  %s <dev> blink <on_ms> <off_ms> <repeat>\r\n", argv[0]);
 		return -1;
 	}
 
@@ -55,6 +59,27 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (argc == 6)	/*!< 一次下发闪烁波形，由驱动定时播放 */
+	{
+		struct gpio_pattern_step steps[2];
+		struct gpio_pattern pattern;
+
+		steps[0].state = 1;
+		steps[0].duration_us = atoi(argv[3]) * 1000;
+		steps[1].state = 0;
+		steps[1].duration_us = atoi(argv[4]) * 1000;
+		pattern.count = 2;
+		pattern.repeat = atoi(argv[5]);
+		pattern.steps = (unsigned long)steps;
+		retvalue = ioctl(fd, GPIO_PATTERN_PLAY, &pattern);
+		if (retvalue < 0)
+		{
+			printf("LED pattern failed!\r\n");
+		}
+		close(fd);
+		return (retvalue < 0) ? -1 : 0;
+	}
+
 	databuf = atoi(argv[2]);
 	retvalue = write(fd, &databuf, sizeof(databuf));
 	if (retvalue < 0)
@@ -28,22 +28,30 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/drv_ref.h"
+#include "../common/led_pwm.h"
+#include "../common/gpio_pattern.h"
+#include "../common/led_stats.h"
+#include "../common/led_cmdq.h"
+
+#define CREATE_TRACE_POINTS
+#include "../common/led_trace.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define LEDDEV_CNT		1				/*!< 设备号个数 */
 #define LEDDEV_NAME		"dtsplatled"	/*!< 设备名 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int led_gpio;			/*!< LED的GPIO编号 */
+	led_pwm_t pwm;			/*!< 软件PWM引擎 */
+	gpio_pattern_t pattern;	/*!< 波形序列器 */
+	led_cmdq_t cmdq;		/*!< 异步命令队列 */
+	drv_ref_t ref;			/*!< 解绑后打开的文件返回-ENODEV；锁同时保证停一个引擎再启动另一个一次完成 */
+	led_stats_t stats;		/*!< write()计数 */
 }led_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -52,6 +60,8 @@ static led_dev_t leddev;
 /* Private function ----------------------------------------------------------*/
 static int led_open(struct inode *inode, struct file *flip);
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+static unsigned int led_poll(struct file *filp, struct poll_table_struct *wait);
 static int led_probe(struct platform_device *dev);
 static int led_remove(struct platform_device *dev);
 
@@ -59,6 +69,8 @@ static struct file_operations leddev_fops = {
 	.owner = THIS_MODULE,
 	.open = led_open,
 	.write = led_write,
+	.unlocked_ioctl = led_ioctl,
+	.poll = led_poll,
 };
 
 /* 匹配表 */
@@ -92,6 +104,32 @@ static int led_open(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           在工作队列中执行开关命令
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		value:开关值
+ * @param[in]		tag:未使用
+ *
+ * @return          none
+ *============================================================================*/
+static void led_apply(led_cmdq_t *q, u8 value, u32 tag)
+{
+	led_dev_t *dev = container_of(q, led_dev_t, cmdq);
+
+	if (drv_ref_enter(&dev->ref))	/*!< 设备已解绑，丢弃命令 */
+	{
+		return;
+	}
+
+	led_pwm_stop(&dev->pwm);	/*!< 写开关值时退出PWM和波形模式 */
+	gpio_pattern_stop(&dev->pattern);
+
+	/* 开关LED */
+	value?gpio_set_value(dev->led_gpio, 0):gpio_set_value(dev->led_gpio, 1);
+	drv_ref_leave(&dev->ref);
+}
+
 /**=============================================================================
  * @brief           向设备写数据
  *
@@ -101,22 +139,122 @@ static int led_open(struct inode *inode, struct file *filp)
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
+	ssize_t ret = 0;
 	uint8_t databuf;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
+	if (cnt != sizeof(databuf))
 	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
+		ret = -EINVAL;
+		goto out;
 	}
 
-    printk("databuf=%d\r\n", databuf);
+	if (copy_from_user(&databuf, buf, sizeof(databuf)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
 
-	/* 开关LED */
-	databuf?gpio_set_value(leddev.led_gpio, 0):gpio_set_value(leddev.led_gpio, 1);
+	trace_led_write(LEDDEV_NAME, databuf);
 
-	return 0;
+	/* 只入队，由工作队列写GPIO，write()不等待；在锁内入队，解绑后不会再有命令 */
+	while (1)
+	{
+		ret = drv_ref_enter(&leddev.ref);
+		if (ret)
+		{
+			goto out;
+		}
+		ret = led_cmdq_push(&leddev.cmdq, databuf, 0, true);
+		drv_ref_leave(&leddev.ref);
+
+		if ((ret != -EAGAIN) || (filp->f_flags & O_NONBLOCK))
+		{
+			break;
+		}
+
+		/* 队列满，执行函数要拿同一把锁，放开锁等待 */
+		ret = led_cmdq_wait(&leddev.cmdq);
+		if (ret)
+		{
+			goto out;
+		}
+	}
+
+	if (ret == 0)
+	{
+		ret = cnt;
+	}
+
+out:
+	led_stats_end(&leddev.stats, start, ret);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           ioctl函数，处理PWM和波形命令
+ *
+ * @param[in]       filp:设备文件
+ * @parma[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	long ret = 0;
+	led_dev_t *dev = filp->private_data;
+
+	/* 先执行完排队的开关命令，保持顺序；执行函数要拿dev->ref的锁，不能在锁内flush */
+	led_cmdq_flush(&dev->cmdq);
+
+	/* PWM和波形共用一个GPIO，启动一个前先停掉另一个，在锁内完成 */
+	ret = drv_ref_enter(&dev->ref);
+	if (ret)
+	{
+		return ret;
+	}
+
+	switch (cmd)
+	{
+	case GPIO_PATTERN_PLAY:
+		led_pwm_stop(&dev->pwm);
+		ret = gpio_pattern_ioctl(&dev->pattern, cmd, arg);
+		break;
+
+	case GPIO_PATTERN_STOP:
+		ret = gpio_pattern_ioctl(&dev->pattern, cmd, arg);
+		break;
+
+	case LED_PWM_SET:
+		gpio_pattern_stop(&dev->pattern);
+		ret = led_pwm_ioctl(&dev->pwm, cmd, arg);
+		break;
+
+	default:
+		ret = led_pwm_ioctl(&dev->pwm, cmd, arg);
+		break;
+	}
+
+	drv_ref_leave(&dev->ref);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           poll函数，命令队列有空位时可写
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          设备状态
+ *============================================================================*/
+static unsigned int led_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	led_dev_t *dev = filp->private_data;
+
+	return led_cmdq_poll(&dev->cmdq, filp, wait);
 }
 
 /**=============================================================================
@@ -128,6 +266,8 @@ static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt,
  *============================================================================*/
 static int led_probe(struct platform_device *dev)
 {
+	int ret = 0;
+
 	printk("led driver and device has matched!\r\n");
 
 #if 0
@@ -171,42 +311,6 @@ static int led_probe(struct platform_device *dev)
 	writel(val, GPIO1_DR);
 #endif	
 
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (leddev.major)	/*!< 定义了设备号 */
-	{
-		leddev.devid = MKDEV(leddev.major, 0);
-		register_chrdev_region(leddev.devid, LEDDEV_CNT, LEDDEV_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&leddev.devid, 0, LEDDEV_CNT, LEDDEV_NAME);	/*!< 申请设备号 */
-		leddev.major = MAJOR(leddev.devid);	/*!< 获取主设备号 */
-		leddev.minor = MINOR(leddev.devid);	/*!< 获取次设备号 */
-	}
-	printk("leddev.major=%d, leddev.minor=%d\r\n", leddev.major, leddev.minor);
-
-	/* 2. 初始化cdev */
-	leddev.cdev.owner = THIS_MODULE;
-	cdev_init(&leddev.cdev, &leddev_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&leddev.cdev, leddev.devid, LEDDEV_CNT);
-
-	/* 4. 创建类 */
-	leddev.class = class_create(THIS_MODULE, LEDDEV_NAME);
-	if (IS_ERR(leddev.class))
-	{
-		return PTR_ERR(leddev.class);
-	}
-
-	/* 5. 创建设备 */
-	leddev.device = device_create(leddev.class, NULL, leddev.devid, NULL, LEDDEV_NAME);
-	if (IS_ERR(leddev.device))
-	{
-		return PTR_ERR(leddev.device);
-	}
-
 	/* 6. IO初始化 */
 	leddev.nd = of_find_node_by_path("/gpioled");
 	if (!leddev.nd)
@@ -225,8 +329,31 @@ static int led_probe(struct platform_device *dev)
 	{
 		printk("led-gpio num = %d\r\n", leddev.led_gpio);
 	}
-	gpio_request(leddev.led_gpio, "gpio");
+	ret = gpio_request(leddev.led_gpio, "gpio");
+	if (ret < 0)
+	{
+		printk("can't request led-gpio\r\n");
+		return ret;
+	}
 	gpio_direction_output(leddev.led_gpio, 1);	/*!< 输出，默认高电平 */
+	drv_ref_init(&leddev.ref);
+	led_pwm_init(&leddev.pwm, leddev.led_gpio);
+	gpio_pattern_init(&leddev.pattern, leddev.led_gpio);
+	led_cmdq_init(&leddev.cmdq, LEDDEV_NAME, led_apply);
+
+	led_stats_init(&leddev.stats, LEDDEV_NAME);
+
+	/* 7. 最后创建设备节点 */
+	ret = drv_chrdev_add(&leddev.chrdev, &dev->dev, LEDDEV_NAME, &leddev_fops, &leddev);
+	if (ret < 0)
+	{
+		led_stats_exit(&leddev.stats);
+		led_cmdq_exit(&leddev.cmdq);
+		gpio_free(leddev.led_gpio);
+		return ret;
+	}
+	printk("leddev.major=%d, leddev.minor=%d\r\n", leddev.chrdev.major,
+			MINOR(leddev.chrdev.devid));
 
 	return 0;
 }
@@ -240,14 +367,17 @@ static int led_probe(struct platform_device *dev)
  *============================================================================*/
 static int led_remove(struct platform_device *dev)
 {
+	/* 先注销设备，之后不会再有新的open；已经打开的文件在kill之后返回-ENODEV，
+	 * 不会再入队命令或启动PWM、波形，排队的命令由执行函数丢弃 */
+	drv_chrdev_del(&leddev.chrdev);
+	drv_ref_kill(&leddev.ref);
+	led_stats_exit(&leddev.stats);
+	led_cmdq_exit(&leddev.cmdq);
+
+	led_pwm_stop(&leddev.pwm);
+	gpio_pattern_stop(&leddev.pattern);
 	gpio_set_value(leddev.led_gpio, 1);	/*!< 卸载关闭LED */
-	
-	/* 注销字符设备 */
-	cdev_del(&leddev.cdev);
-	unregister_chrdev_region(leddev.devid, LEDDEV_CNT);
-
-	device_destroy(leddev.class, leddev.devid);
-	class_destroy(leddev.class);	
+	gpio_free(leddev.led_gpio);
 
 	return 0;
 }
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/19_miscbeep/miscbeep.ko
-/home/xieli/linux/linux_drivers/19_miscbeep/miscbeep.o
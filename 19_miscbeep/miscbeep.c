@@ -29,6 +29,14 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_ref.h"
+#include "../common/gpio_pattern.h"
+#include "../common/beep_tone.h"
+#include "../common/led_stats.h"
+#include "../common/led_cmdq.h"
+
+#define CREATE_TRACE_POINTS
+#include "../common/led_trace.h"
 
 /* Private constants ---------------------------------------------------------*/
 #define MISCBEEP_NAME		"miscbeep"		/*!< 设备名 */
@@ -43,6 +51,11 @@ typedef struct {
 	struct device *device;	/*!< 设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int beep_gpio;			/*!< beep的GPIO编号 */
+	gpio_pattern_t pattern;	/*!< 波形序列器 */
+	beep_tone_t tone;		/*!< 音调发生器 */
+	led_cmdq_t cmdq;		/*!< 异步命令队列 */
+	drv_ref_t ref;			/*!< 解绑后打开的文件返回-ENODEV；锁同时保证停一个引擎再启动另一个一次完成 */
+	led_stats_t stats;		/*!< write()计数 */
 }miscbeep_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -51,12 +64,16 @@ static miscbeep_dev_t miscbeep;
 /* Private function ----------------------------------------------------------*/
 static int miscbeep_open(struct inode *inode, struct file *flip);
 static ssize_t miscbeep_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static long miscbeep_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+static unsigned int miscbeep_poll(struct file *filp, struct poll_table_struct *wait);
 
 /* 设备操作函数 */
 static struct file_operations miscbeep_fops = {
 	.owner = THIS_MODULE,
 	.open = miscbeep_open,
 	.write = miscbeep_write,
+	.unlocked_ioctl = miscbeep_ioctl,
+	.poll = miscbeep_poll,
 };
 
 /* misc设备结构体 */
@@ -81,6 +98,30 @@ static int miscbeep_open(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           在工作队列中执行开关命令
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		value:开关值
+ * @param[in]		tag:未使用
+ *
+ * @return          none
+ *============================================================================*/
+static void miscbeep_apply(led_cmdq_t *q, u8 value, u32 tag)
+{
+	miscbeep_dev_t *dev = container_of(q, miscbeep_dev_t, cmdq);
+
+	if (drv_ref_enter(&dev->ref))	/*!< 设备已解绑，丢弃命令 */
+	{
+		return;
+	}
+
+	gpio_pattern_stop(&dev->pattern);	/*!< 写开关值时停止波形和音调 */
+	beep_tone_stop(&dev->tone);
+	value?gpio_set_value(dev->beep_gpio, 0):gpio_set_value(dev->beep_gpio, 1);
+	drv_ref_leave(&dev->ref);
+}
+
 /**=============================================================================
  * @brief           向设备写数据
  *
@@ -90,22 +131,137 @@ static int miscbeep_open(struct inode *inode, struct file *filp)
  *============================================================================*/
 static ssize_t miscbeep_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int ret = 0;
+	ssize_t ret = 0;
 
 	unsigned char databuf;
 	miscbeep_dev_t *dev = filp->private_data;
+	u64 start = led_stats_begin();
 
-	ret = copy_from_user(&databuf, buf, cnt);
-	if (ret < 0)
+	if (cnt != sizeof(databuf))
 	{
-		printk("kernel write failed!\r\n");
-		return -EFAULT;
+		ret = -EINVAL;
+		goto out;
 	}
 
-	databuf?gpio_set_value(dev->beep_gpio, 0):gpio_set_value(dev->beep_gpio, 1);
+	if (copy_from_user(&databuf, buf, sizeof(databuf)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
 
-	return 0;
+	trace_led_write(MISCBEEP_NAME, databuf);
+
+	/* 只入队，由工作队列写GPIO，write()不等待；在锁内入队，解绑后不会再有命令 */
+	while (1)
+	{
+		ret = drv_ref_enter(&dev->ref);
+		if (ret)
+		{
+			goto out;
+		}
+		ret = led_cmdq_push(&dev->cmdq, databuf, 0, true);
+		drv_ref_leave(&dev->ref);
+
+		if ((ret != -EAGAIN) || (filp->f_flags & O_NONBLOCK))
+		{
+			break;
+		}
+
+		/* 队列满，执行函数要拿同一把锁，放开锁等待 */
+		ret = led_cmdq_wait(&dev->cmdq);
+		if (ret)
+		{
+			goto out;
+		}
+	}
+
+	if (ret == 0)
+	{
+		ret = cnt;
+	}
+
+out:
+	led_stats_end(&dev->stats, start, ret);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           ioctl函数，处理波形和音调命令
+ *
+ * @param[in]       filp:设备文件
+ * @parma[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static long miscbeep_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	long ret = 0;
+	miscbeep_dev_t *dev = filp->private_data;
+
+	/* 先执行完排队的开关命令，保持顺序；执行函数要拿dev->ref的锁，不能在锁内flush */
+	led_cmdq_flush(&dev->cmdq);
+
+	while (1)
+	{
+		/* 波形和音调共用蜂鸣器，启动一个前先停掉另一个，在锁内完成 */
+		ret = drv_ref_enter(&dev->ref);
+		if (ret)
+		{
+			return ret;
+		}
+
+		switch (cmd)
+		{
+		case GPIO_PATTERN_PLAY:
+			beep_tone_stop(&dev->tone);
+			ret = gpio_pattern_ioctl(&dev->pattern, cmd, arg);
+			break;
+
+		case BEEP_TONE_QUEUE:	/*!< 队列满时不在锁内等待，否则解绑要等音符播完 */
+			gpio_pattern_stop(&dev->pattern);
+			ret = beep_tone_ioctl(&dev->tone, cmd, arg, true);
+			break;
+
+		case BEEP_TONE_STOP:
+			ret = beep_tone_ioctl(&dev->tone, cmd, arg, true);
+			break;
+
+		default:
+			ret = gpio_pattern_ioctl(&dev->pattern, cmd, arg);
+			break;
+		}
+
+		drv_ref_leave(&dev->ref);
+
+		if ((ret != -EAGAIN) || (cmd != BEEP_TONE_QUEUE) || (filp->f_flags & O_NONBLOCK))
+		{
+			return ret;
+		}
 
+		/* 放开锁等待音符播出，解绑时beep_tone_stop会唤醒这里 */
+		ret = beep_tone_wait(&dev->tone, (const void __user *)arg);
+		if (ret)
+		{
+			return ret;
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           poll函数，命令队列有空位时可写
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          设备状态
+ *============================================================================*/
+static unsigned int miscbeep_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	miscbeep_dev_t *dev = filp->private_data;
+
+	return led_cmdq_poll(&dev->cmdq, filp, wait);
 }
 
 /**=============================================================================
@@ -143,13 +299,22 @@ static int miscbeep_probe(struct platform_device *dev)
 	{
 		printk("can't set gpio!\r\n");
 	}	
+	drv_ref_init(&miscbeep.ref);
+	gpio_pattern_init(&miscbeep.pattern, miscbeep.beep_gpio);
+	beep_tone_init(&miscbeep.tone, miscbeep.beep_gpio);
+	led_cmdq_init(&miscbeep.cmdq, MISCBEEP_NAME, miscbeep_apply);
+	led_stats_init(&miscbeep.stats, MISCBEEP_NAME);
 
-	/* 注册misc设备驱动 */
+	/* 最后注册misc设备驱动，节点出现时引擎已经就绪 */
 	ret = misc_register(&beep_miscdev);
 	if (ret < 0)
 	{
 		printk("misc device register failed!\r\n");
-		return -EFAULT;
+		led_stats_exit(&miscbeep.stats);
+		led_cmdq_exit(&miscbeep.cmdq);
+		gpio_pattern_stop(&miscbeep.pattern);
+		beep_tone_stop(&miscbeep.tone);
+		return ret;
 	}
 
 	return 0;
@@ -164,11 +329,18 @@ static int miscbeep_probe(struct platform_device *dev)
  *============================================================================*/
 static int miscbeep_remove(struct platform_device *dev)
 {
-	/* 注销设备关闭LED */
-	gpio_set_value(miscbeep.beep_gpio, 1);
-
-	/* 注销misc设备驱动 */
+	/* 先注销misc设备，之后不会再有新的open；已经打开的文件在kill之后
+	 * 返回-ENODEV，不会再入队命令或重新启动波形和音调的定时器，
+	 * 排队的命令由执行函数丢弃 */
 	misc_deregister(&beep_miscdev);
+	drv_ref_kill(&miscbeep.ref);
+	led_stats_exit(&miscbeep.stats);
+	led_cmdq_exit(&miscbeep.cmdq);
+
+	/* 停止波形和音调，关闭蜂鸣器 */
+	gpio_pattern_stop(&miscbeep.pattern);
+	beep_tone_stop(&miscbeep.tone);
+	gpio_set_value(miscbeep.beep_gpio, 1);
 
 	return 0;
 }
@@ -18,11 +18,28 @@
 #include "fcntl.h"
 #include "stdlib.h"
 #include "string.h"
+#include "sys/ioctl.h"
+#include "../common/gpio_pattern.h"
+#include "../common/beep_tone.h"
 
 /* Private constants ---------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+/* 报警音：三短一长 */
+static struct gpio_pattern_step alarm_steps[] = {
+	{1, 100000}, {0, 100000},
+	{1, 100000}, {0, 100000},
+	{1, 100000}, {0, 100000},
+	{1, 500000}, {0, 1000000},
+};
+
+/* 警笛：高低两个音交替，由驱动定时翻转GPIO，应用程序不再每半个周期唤醒一次 */
+static struct beep_note siren_notes[] = {
+	{960, 400}, {770, 400}, {960, 400}, {770, 400},
+	{960, 400}, {770, 400}, {0, 200},
+};
+
 /* Private function ----------------------------------------------------------*/
 
 /**=============================================================================
@@ -42,6 +59,7 @@ int main(int argc, char *argv[])
 	if (argc != 3)
 	{
 		printf("Error usage!\r\n");
+		printf("  %s <dev> <0|1|alarm|siren>\r\n", argv[0]);
 		return -1;
 	}
 
@@ -55,6 +73,38 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (!strcmp(argv[2], "alarm"))	/*!< 一次下发报警波形，重复3遍 */
+	{
+		struct gpio_pattern pattern;
+
+		pattern.count = sizeof(alarm_steps) / sizeof(alarm_steps[0]);
+		pattern.repeat = 3;
+		pattern.steps = (unsigned long)alarm_steps;
+		retvalue = ioctl(fd, GPIO_PATTERN_PLAY, &pattern);
+		if (retvalue < 0)
+		{
+			printf("BEEP pattern failed!\r\n");
+		}
+		close(fd);
+		return (retvalue < 0) ? -1 : 0;
+	}
+
+	if (!strcmp(argv[2], "siren"))	/*!< 音符放入驱动的队列，ioctl立即返回 */
+	{
+		struct beep_tone tone;
+
+		memset(&tone, 0, sizeof(tone));
+		tone.count = sizeof(siren_notes) / sizeof(siren_notes[0]);
+		tone.notes = (unsigned long)siren_notes;
+		retvalue = ioctl(fd, BEEP_TONE_QUEUE, &tone);
+		if (retvalue < 0)
+		{
+			printf("BEEP tone failed!\r\n");
+		}
+		close(fd);
+		return (retvalue < 0) ? -1 : 0;
+	}
+
 	databuf = atoi(argv[2]);
 	retvalue = write(fd, &databuf, sizeof(databuf));
 	if (retvalue < 0)
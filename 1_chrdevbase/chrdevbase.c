@@ -1,10 +1,10 @@
 /**
   ******************************************************************************
   * @file			chrdevbase.c
-  * @brief			chrdevbase function
+  * @brief			chrdevbase function，内核环形缓冲，可作为内核与用户空间之间的管道
   * @author			Xli
   * @email			xieliyzh@163.com
-  * @version		1.0.0
+  * @version		1.1.0
   * @date			2020-03-17
   * @copyright		2020, XIELI Co.,Ltd. All rights reserved
   ******************************************************************************
@@ -17,32 +17,83 @@
 #include <linux/ide.h>
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/gfp.h>
+#include <linux/kfifo.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/splice.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#include "../common/drv_chrdev.h"
 
 /* Private constants ---------------------------------------------------------*/
 #define CHRDEVBASE_MAJOR	200				/*!< 主设备号 */
 #define CHRDEVBASE_NAME		"chrdevbase"	/*!< 设备名 */
 
+#define CHRDEVBASE_MIN_SIZE	PAGE_SIZE		/*!< 最小缓冲区 */
+#define CHRDEVBASE_MAX_SIZE	(16 << 20)		/*!< 最大缓冲区 */
+
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 设备结构体
+*
+* kfifo在单读者单写者时无需加锁，rd_lock/wr_lock分别把多个读者和多个写者串行化，
+* 读写两端可以同时进行
+*/
+typedef struct {
+	drv_chrdev_t chrdev;		/*!< 字符设备 */
+	struct kfifo fifo;			/*!< 环形缓冲 */
+	void *buf;					/*!< fifo的存储区 */
+	struct mutex rd_lock;		/*!< 串行化读者 */
+	struct mutex wr_lock;		/*!< 串行化写者 */
+	wait_queue_head_t r_wait;	/*!< 等待有数据 */
+	wait_queue_head_t w_wait;	/*!< 等待有空间 */
+}chrdevbase_dev_t;
+
 /* Private variables ---------------------------------------------------------*/
-static char readbuf[100];	/*!< 读缓冲区 */
-static char writebuf[100];	/*!< 写缓冲区 */
-static char kerneldata[] = {"kernel data!"};
+static chrdevbase_dev_t chrdevbase;
+
+static uint bufsize = 64 * 1024;	/*!< 缓冲区大小，向上取整到2的幂 */
+module_param(bufsize, uint, S_IRUGO);
+MODULE_PARM_DESC(bufsize, "ring buffer size in bytes, rounded up to a power of two (4KiB..16MiB)");
 
 /* Private function ----------------------------------------------------------*/
 static int chrdevbase_open(struct inode *inode, struct file *flip);
-static ssize_t chrdevbase_read(struct file *flip, char __user *buf, size_t cnt, loff_t *offt);
-static ssize_t chrdevbase_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static ssize_t chrdevbase_read_iter(struct kiocb *iocb, struct iov_iter *to);
+static ssize_t chrdevbase_write_iter(struct kiocb *iocb, struct iov_iter *from);
+static ssize_t chrdevbase_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe,
+										size_t len, unsigned int flags);
+static unsigned int chrdevbase_poll(struct file *filp, struct poll_table_struct *wait);
 static int chrdevbase_release(struct inode *inode, struct file *flip);
 
+/* read()/write()由VFS转换为read_iter/write_iter，splice写入时直接把管道页交给write_iter */
 static struct file_operations chrdevbase_fops = {
 	.owner = THIS_MODULE,
 	.open = chrdevbase_open,
-	.read = chrdevbase_read,
-	.write = chrdevbase_write,
+	.read_iter = chrdevbase_read_iter,
+	.write_iter = chrdevbase_write_iter,
+	.splice_read = chrdevbase_splice_read,
+	.splice_write = iter_file_splice_write,
+	.poll = chrdevbase_poll,
+	.llseek = no_llseek,
 	.release = chrdevbase_release,
 };
 
+static const struct pipe_buf_operations chrdevbase_pipe_buf_ops = {
+	.can_merge = 0,
+	.confirm = generic_pipe_buf_confirm,
+	.release = generic_pipe_buf_release,
+	.steal = generic_pipe_buf_steal,
+	.get = generic_pipe_buf_get,
+};
+
 /**=============================================================================
  * @brief           打开设备
  *
@@ -53,59 +104,357 @@ static struct file_operations chrdevbase_fops = {
  *============================================================================*/
 static int chrdevbase_open(struct inode *inode, struct file *flip)
 {
+	flip->private_data = &chrdevbase;
+
+	/* 管道语义，不能lseek/pread/pwrite，f_pos只记录本文件累计读写的字节数 */
+	return nonseekable_open(inode, flip);
+}
+
+/**=============================================================================
+ * @brief           环形缓冲中从pos开始的一段连续存储区
+ *
+ * kfifo没有按偏移访问的接口，这里直接用它的in/out计数，
+ * 读者用out+偏移、写者用in+偏移，拷贝完再用kfifo_dma_*_finish移动计数
+ *
+ * @param[in]       dev:设备
+ * @param[in]		pos:自由增长的位置
+ * @param[in,out]	len:想要的长度，返回不环绕的长度
+ *
+ * @return          存储区地址
+ *============================================================================*/
+static void *chrdevbase_span(chrdevbase_dev_t *dev, unsigned int pos, size_t *len)
+{
+	struct __kfifo *f = &dev->fifo.kfifo;
+	unsigned int start = pos & f->mask;
+
+	*len = min_t(size_t, *len, f->mask + 1 - start);
+	return f->data + start;
+}
+
+/**=============================================================================
+ * @brief           获取rd_lock并等待有数据
+ *
+ * @param[in]       dev:设备
+ * @param[in]		nonblock:没有数据时不等待
+ *
+ * @return          0:成功，已持有rd_lock;-EAGAIN:没有数据;-ERESTARTSYS:被信号打断
+ *============================================================================*/
+static int chrdevbase_wait_data(chrdevbase_dev_t *dev, bool nonblock)
+{
+	if (mutex_lock_interruptible(&dev->rd_lock))
+	{
+		return -ERESTARTSYS;
+	}
+
+	while (kfifo_is_empty(&dev->fifo))
+	{
+		mutex_unlock(&dev->rd_lock);
+		if (nonblock)
+		{
+			return -EAGAIN;
+		}
+		if (wait_event_interruptible(dev->r_wait, !kfifo_is_empty(&dev->fifo)))
+		{
+			return -ERESTARTSYS;
+		}
+		if (mutex_lock_interruptible(&dev->rd_lock))
+		{
+			return -ERESTARTSYS;
+		}
+	}
+
 	return 0;
 }
 
 /**=============================================================================
- * @brief           从设备读取数据
+ * @brief           取走已读出的数据，调用者持有rd_lock
+ *
+ * @param[in]       dev:设备
+ * @param[in]		n:字节数
+ *
+ * @return          none
+ *============================================================================*/
+static void chrdevbase_consume(chrdevbase_dev_t *dev, unsigned int n)
+{
+	if (n == 0)
+	{
+		return;
+	}
+
+	smp_mb();	/*!< 读完数据后才让出空间 */
+	kfifo_dma_out_finish(&dev->fifo, n);
+	wake_up_interruptible_poll(&dev->w_wait, POLLOUT | POLLWRNORM);
+}
+
+/**=============================================================================
+ * @brief           从设备读取数据，缓冲区为空时等待，有数据即返回
  *
- * @param[in]       flip:要打卡的设备文件
- * @param[in]		buf:返回给用户空间的数据缓冲区
- * @param[in]		cnt:要读取的数据长度
- * @param[in]		offt:相对于文件首地址的偏移
+ * @param[in]       iocb:请求，ki_filp为设备文件，ki_pos为偏移
+ * @param[in]		to:用户或内核缓冲区
  *
  * @return          读取的字节数;如果为负值则读取失败
  *============================================================================*/
-static ssize_t chrdevbase_read(struct file *flip, char __user *buf, size_t cnt, loff_t *offt)
+static ssize_t chrdevbase_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
-	int retvalue = 0;
+	int ret = 0;
+	size_t len = 0;
+	size_t done = 0;
+	size_t copied = 0;
+	size_t total = iov_iter_count(to);
+	void *p = NULL;
+	chrdevbase_dev_t *dev = iocb->ki_filp->private_data;
 
-	memcpy(readbuf, kerneldata, sizeof(kerneldata));
-	retvalue = copy_to_user(buf, readbuf, cnt);
-	if (retvalue == 0 )
+	if (total == 0)
 	{
-		printk("kernel senddata ok!\r\n");
+		return 0;
 	}
-	else
+
+	ret = chrdevbase_wait_data(dev, iocb->ki_filp->f_flags & O_NONBLOCK);
+	if (ret)
 	{
-		printk("kernel sendata failed!\r\n");
+		return ret;
 	}
-	
-	return 0;
+
+	/* 最多两段(环绕时)，直接拷贝到目的缓冲区 */
+	total = min_t(size_t, total, kfifo_len(&dev->fifo));
+	smp_rmb();	/*!< 先看到in再读数据，与写者的smp_wmb配对 */
+	while (done < total)
+	{
+		len = total - done;
+		p = chrdevbase_span(dev, dev->fifo.kfifo.out + done, &len);
+		copied = copy_to_iter(p, len, to);
+		done += copied;
+		if (copied < len)
+		{
+			break;
+		}
+	}
+	chrdevbase_consume(dev, done);
+	mutex_unlock(&dev->rd_lock);
+
+	iocb->ki_pos += done;
+
+	return done ? done : -EFAULT;
 }
 
 /**=============================================================================
- * @brief           向设备写数据
+ * @brief           向设备写数据，阻塞时写完全部数据才返回，非阻塞时写入能放下的部分
  *
- * @param[in]       none
+ * @param[in]       iocb:请求，ki_filp为设备文件，ki_pos为偏移
+ * @param[in]		from:用户缓冲区，或splice_write时的管道页
+ *
+ * @return          写入的字节数;如果为负值则写入失败
+ *============================================================================*/
+static ssize_t chrdevbase_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	int ret = 0;
+	size_t len = 0;
+	size_t done = 0;
+	size_t room = 0;
+	size_t copied = 0;
+	void *p = NULL;
+	struct file *filp = iocb->ki_filp;
+	chrdevbase_dev_t *dev = filp->private_data;
+
+	if (mutex_lock_interruptible(&dev->wr_lock))
+	{
+		return -ERESTARTSYS;
+	}
+
+	while (iov_iter_count(from))
+	{
+		if (kfifo_is_full(&dev->fifo))
+		{
+			if (filp->f_flags & O_NONBLOCK)
+			{
+				ret = -EAGAIN;
+				break;
+			}
+
+			/* 等待前先叫醒读者，否则缓冲区满时双方互相等待 */
+			mutex_unlock(&dev->wr_lock);
+			if (done)
+			{
+				wake_up_interruptible_poll(&dev->r_wait, POLLIN | POLLRDNORM);
+			}
+			if (wait_event_interruptible(dev->w_wait, !kfifo_is_full(&dev->fifo))
+				|| mutex_lock_interruptible(&dev->wr_lock))
+			{
+				ret = -ERESTARTSYS;
+				goto out;
+			}
+			continue;
+		}
+
+		room = min_t(size_t, iov_iter_count(from), kfifo_avail(&dev->fifo));
+		smp_mb();	/*!< 先看到out再覆盖空间，与读者的smp_mb配对 */
+		for (copied = 0; room; room -= len)
+		{
+			len = room;
+			p = chrdevbase_span(dev, dev->fifo.kfifo.in, &len);
+			copied = copy_from_iter(p, len, from);
+			if (copied)
+			{
+				smp_wmb();	/*!< 数据写完后才对读者可见 */
+				kfifo_dma_in_finish(&dev->fifo, copied);
+				done += copied;
+			}
+			if (copied < len)
+			{
+				ret = -EFAULT;
+				break;
+			}
+		}
+		if (ret)
+		{
+			break;
+		}
+	}
+	mutex_unlock(&dev->wr_lock);
+
+out:
+	if (done)
+	{
+		wake_up_interruptible_poll(&dev->r_wait, POLLIN | POLLRDNORM);
+		iocb->ki_pos += done;
+		return done;
+	}
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           splice管道页释放函数，未放入管道的页由此释放
+ *
+ * @param[in]       spd:splice描述
+ * @param[in]		i:页序号
  *
  * @return          none
  *============================================================================*/
-static ssize_t chrdevbase_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
+static void chrdevbase_spd_release(struct splice_pipe_desc *spd, unsigned int i)
 {
-	int retvalue = 0;
+	put_page(spd->pages[i]);
+}
+
+/**=============================================================================
+ * @brief           把数据splice到管道，之后管道到文件/socket的搬运不再经过用户空间
+ *
+ * 数据只拷贝一次到新分配的页，页的所有权交给管道；只取走管道实际接收的部分，
+ * 管道满或被信号打断时剩余数据留在缓冲区
+ *
+ * @param[in]       in:设备文件
+ * @param[in,out]	ppos:偏移
+ * @param[in]		pipe:目的管道
+ * @param[in]		len:最多传输的字节数
+ * @param[in]		flags:SPLICE_F_*
+ *
+ * @return          传输的字节数;如果为负值则失败
+ *============================================================================*/
+static ssize_t chrdevbase_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe,
+										size_t len, unsigned int flags)
+{
+	int i = 0;
+	ssize_t ret = 0;
+	size_t n = 0;
+	size_t off = 0;
+	size_t seg = 0;
+	size_t cnt = 0;
+	size_t total = 0;
+	void *p = NULL;
+	chrdevbase_dev_t *dev = in->private_data;
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd = {
+		.pages = pages,
+		.partial = partial,
+		.nr_pages = 0,
+		.nr_pages_max = PIPE_DEF_BUFFERS,
+		.flags = flags,
+		.ops = &chrdevbase_pipe_buf_ops,
+		.spd_release = chrdevbase_spd_release,
+	};
 
-	retvalue = copy_from_user(writebuf, buf, cnt);
-	if (retvalue == 0)
+	if (len == 0)
 	{
-		printk("kernel recvdata:%s\r\n", writebuf);
+		return 0;
 	}
-	else
+
+	ret = chrdevbase_wait_data(dev, (in->f_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK));
+	if (ret)
 	{
-		printk("kernel recvdata failed!\r\n");
+		return ret;
 	}
-	
-	return 0;
+
+	total = min_t(size_t, len, kfifo_len(&dev->fifo));
+	total = min_t(size_t, total, PIPE_DEF_BUFFERS * PAGE_SIZE);
+	smp_rmb();	/*!< 先看到in再读数据，与写者的smp_wmb配对 */
+	for (i = 0; off < total; i++)
+	{
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (pages[i] == NULL)
+		{
+			break;
+		}
+
+		n = min_t(size_t, total - off, PAGE_SIZE);
+		partial[i].offset = 0;
+		partial[i].len = n;
+		partial[i].private = 0;
+
+		/* 只拷贝，不移动out，管道接收多少再取走多少 */
+		for (seg = 0; seg < n; seg += cnt)
+		{
+			cnt = n - seg;
+			p = chrdevbase_span(dev, dev->fifo.kfifo.out + off + seg, &cnt);
+			memcpy(page_address(pages[i]) + seg, p, cnt);
+		}
+		off += n;
+		spd.nr_pages++;
+	}
+
+	if (spd.nr_pages == 0)
+	{
+		mutex_unlock(&dev->rd_lock);
+		return -ENOMEM;
+	}
+
+	ret = splice_to_pipe(pipe, &spd);
+	if (ret > 0)
+	{
+		chrdevbase_consume(dev, ret);
+		*ppos += ret;
+	}
+	mutex_unlock(&dev->rd_lock);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           poll函数，有数据可读、有空间可写
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          设备状态
+ *============================================================================*/
+static unsigned int chrdevbase_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	unsigned int mask = 0;
+	chrdevbase_dev_t *dev = filp->private_data;
+
+	poll_wait(filp, &dev->r_wait, wait);
+	poll_wait(filp, &dev->w_wait, wait);
+
+	if (!kfifo_is_empty(&dev->fifo))
+	{
+		mask |= POLLIN | POLLRDNORM;
+	}
+	if (!kfifo_is_full(&dev->fifo))
+	{
+		mask |= POLLOUT | POLLWRNORM;
+	}
+
+	return mask;
 }
 
 /**=============================================================================
@@ -131,12 +480,30 @@ static int __init chrdevbase_init(void)
 {
 	int retvalue = 0;
 
-	retvalue = register_chrdev(CHRDEVBASE_MAJOR, CHRDEVBASE_NAME, &chrdevbase_fops);
+	bufsize = roundup_pow_of_two(clamp_t(uint, bufsize, CHRDEVBASE_MIN_SIZE, CHRDEVBASE_MAX_SIZE));
+
+	/* 大缓冲区kmalloc容易失败，用vmalloc */
+	chrdevbase.buf = vmalloc(bufsize);
+	if (chrdevbase.buf == NULL)
+	{
+		return -ENOMEM;
+	}
+	kfifo_init(&chrdevbase.fifo, chrdevbase.buf, bufsize);
+	mutex_init(&chrdevbase.rd_lock);
+	mutex_init(&chrdevbase.wr_lock);
+	init_waitqueue_head(&chrdevbase.r_wait);
+	init_waitqueue_head(&chrdevbase.w_wait);
+
+	/* 使用固定的主设备号，同时创建/dev/chrdevbase */
+	chrdevbase.chrdev.major = CHRDEVBASE_MAJOR;
+	retvalue = drv_chrdev_add(&chrdevbase.chrdev, NULL, CHRDEVBASE_NAME, &chrdevbase_fops, &chrdevbase);
 	if (retvalue < 0)
 	{
 		printk("chrdevbase driver register failed\r\n");
+		vfree(chrdevbase.buf);
+		return retvalue;
 	}
-	printk("chrdevbase_init()\r\n");
+	printk("chrdevbase_init() bufsize=%u\r\n", bufsize);
 
 	return 0;
 }
@@ -150,7 +517,8 @@ static int __init chrdevbase_init(void)
  *============================================================================*/
 static void __exit chrdevbase_exit(void)
 {
-	unregister_chrdev(CHRDEVBASE_MAJOR, CHRDEVBASE_NAME);
+	drv_chrdev_del(&chrdevbase.chrdev);
+	vfree(chrdevbase.buf);
 	printk("chrdevbase_exit()\r\n");
 }
 
@@ -166,4 +534,4 @@ module_exit(chrdevbase_exit);
  * 
  */
 MODULE_LICENSE("GPL");
-MODULE_AUTHOR("xieli");
+MODULE_AUTHOR("xieli");
\ No newline at end of file
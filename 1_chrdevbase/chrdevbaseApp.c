@@ -59,24 +59,29 @@ int main(int argc, char *argv[])
 
 	if (atoi(argv[2]) == 1)	/*!< 从驱动文件读取数据 */
 	{
-		retvalue = read(fd, readbuf, 50);
+		retvalue = read(fd, readbuf, sizeof(readbuf) - 1);	/*!< 缓冲区空时等待写入 */
 		if (retvalue < 0)
 		{
 			printf("read file %s failed!\r\n", filename);
 		}
 		else
 		{
-			printf("read data:%s\r\n", readbuf);
+			readbuf[retvalue] = '\0';
+			printf("read %d bytes:%s\r\n", retvalue, readbuf);
 		}
 	}
 	else if (atoi(argv[2]) == 2)	/*!< 向设备驱动写数据 */
 	{
 		memcpy(writebuf, usrdata, sizeof(usrdata));
-		retvalue = write(fd, writebuf, 50);
+		retvalue = write(fd, writebuf, sizeof(usrdata));
 		if (retvalue < 0)
 		{
 			printf("write file %s failed!\r\n", filename);
 		}
+		else
+		{
+			printf("write %d bytes\r\n", retvalue);
+		}
 	}
 
 	/* 关闭设备 */
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/20_input/keyinput.ko
-/home/xieli/linux/linux_drivers/20_input/keyinput.o
@@ -0,0 +1,258 @@
+/**
+  ******************************************************************************
+  * @file			input_reader.c
+  * @brief			input_reader function
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-20
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "string.h"
+#include "sys/epoll.h"
+#include "input_reader.h"
+
+/* Private constants ---------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           处理一次read()得到的事件，按SYN_REPORT切分成帧
+ *
+ * @param[in]       reader:读取器
+ * @param[in]		index:设备序号
+ * @param[in]		ev:事件数组
+ * @param[in]		cnt:事件个数
+ *
+ * @return          none
+ *============================================================================*/
+static void input_reader_dispatch(input_reader_t *reader, int index,
+									const struct input_event *ev, int cnt)
+{
+	int i = 0;
+	int start = 0;
+	input_reader_dev_t *dev = &reader->dev[index];
+
+	for (i = 0; i < cnt; i++)
+	{
+		if (ev[i].type != EV_SYN)
+		{
+			continue;
+		}
+
+		if (ev[i].code == SYN_DROPPED)	/*!< 内核缓冲区溢出，丢弃当前帧 */
+		{
+			dev->dropped = 1;
+			dev->frame_cnt = 0;
+			start = i + 1;
+		}
+		else if (ev[i].code == SYN_REPORT)
+		{
+			if (dev->dropped)
+			{
+				dev->dropped = 0;
+			}
+			else if (dev->frame_cnt == 0)	/*!< 整帧都在本次缓冲区内，直接回调不拷贝 */
+			{
+				reader->cb(index, &ev[start], i - start, reader->arg);
+			}
+			else	/*!< 与上次read()残留的半帧拼接 */
+			{
+				int n = i - start;
+
+				if (n > INPUT_READER_FRAME_MAX - dev->frame_cnt)
+				{
+					n = INPUT_READER_FRAME_MAX - dev->frame_cnt;
+				}
+				memcpy(&dev->frame[dev->frame_cnt], &ev[start], n * sizeof(*ev));
+				reader->cb(index, dev->frame, dev->frame_cnt + n, reader->arg);
+				dev->frame_cnt = 0;
+			}
+			start = i + 1;
+		}
+	}
+
+	/* 保存未结束的半帧，超出部分丢弃 */
+	if ((start < cnt) && !dev->dropped)
+	{
+		int n = cnt - start;
+
+		if (n > INPUT_READER_FRAME_MAX - dev->frame_cnt)
+		{
+			n = INPUT_READER_FRAME_MAX - dev->frame_cnt;
+		}
+		memcpy(&dev->frame[dev->frame_cnt], &ev[start], n * sizeof(*ev));
+		dev->frame_cnt += n;
+	}
+}
+
+/**=============================================================================
+ * @brief           读空一个设备的事件
+ *
+ * @param[in]       reader:读取器
+ * @param[in]		index:设备序号
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int input_reader_drain(input_reader_t *reader, int index)
+{
+	ssize_t len = 0;
+
+	while (1)
+	{
+		len = read(reader->dev[index].fd, reader->buf, sizeof(reader->buf));
+		if (len < 0)
+		{
+			if (errno == EAGAIN)
+			{
+				return 0;
+			}
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -errno;
+		}
+		if (len == 0)
+		{
+			return -ENODEV;
+		}
+
+		input_reader_dispatch(reader, index, reader->buf,
+								len / sizeof(struct input_event));
+
+		if ((size_t)len < sizeof(reader->buf))	/*!< 没读满说明已经读空 */
+		{
+			return 0;
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           初始化读取器
+ *
+ * @param[in]       reader:读取器
+ * @param[in]		cb:帧回调函数
+ * @param[in]		arg:回调参数
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+int input_reader_init(input_reader_t *reader, input_frame_cb_t cb, void *arg)
+{
+	memset(reader, 0, sizeof(*reader));
+
+	reader->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (reader->epfd < 0)
+	{
+		return -errno;
+	}
+	reader->cb = cb;
+	reader->arg = arg;
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           添加一个输入设备
+ *
+ * @param[in]       reader:读取器
+ * @param[in]		filename:设备文件名
+ *
+ * @return          >=0:设备序号;其他:失败
+ *============================================================================*/
+int input_reader_add(input_reader_t *reader, const char *filename)
+{
+	int fd = 0;
+	int index = reader->dev_cnt;
+	struct epoll_event event;
+
+	if (index >= INPUT_READER_MAX_DEV)
+	{
+		return -ENOSPC;
+	}
+
+	fd = open(filename, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return -errno;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = index;
+	if (epoll_ctl(reader->epfd, EPOLL_CTL_ADD, fd, &event) < 0)
+	{
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+
+	reader->dev[index].fd = fd;
+	reader->dev[index].dropped = 0;
+	reader->dev[index].frame_cnt = 0;
+	reader->dev_cnt++;
+
+	return index;
+}
+
+/**=============================================================================
+ * @brief           等待并处理所有就绪设备的事件
+ *
+ * @param[in]       reader:读取器
+ * @param[in]		timeout_ms:超时时间，-1为一直等待
+ *
+ * @return          >=0:就绪设备个数;其他:失败
+ *============================================================================*/
+int input_reader_poll(input_reader_t *reader, int timeout_ms)
+{
+	int i = 0;
+	int n = 0;
+	int ret = 0;
+	struct epoll_event events[INPUT_READER_MAX_DEV];
+
+	n = epoll_wait(reader->epfd, events, INPUT_READER_MAX_DEV, timeout_ms);
+	if (n < 0)
+	{
+		return (errno == EINTR) ? 0 : -errno;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		ret = input_reader_drain(reader, events[i].data.u32);
+		if (ret < 0)
+		{
+			return ret;
+		}
+	}
+
+	return n;
+}
+
+/**=============================================================================
+ * @brief           释放读取器
+ *
+ * @param[in]       reader:读取器
+ *
+ * @return          none
+ *============================================================================*/
+void input_reader_deinit(input_reader_t *reader)
+{
+	int i = 0;
+
+	for (i = 0; i < reader->dev_cnt; i++)
+	{
+		close(reader->dev[i].fd);
+	}
+	close(reader->epfd);
+	reader->dev_cnt = 0;
+}
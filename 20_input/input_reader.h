@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file			input_reader.h
+  * @brief			input_reader header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-20
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __INPUT_READER_H_
+#define __INPUT_READER_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/input.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define INPUT_READER_MAX_DEV	8		/*!< 最多同时监听的输入设备数 */
+#define INPUT_READER_BATCH		64		/*!< 每次read()最多读取的事件数 */
+#define INPUT_READER_FRAME_MAX	64		/*!< 一帧(两个SYN_REPORT之间)最多的事件数 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 帧回调函数，ev指向一帧内的事件(不含SYN_REPORT)，cnt为事件个数
+*/
+typedef void (*input_frame_cb_t)(int index, const struct input_event *ev, int cnt, void *arg);
+
+/**
+* @brief 单个输入设备
+*/
+typedef struct {
+	int fd;					/*!< 文件描述符 */
+	int dropped;			/*!< 收到SYN_DROPPED，丢弃到下一个SYN_REPORT */
+	int frame_cnt;			/*!< 跨read()暂存的事件个数 */
+	struct input_event frame[INPUT_READER_FRAME_MAX];	/*!< 跨read()暂存的半帧 */
+}input_reader_dev_t;
+
+/**
+* @brief 输入读取器
+*/
+typedef struct {
+	int epfd;				/*!< epoll文件描述符 */
+	int dev_cnt;			/*!< 已添加的设备数 */
+	input_frame_cb_t cb;	/*!< 帧回调 */
+	void *arg;				/*!< 回调参数 */
+	input_reader_dev_t dev[INPUT_READER_MAX_DEV];	/*!< 设备数组 */
+	struct input_event buf[INPUT_READER_BATCH];	/*!< read()缓冲区 */
+}input_reader_t;
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int input_reader_init(input_reader_t *reader, input_frame_cb_t cb, void *arg);
+int input_reader_add(input_reader_t *reader, const char *filename);
+int input_reader_poll(input_reader_t *reader, int timeout_ms);
+void input_reader_deinit(input_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __INPUT_READER_H_ */
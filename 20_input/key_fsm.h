@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file			key_fsm.h
+  * @brief			按键消抖后的状态机：按下、松开和长按
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-10
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 只根据消抖后的电平和时间计算要上报的事件，不访问GPIO、定时器和input核心，
+  * 时间为任意单调递增的计数(驱动中为jiffies)，回绕按time_before的方式处理
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __KEY_FSM_H_
+#define __KEY_FSM_H_
+
+/* Includes ------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define KEY_FSM_PRESS		0x01	/*!< 上报按下 */
+#define KEY_FSM_RELEASE		0x02	/*!< 上报松开 */
+#define KEY_FSM_LONG		0x04	/*!< 上报长按键值按下 */
+#define KEY_FSM_LONG_UP		0x08	/*!< 上报长按键值松开，先于KEY_FSM_RELEASE上报 */
+#define KEY_FSM_REARM		0x10	/*!< 需要在deadline重新启动定时器 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 单个按键的状态
+*/
+typedef struct {
+	unsigned char pressed;			/*!< 已上报按下 */
+	unsigned char long_reported;	/*!< 已上报长按 */
+	unsigned long deadline;			/*!< 长按到期时间 */
+}key_fsm_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           消抖定时器到期时调用一次
+ *
+ * 按下时上报按下并开始长按计时；保持按下到期后上报长按；
+ * 抖动会让定时器提前到期，未到deadline时只要求重新计时；
+ * 松开时先结束长按再上报松开
+ *
+ * @param[in]       fsm:按键状态
+ * @param[in]		down:消抖后的电平，非0为按下
+ * @param[in]		now:当前时间
+ * @param[in]		hold:长按时间，0为不检测长按
+ *
+ * @return          KEY_FSM_xxx的组合
+ *============================================================================*/
+static inline unsigned int key_fsm_step(key_fsm_t *fsm, int down, unsigned long now,
+										unsigned long hold)
+{
+	unsigned int act = 0;
+
+	if (!down)
+	{
+		if (fsm->long_reported)
+		{
+			act |= KEY_FSM_LONG_UP;
+			fsm->long_reported = 0;
+		}
+		fsm->pressed = 0;
+		return act | KEY_FSM_RELEASE;
+	}
+
+	if (!fsm->pressed)
+	{
+		fsm->pressed = 1;
+		fsm->long_reported = 0;
+		act |= KEY_FSM_PRESS;
+		if (hold)
+		{
+			fsm->deadline = now + hold;
+			act |= KEY_FSM_REARM;
+		}
+	}
+	else if (hold && !fsm->long_reported)
+	{
+		if ((long)(now - fsm->deadline) < 0)
+		{
+			act |= KEY_FSM_REARM;
+		}
+		else
+		{
+			fsm->long_reported = 1;
+			act |= KEY_FSM_LONG;
+		}
+	}
+
+	return act;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __KEY_FSM_H_ */
@@ -32,12 +32,15 @@
 #include <asm/uaccess.h>
 #include <asm/io.h>
 
+#include "key_fsm.h"
+
 /* Private constants ---------------------------------------------------------*/
 #define KEYINPUT_CNT			1			/*!< 设备号个数 */
 #define KEYINPUT_NAME			"keyinput"	/*!< 设备名 */
 #define	KEY0_VALUE				0x01		/*!< 按键值 */
 #define INVALID_KEY				0xFF		/*!< 无效值 */
 #define KEY_NUM					1			/*!< 按键数量 */
+#define DEBOUNCE_MS				10			/*!< 消抖时间 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
@@ -49,6 +52,8 @@ typedef struct {
 	int gpio;		/*!< gpio */
 	int irqnum;		/*!< 中断号 */
 	unsigned char value;	/*!< 按键对应的键值 */
+	unsigned int longpress;	/*!< 长按键值，0为不上报 */
+	key_fsm_t fsm;	/*!< 按下/长按状态，时间为jiffies */
 	char name[10];	/*!< 名字 */
 	irqreturn_t (*handler)(int, void *);	/*!< 中断服务函数 */
 }irq_keydesc_t;
@@ -69,6 +74,22 @@ typedef struct {
 /* Private variables ---------------------------------------------------------*/
 static keyinput_dev_t keyinputdev;
 
+static unsigned int rep_delay = 250;	/*!< 自动重复延时(ms)，0为关闭自动重复 */
+module_param(rep_delay, uint, S_IRUGO);
+MODULE_PARM_DESC(rep_delay, "autorepeat delay in ms, 0 disables EV_REP");
+
+static unsigned int rep_period = 33;	/*!< 自动重复周期(ms) */
+module_param(rep_period, uint, S_IRUGO);
+MODULE_PARM_DESC(rep_period, "autorepeat period in ms");
+
+static unsigned int longpress_ms = 1000;	/*!< 长按时间(ms)，0为关闭长按 */
+module_param(longpress_ms, uint, S_IRUGO);
+MODULE_PARM_DESC(longpress_ms, "hold time in ms before the long-press code is reported, 0 disables");
+
+static unsigned int longpress_code = KEY_1;	/*!< KEY0长按上报的键值 */
+module_param(longpress_code, uint, S_IRUGO);
+MODULE_PARM_DESC(longpress_code, "key code reported when KEY0 is held for longpress_ms");
+
 /* Private function ----------------------------------------------------------*/
 
 /**=============================================================================
@@ -84,7 +105,7 @@ static irqreturn_t key0_handler(int irq, void *dev_id)
 
 	dev->curkey_num = 0;
 	dev->timer.data = (volatile long)dev_id;
-	mod_timer(&dev->timer, jiffies + msecs_to_jiffies(10));
+	mod_timer(&dev->timer, jiffies + msecs_to_jiffies(DEBOUNCE_MS));
 
 	return IRQ_RETVAL(IRQ_HANDLED);
 }
@@ -100,24 +121,40 @@ void timer_function(unsigned long arg)
 {
 	unsigned char value = 0;
 	unsigned char num = 0;
+	unsigned int act = 0;
+	unsigned long hold = 0;
 	irq_keydesc_t *keydesc;
 	keyinput_dev_t *dev = (keyinput_dev_t*)arg;
 
 	num = dev->curkey_num;
 	keydesc = &dev->irqkeydesc[num];
 	value = gpio_get_value(keydesc->gpio);
+	hold = (keydesc->longpress && longpress_ms) ? msecs_to_jiffies(longpress_ms) : 0;
+	act = key_fsm_step(&keydesc->fsm, value == 0, jiffies, hold);
 
-	if (value == 0)	/*!< 按键按下 */
+	if (act & KEY_FSM_LONG_UP)
+	{
+		input_report_key(dev->inputdev, keydesc->longpress, 0);
+	}
+	if (act & KEY_FSM_PRESS)
 	{
-		//input_event(dev->inputdev, EV_KEY, keydesc->value, 1);
 		input_report_key(dev->inputdev, keydesc->value, 1);
-		input_sync(dev->inputdev);
 	}
-	else	/*!< 按键松开 */
+	if (act & KEY_FSM_LONG)
+	{
+		input_report_key(dev->inputdev, keydesc->longpress, 1);
+	}
+	if (act & KEY_FSM_RELEASE)
 	{
-		//input_event(dev->inputdev, EV_KEY, keydesc->value, 0);
 		input_report_key(dev->inputdev, keydesc->value, 0);
-		input_sync(dev->inputdev);		
+	}
+	if (act & ~KEY_FSM_REARM)
+	{
+		input_sync(dev->inputdev);
+	}
+	if (act & KEY_FSM_REARM)	/*!< 开始长按计时，或抖动使定时器提前到期 */
+	{
+		mod_timer(&dev->timer, keydesc->fsm.deadline);
 	}
 }
 
@@ -172,6 +209,7 @@ static int key_gpio_init(void)
 	/* 4. 申请中断 */
 	keyinputdev.irqkeydesc[0].handler = key0_handler;
 	keyinputdev.irqkeydesc[0].value = KEY_0;
+	keyinputdev.irqkeydesc[0].longpress = longpress_code;
 	for (i = 0; i < KEY_NUM; i++)
 	{
 		ret = request_irq(keyinputdev.irqkeydesc[i].irqnum,
@@ -206,8 +244,19 @@ static int key_gpio_init(void)
 #endif
 
 #if 1
-	keyinputdev.inputdev->evbit[0] = BIT_MASK(EV_KEY) | BIT_MASK(EV_REP);
-	input_set_capability(keyinputdev.inputdev, EV_KEY, KEY_0);
+	keyinputdev.inputdev->evbit[0] = BIT_MASK(EV_KEY);
+	if (rep_delay)	/*!< 由input核心根据rep参数产生自动重复 */
+	{
+		__set_bit(EV_REP, keyinputdev.inputdev->evbit);
+	}
+	for (i = 0; i < KEY_NUM; i++)
+	{
+		input_set_capability(keyinputdev.inputdev, EV_KEY, keyinputdev.irqkeydesc[i].value);
+		if (keyinputdev.irqkeydesc[i].longpress && longpress_ms)
+		{
+			input_set_capability(keyinputdev.inputdev, EV_KEY, keyinputdev.irqkeydesc[i].longpress);
+		}
+	}
 #endif
 
 	/* 注册输入设备 */
@@ -218,6 +267,13 @@ static int key_gpio_init(void)
 		return ret;
 	}
 
+	/* 注册后再设置，注册时input核心会填入默认的重复参数 */
+	if (rep_delay)
+	{
+		keyinputdev.inputdev->rep[REP_DELAY] = rep_delay;
+		keyinputdev.inputdev->rep[REP_PERIOD] = rep_period;
+	}
+
 	return 0;
 }
 
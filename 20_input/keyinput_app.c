@@ -19,6 +19,7 @@
 #include "stdlib.h"
 #include "string.h"
 #include <linux/input.h>
+#include "input_reader.h"
 
 /* Private constants ---------------------------------------------------------*/
 #define	KEY_VALUE		0xF0		/*!< 按键值 */
@@ -26,10 +27,45 @@
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
-static struct input_event inputevent;
-
 /* Private function ----------------------------------------------------------*/
 
+/**=============================================================================
+ * @brief           帧回调函数，一帧内的事件一起处理
+ *
+ * @param[in]       index:设备序号
+ * @param[in]		ev:事件数组
+ * @param[in]		cnt:事件个数
+ * @param[in]		arg:回调参数
+ *
+ * @return          none
+ *============================================================================*/
+static void key_frame_handler(int index, const struct input_event *ev, int cnt, void *arg)
+{
+	int i = 0;
+
+	for (i = 0; i < cnt; i++)
+	{
+		switch (ev[i].type)
+		{
+		case EV_KEY:
+			if (ev[i].code < BTN_MISC)	/*!< 键盘键值 */
+			{
+				printf("dev%d key %d %s\r\n", index, ev[i].code,
+						ev[i].value?"press":"release");
+			}
+			else
+			{
+				printf("dev%d button %d %s\r\n", index, ev[i].code,
+						ev[i].value?"press":"release");					
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
 /**=============================================================================
  * @brief           主程序
  *
@@ -40,65 +76,48 @@ static struct input_event inputevent;
  *============================================================================*/
 int main(int argc, char *argv[])
 {
-	int fd;
-	int err = 0;
+	int i = 0;
 	int ret = 0;
-	char *filename;
+	static input_reader_t reader;
 
-	if (argc != 2)
+	if (argc < 2)
 	{
 		printf("Error usage!\r\n");
 		return -1;
 	}
 
-	filename = argv[1];
-
-	/* 打开KEY驱动 */
-	fd = open(filename, O_RDWR);
-	if (fd < 0)
+	ret = input_reader_init(&reader, key_frame_handler, NULL);
+	if (ret < 0)
 	{
-		printf("Can't open file %s\r\n", filename);
+		printf("Can't init input reader\r\n");
 		return -1;
 	}
 
-	/* 读取按键值 */
-	while (1)
+	/* 打开所有KEY驱动 */
+	for (i = 1; i < argc; i++)
 	{
-		err = read(fd, &inputevent, sizeof(inputevent));
-		if (err > 0)
+		ret = input_reader_add(&reader, argv[i]);
+		if (ret < 0)
 		{
-			switch (inputevent.type)
-			{
-			case EV_KEY:
-				if (inputevent.code < BTN_MISC)	/*!< 键盘键值 */
-				{
-					printf("key %d %s\r\n", inputevent.code,
-							inputevent.value?"press":"release");
-				}
-				else
-				{
-					printf("button %d %s\r\n", inputevent.code,
-							inputevent.value?"press":"release");					
-				}
-				break;
-
-			default:
-				break;
-			}
+			printf("Can't open file %s\r\n", argv[i]);
+			input_reader_deinit(&reader);
+			return -1;
 		}
-		else
+	}
+
+	/* 读取按键值 */
+	while (1)
+	{
+		ret = input_reader_poll(&reader, -1);
+		if (ret < 0)
 		{
-			printf("读取数据是不\r\n");
+			printf("read input failed: %s\r\n", strerror(-ret));
+			break;
 		}
 	}
 
 	/* 关闭设备 */
-	ret = close(fd);
-	if (ret < 0)
-	{
-		printf("Can't close file %s\r\n", filename);
-		return -1;
-	}
+	input_reader_deinit(&reader);
 
 	return 0;
 }
\ No newline at end of file
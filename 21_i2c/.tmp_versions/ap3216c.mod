@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/21_i2c/ap3216c.ko
-/home/xieli/linux/linux_drivers/21_i2c/ap3216c.o
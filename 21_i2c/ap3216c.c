@@ -23,35 +23,38 @@
 #include <linux/device.h>
 #include <linux/timer.h>
 #include <linux/i2c.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 
 #include "ap3216c.h"
+#include "../common/drv_chrdev.h"
+#include "../common/drv_ref.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define AP3216C_CNT				1			/*!< 设备号个数 */
 #define AP3216C_NAME			"ap3216c"	/*!< 设备名 */
+#define AP3216C_MAX_RECORDS		16			/*!< 一次read()最多返回的记录数，每条等一次新的转换，16条约1.8s */
+#define AP3216C_CONV_NS			112500000	/*!< ALS+PS+IR模式一次转换的时间，112.5ms */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
-/* ap3216c设备结构体 */
+/* ap3216c设备结构体，probe和每个打开的文件各持有一个引用 */
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
+	drv_ref_t ref;			/*!< 引用计数，dead后不再访问i2c设备 */
 	struct device_node *nd; /*!< 设备节点 */
-	int major;				/*!< 主设备号 */
 	void *private_data;		/*!< 私有数据 */
 	unsigned short ir, als, ps;	/*!< 光传感数据 */
+	ktime_t ready;			/*!< 下一次转换完成的时间，之前读到的还是上一条记录 */
 }ap3216c_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
-static ap3216c_dev_t ap3216cdev;
-
 /* 传统匹配方式列表 */
 static const struct i2c_device_id ap3216c_id[] = {
 	{"xli,ap3216c", 0},
@@ -80,14 +83,14 @@ static struct i2c_driver ap3216c_driver = {
 };
 
 static int ap3216c_open(struct inode *inode, struct file *filp);
-static ssize_t ap3216c_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off);
+static ssize_t ap3216c_read_iter(struct kiocb *iocb, struct iov_iter *to);
 static int ap3216c_release(struct inode *inode, struct file *filp);
 
 /* ap3216c操作函数 */
 static const struct file_operations ap3216c_ops = {
 	.owner = THIS_MODULE,
 	.open = ap3216c_open,
-	.read = ap3216c_read,
+	.read_iter = ap3216c_read_iter,
 	.release = ap3216c_release,
 };
 
@@ -191,16 +194,29 @@ static void ap3216c_write_reg(ap3216c_dev_t *dev, u8 reg, u8 data)
  * @param[in]       inode:节点
  * @param[in]		filp:设备文件
  *
- * @return          none
+ * @return          0:成功;-ENODEV:设备已解绑;-ERESTARTSYS
  *============================================================================*/
 static int ap3216c_open(struct inode *inode, struct file *filp)
 {
-	filp->private_data = &ap3216cdev;
+	int ret = 0;
+	ap3216c_dev_t *dev = (ap3216c_dev_t*)filp->private_data;
+
+	ret = drv_ref_enter(&dev->ref);
+	if (ret)
+	{
+		return ret;
+	}
 
 	/* 初始化ap3216c */
-	ap3216c_write_reg(&ap3216cdev, AP3216C_SYSTEMCONG, 0x04);
+	ap3216c_write_reg(dev, AP3216C_SYSTEMCONG, 0x04);
 	mdelay(50);	/*!< ap3216c复位至少10ms */
-	ap3216c_write_reg(&ap3216cdev, AP3216C_SYSTEMCONG, 0x03);
+	ap3216c_write_reg(dev, AP3216C_SYSTEMCONG, 0x03);
+	dev->ready = ktime_add_ns(ktime_get(), AP3216C_CONV_NS);	/*!< 第一次转换完成前数据寄存器为0 */
+
+	drv_ref_leave(&dev->ref);
+
+	/* drv_chrdev_del等待open返回，此时probe的引用还在 */
+	drv_ref_get(&dev->ref);
 
 	return 0;
 }
@@ -216,73 +232,142 @@ static void ap3216c_read_ir_als_ps(ap3216c_dev_t *dev)
 {
 	unsigned char i = 0;
 	unsigned char buf[6] = {0};
+	unsigned short val[3] = {0};
 
 	for (i = 0; i < 6; i++)
 	{
 		buf[i] = ap3216c_read_reg(dev, AP3216C_IRDATALOW + i);
 	}
 
-	/* IR */
-	if (buf[0] & 0x80)	/*!< IR_OF位为1，数据无效 */
-	{
-		dev->ir = 0;
-	}
-	else
-	{
-		dev->ir = ((unsigned short)buf[1] << 2) | (buf[0] * 0x03);
-	}
-	
-	/* ALS */
-	dev->als = ((unsigned short)buf[3] << 8) | buf[2];
+	ap3216c_decode(buf, val);
+	dev->ir = val[0];
+	dev->als = val[1];
+	dev->ps = val[2];
+}
 
-	/* PS */
-	if (buf[0] & 0x80)	/*!< IR_OF位为1，数据无效 */
+/**=============================================================================
+ * @brief           等待下一次转换完成，调用者不持有dev->ref的锁
+ *
+ * @param[in]       dev:ap3216c设备
+ * @param[in]		filp:设备文件
+ *
+ * @return          0:转换已完成;-EAGAIN:O_NONBLOCK且还在转换;-ERESTARTSYS
+ *============================================================================*/
+static int ap3216c_wait_conv(ap3216c_dev_t *dev, struct file *filp)
+{
+	s64 us = 0;
+
+	while ((us = ktime_us_delta(dev->ready, ktime_get())) > 0)
 	{
-		dev->ps = 0;
+		if (filp->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+		if (msleep_interruptible(DIV_ROUND_UP(us, USEC_PER_MSEC)))
+		{
+			return -ERESTARTSYS;
+		}
 	}
-	else
-	{
-		dev->ps = ((unsigned short)buf[5] & 0x3F) | (buf[4] * 0x0F);
-	}	
+
+	return 0;
 }
 
 /**=============================================================================
- * @brief           从设备读取数据
+ * @brief           从设备读取数据，每条记录为short[3]{ir, als, ps}
  *
- * @param[in]       filp:设备文件
- * @param[out]		buf:用户空间的数据缓冲区
- * @param[in]		cnt:要读取的数据长度
- * @param[in]		off:相对于文件首地址的偏移
+ * read()/readv()都经过这里，缓冲区能放下几条完整记录就读几条，
+ * 记录可以跨越readv的多个缓冲区。转换一次要112.5ms，每条记录都等一次
+ * 新的转换，不返回重复的数据；等待时放开锁，一次最多AP3216C_MAX_RECORDS条。
+ * 等待中有信号到来或O_NONBLOCK时返回已读出的记录
  *
- * @return          读取的字节数
+ * @param[in]       iocb:请求，ki_filp为设备文件
+ * @param[out]		to:用户空间的数据缓冲区
+ *
+ * @return          读取的字节数;-EINVAL:缓冲区放不下一条记录;-EFAULT:拷贝失败;
+ *					-EAGAIN:O_NONBLOCK且还在转换;-ENODEV:设备已解绑;-ERESTARTSYS
  *============================================================================*/
-static ssize_t ap3216c_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+static ssize_t ap3216c_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
+	int ret = 0;
 	short data[3] = {0};
-	long err = 0;
+	size_t done = 0;
+	size_t copied = 0;
+	unsigned int n = 0;
 
-	ap3216c_dev_t *dev = (ap3216c_dev_t*)filp->private_data;
+	ap3216c_dev_t *dev = (ap3216c_dev_t*)iocb->ki_filp->private_data;
+
+	if (iov_iter_count(to) < sizeof(data))
+	{
+		return -EINVAL;
+	}
 
-	ap3216c_read_ir_als_ps(dev);
+	while ((n < AP3216C_MAX_RECORDS) && (iov_iter_count(to) >= sizeof(data)))
+	{
+		ret = ap3216c_wait_conv(dev, iocb->ki_filp);
+		if (ret)
+		{
+			break;
+		}
+
+		ret = drv_ref_enter(&dev->ref);
+		if (ret)
+		{
+			break;
+		}
+
+		if (ktime_before(ktime_get(), dev->ready))	/*!< 另一个读者已经取走了这次转换 */
+		{
+			drv_ref_leave(&dev->ref);
+			continue;
+		}
+
+		ap3216c_read_ir_als_ps(dev);
+		dev->ready = ktime_add_ns(ktime_get(), AP3216C_CONV_NS);
+
+		data[0] = dev->ir;
+		data[1] = dev->als;
+		data[2] = dev->ps;
+		copied = copy_to_iter(data, sizeof(data), to);
+		drv_ref_leave(&dev->ref);
+
+		done += copied;
+		n++;
+		if (copied < sizeof(data))
+		{
+			ret = -EFAULT;
+			break;
+		}
+	}
 
-	data[0] = dev->ir;
-	data[1] = dev->als;
-	data[2] = dev->ps;
-	err = copy_to_user(buf, data, sizeof(data));
-	
-	return 0;
+	return done ? done : ret;
 }
 
 /**=============================================================================
- * @brief           关闭设备
+ * @brief           最后一个引用释放时释放设备状态
+ *
+ * @param[in]       kref:ap3216c_dev_t中的ref.kref
+ *
+ * @return          none
+ *============================================================================*/
+static void ap3216c_free(struct kref *kref)
+{
+	kfree(container_of(kref, ap3216c_dev_t, ref.kref));
+}
+
+/**=============================================================================
+ * @brief           关闭设备，释放open持有的引用
  *
  * @param[in]       inode:节点
  * @param[in]		filp:设备文件
  *
- * @return          none
+ * @return          0
  *============================================================================*/
 static int ap3216c_release(struct inode *inode, struct file *filp)
 {
+	ap3216c_dev_t *dev = (ap3216c_dev_t*)filp->private_data;
+
+	drv_ref_put(&dev->ref, ap3216c_free);
+
 	return 0;
 }
 
@@ -296,58 +381,45 @@ static int ap3216c_release(struct inode *inode, struct file *filp)
  *============================================================================*/
 static int ap3216c_probe(struct i2c_client *client, const struct i2c_device_id *id)
 {
-	/* 1. 构建设备号 */
-	if (ap3216cdev.major)
-	{
-		ap3216cdev.devid = MKDEV(ap3216cdev.major, 0);
-		register_chrdev_region(ap3216cdev.devid, AP3216C_CNT, AP3216C_NAME);
-	}
-	else
-	{
-		alloc_chrdev_region(&ap3216cdev.devid, 0, AP3216C_CNT, AP3216C_NAME);
-		ap3216cdev.major = MAJOR(ap3216cdev.devid);
-	}
-
-	/* 2. 注册设备 */
-	cdev_init(&ap3216cdev.cdev, &ap3216c_ops);
-	cdev_add(&ap3216cdev.cdev, ap3216cdev.devid, AP3216C_CNT);
+	int ret = 0;
+	ap3216c_dev_t *dev = NULL;
 
-	/* 3. 创建类 */
-	ap3216cdev.class = class_create(THIS_MODULE, AP3216C_NAME);
-	if (IS_ERR(ap3216cdev.class))
+	/* 每个i2c设备一份状态，文件打开期间解绑时由最后一次close释放 */
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (dev == NULL)
 	{
-		return PTR_ERR(ap3216cdev.class);
+		return -ENOMEM;
 	}
-	
-	/* 4. 创建设备 */
-	ap3216cdev.device = device_create(ap3216cdev.class, NULL, ap3216cdev.devid, 
-										NULL, AP3216C_NAME);
-	if (IS_ERR(ap3216cdev.device))
+	drv_ref_init(&dev->ref);
+	dev->private_data = client;
+	i2c_set_clientdata(client, dev);
+
+	ret = drv_chrdev_add(&dev->chrdev, &client->dev, AP3216C_NAME, &ap3216c_ops, dev);
+	if (ret < 0)
 	{
-		return PTR_ERR(ap3216cdev.device);
+		kfree(dev);
 	}
 
-	ap3216cdev.private_data = client;
-
-	return 0;
+	return ret;
 }
 
 /**=============================================================================
  * @brief           i2c驱动的remove函数
  *
+ * 先注销字符设备使新的open失败，再置dead使已打开的文件返回-ENODEV，
+ * 最后释放probe的引用，状态在最后一次close时释放
+ *
  * @param[in]       client:i2c设备	
  *
- * @return          none
+ * @return          0
  *============================================================================*/
 static int ap3216c_remove(struct i2c_client *client)
 {
-	/* 删除设备 */
-	cdev_del(&ap3216cdev.cdev);
-	unregister_chrdev_region(ap3216cdev.devid, AP3216C_CNT);
+	ap3216c_dev_t *dev = (ap3216c_dev_t*)i2c_get_clientdata(client);
 
-	/* 注销类和设备 */
-	device_destroy(ap3216cdev.class, ap3216cdev.devid);
-	class_destroy(ap3216cdev.class);
+	drv_chrdev_del(&dev->chrdev);
+	drv_ref_kill(&dev->ref);
+	drv_ref_put(&dev->ref, ap3216c_free);
 
 	return 0;
 }
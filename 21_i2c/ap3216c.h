@@ -34,11 +34,33 @@ extern "C"{
 #define AP3216C_PSDATALOW	0X0E	/* PS数据低字节 	*/
 #define AP3216C_PSDATAHIGH	0X0F	/* PS数据高字节 	*/
 
+#define AP3216C_IR_OF		0x80	/* IRDATALOW中的IR溢出位，置位时IR和PS无效 */
+
 /* Exported macros -----------------------------------------------------------*/
 /* Exported typedef ----------------------------------------------------------*/
 /* Exported variables ------------------------------------------------------- */
 /* Exported functions ------------------------------------------------------- */
 
+/**=============================================================================
+ * @brief           解析从AP3216C_IRDATALOW开始的6个数据寄存器
+ *
+ * IR为10位：高字节8位 + 低字节bit1:0；PS为10位：高字节bit5:0 + 低字节bit3:0，
+ * 只依赖寄存器内容，驱动和用户空间程序都可以直接使用
+ *
+ * @param[in]       buf:6个寄存器的值
+ * @param[out]		out:{ir, als, ps}
+ *
+ * @return          none
+ *============================================================================*/
+static inline void ap3216c_decode(const unsigned char *buf, unsigned short *out)
+{
+	int of = buf[0] & AP3216C_IR_OF;
+
+	out[0] = of ? 0 : (((unsigned short)buf[1] << 2) | (buf[0] & 0x03));
+	out[1] = ((unsigned short)buf[3] << 8) | buf[2];
+	out[2] = of ? 0 : ((((unsigned short)buf[5] & 0x3F) << 4) | (buf[4] & 0x0F));
+}
+
 #ifdef __cplusplus
 }
 #endif
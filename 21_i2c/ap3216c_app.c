@@ -64,7 +64,7 @@ int main(int argc, char *argv[])
 	while (1)
 	{
 		ret = read(fd, data, sizeof(data));
-		if (ret == 0)
+		if (ret == sizeof(data))
 		{
 			printf("ir = %d, als = %d, ps = %d\r\n", data[0], data[1], data[2]);
 		}
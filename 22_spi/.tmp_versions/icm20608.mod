@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/22_spi/icm20608.ko
-/home/xieli/linux/linux_drivers/22_spi/icm20608.o
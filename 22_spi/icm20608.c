@@ -23,42 +23,38 @@
 #include <linux/device.h>
 #include <linux/timer.h>
 #include <linux/spi/spi.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 
 #include "icm20608.h"
+#include "../common/drv_chrdev.h"
+#include "../common/drv_ref.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define ICM20608_CNT				1			/*!< 设备号个数 */
 #define ICM20608_NAME				"icm20608"	/*!< 设备名 */
+#define ICM20608_MAX_RECORDS		16			/*!< 一次read()最多返回的记录数，每条等一个新的采样，16条约16ms */
+#define ICM20608_SAMPLE_NS			1000000		/*!< 采样周期，SMPLRT_DIV为0时1kHz */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
-/* icm20608设备结构体 */
+/* icm20608设备结构体，probe和每个打开的文件各持有一个引用 */
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
+	drv_ref_t ref;			/*!< 引用计数，dead后不再访问spi设备 */
 	struct device_node *nd; /*!< 设备节点 */
-	int major;				/*!< 主设备号 */
 	void *private_data;		/*!< 私有数据 */
 	int cs_gpio;			/*!< 片选所使用的GPIO编号 */
-	signed int gyro_x_adc;		/* 陀螺仪X轴原始值 	*/
-	signed int gyro_y_adc;		/* 陀螺仪Y轴原始值 	*/
-	signed int gyro_z_adc;		/* 陀螺仪Z轴原始值 	*/
-	signed int accel_x_adc;		/* 加速度计X轴原始值 */
-	signed int accel_y_adc;		/* 加速度计Y轴原始值 */
-	signed int accel_z_adc;		/* 加速度计Z轴原始值 */
-	signed int temp_adc;		/* 温度原始值 	*/
+	ktime_t ready;			/*!< 下一个采样产生的时间，之前读到的还是上一条记录 */
 }icm20608_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
-static icm20608_dev_t icm20608dev;
-
 /* 传统匹配方式列表 */
 static const struct spi_device_id icm20608_id[] = {
 	{"xli,icm20608", 0},
@@ -87,14 +83,14 @@ static struct spi_driver icm20608_driver = {
 };
 
 static int icm20608_open(struct inode *inode, struct file *filp);
-static ssize_t icm20608_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off);
+static ssize_t icm20608_read_iter(struct kiocb *iocb, struct iov_iter *to);
 static int icm20608_release(struct inode *inode, struct file *filp);
 
 /* icm20608操作函数 */
 static const struct file_operations icm20608_ops = {
 	.owner = THIS_MODULE,
 	.open = icm20608_open,
-	.read = icm20608_read,
+	.read_iter = icm20608_read_iter,
 	.release = icm20608_release,
 };
 
@@ -211,52 +207,46 @@ static void icm20608_write_reg(icm20608_dev_t *dev, u8 reg, u8 data)
 /**=============================================================================
  * @brief           读取ICM20608原始数据
  *
- * @param[in]       none
+ * @param[in]       dev:设备
+ * @param[out]		rec:{gx, gy, gz, ax, ay, az, temp}
  *
  * @return          none
  *============================================================================*/
-static void icm20608_read_raw_data(icm20608_dev_t *dev)
+static void icm20608_read_raw_data(icm20608_dev_t *dev, signed int *rec)
 {
 	unsigned char data[14] = {0};
-	icm20608_read_regs(dev, ICM20_ACCEL_XOUT_H, data, 14);
-
-	dev->accel_x_adc = (signed short)((data[0] << 8) | data[1]);
-	dev->accel_y_adc = (signed short)((data[2] << 8) | data[3]);
-	dev->accel_z_adc = (signed short)((data[4] << 8) | data[5]);
-	dev->temp_adc 	 = (signed short)((data[6] << 8) | data[7]);
-	dev->gyro_x_adc  = (signed short)((data[8] << 8) | data[9]);
-	dev->gyro_y_adc  = (signed short)((data[10] << 8) | data[11]);
-	dev->gyro_z_adc  = (signed short)((data[12] << 8) | data[13]);
 
+	icm20608_read_regs(dev, ICM20_ACCEL_XOUT_H, data, 14);
+	icm20608_decode(data, rec);
 }
 
 /**=============================================================================
  * @brief           icm20608内部寄存器初始化
  *
- * @param[in]       none
+ * @param[in]       dev:设备
  *
  * @return          none
  *============================================================================*/
-static void icm20608_reg_init(void)
+static void icm20608_reg_init(icm20608_dev_t *dev)
 {
 	u8 value = 0;
 
-	icm20608_write_reg(&icm20608dev, ICM20_PWR_MGMT_1, 0x80);
+	icm20608_write_reg(dev, ICM20_PWR_MGMT_1, 0x80);
 	mdelay(50);
-	icm20608_write_reg(&icm20608dev, ICM20_PWR_MGMT_1, 0x01);
+	icm20608_write_reg(dev, ICM20_PWR_MGMT_1, 0x01);
 	mdelay(50);
 
-	value = icm20608_read_reg(&icm20608dev, ICM20_WHO_AM_I);
+	value = icm20608_read_reg(dev, ICM20_WHO_AM_I);
 	printk("ICM20608 ID = %#X\r\n", value);
 
-	icm20608_write_reg(&icm20608dev, ICM20_SMPLRT_DIV, 0x00);
-	icm20608_write_reg(&icm20608dev, ICM20_GYRO_CONFIG, 0x18);
-	icm20608_write_reg(&icm20608dev, ICM20_ACCEL_CONFIG, 0x18);
-	icm20608_write_reg(&icm20608dev, ICM20_CONFIG, 0x04);
-	icm20608_write_reg(&icm20608dev, ICM20_ACCEL_CONFIG2, 0x04);
-	icm20608_write_reg(&icm20608dev, ICM20_PWR_MGMT_2, 0x00);
-	icm20608_write_reg(&icm20608dev, ICM20_LP_MODE_CFG, 0x00);
-	icm20608_write_reg(&icm20608dev, ICM20_FIFO_EN, 0x00);
+	icm20608_write_reg(dev, ICM20_SMPLRT_DIV, 0x00);
+	icm20608_write_reg(dev, ICM20_GYRO_CONFIG, 0x18);
+	icm20608_write_reg(dev, ICM20_ACCEL_CONFIG, 0x18);
+	icm20608_write_reg(dev, ICM20_CONFIG, 0x04);
+	icm20608_write_reg(dev, ICM20_ACCEL_CONFIG2, 0x04);
+	icm20608_write_reg(dev, ICM20_PWR_MGMT_2, 0x00);
+	icm20608_write_reg(dev, ICM20_LP_MODE_CFG, 0x00);
+	icm20608_write_reg(dev, ICM20_FIFO_EN, 0x00);
 
 }
 
@@ -266,56 +256,108 @@ static void icm20608_reg_init(void)
  * @param[in]       inode:节点
  * @param[in]		filp:设备文件
  *
- * @return          none
+ * @return          0
  *============================================================================*/
 static int icm20608_open(struct inode *inode, struct file *filp)
 {
-	filp->private_data = &icm20608dev;
+	icm20608_dev_t *dev = (icm20608_dev_t*)filp->private_data;
+
+	/* drv_chrdev_del等待open返回，此时probe的引用还在 */
+	drv_ref_get(&dev->ref);
 
 	return 0;
 }
 
 /**=============================================================================
- * @brief           从设备读取数据
+ * @brief           从设备读取数据，每条记录为int[7]{gx, gy, gz, ax, ay, az, temp}
  *
- * @param[in]       filp:设备文件
- * @param[out]		buf:用户空间的数据缓冲区
- * @param[in]		cnt:要读取的数据长度
- * @param[in]		off:相对于文件首地址的偏移
+ * read()/readv()都经过这里，缓冲区能放下几条完整记录就读几条，
+ * 记录可以跨越readv的多个缓冲区。一次spi读只要几十us，连续读会读到同一个
+ * 采样，所以每条记录前等到下一个1kHz采样产生，一次最多ICM20608_MAX_RECORDS条，
+ * 读取过程中有信号到来时返回已读出的记录
  *
- * @return          读取的字节数
+ * @param[in]       iocb:请求，ki_filp为设备文件
+ * @param[out]		to:用户空间的数据缓冲区
+ *
+ * @return          读取的字节数;-EINVAL:缓冲区放不下一条记录;-EFAULT:拷贝失败;
+ *					-ENODEV:设备已解绑;-ERESTARTSYS
  *============================================================================*/
-static ssize_t icm20608_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+static ssize_t icm20608_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
+	int ret = 0;
 	signed int data[7] = {0};
-	long err = 0;
+	size_t done = 0;
+	size_t copied = 0;
+	unsigned int n = 0;
+	s64 us = 0;
 
-	icm20608_dev_t *dev = (icm20608_dev_t*)filp->private_data;
+	icm20608_dev_t *dev = (icm20608_dev_t*)iocb->ki_filp->private_data;
+
+	if (iov_iter_count(to) < sizeof(data))
+	{
+		return -EINVAL;
+	}
 
-	icm20608_read_raw_data(dev);
+	ret = drv_ref_enter(&dev->ref);
+	if (ret)
+	{
+		return ret;
+	}
 
-	data[0] = dev->gyro_x_adc;
-	data[1] = dev->gyro_y_adc;
-	data[2] = dev->gyro_z_adc;
-	data[3] = dev->accel_x_adc;
-	data[4] = dev->accel_y_adc;
-	data[5] = dev->accel_z_adc;
-	data[6] = dev->temp_adc;
-	err = copy_to_user(buf, data, sizeof(data));
-	
-	return 0;
+	for (n = 0; (n < ICM20608_MAX_RECORDS) && (iov_iter_count(to) >= sizeof(data)); n++)
+	{
+		if (n && signal_pending(current))
+		{
+			break;
+		}
+
+		us = ktime_us_delta(dev->ready, ktime_get());
+		if (us > 0)		/*!< 最多等一个采样周期，不放开锁 */
+		{
+			usleep_range(us, us + 50);
+		}
+
+		icm20608_read_raw_data(dev, data);
+		dev->ready = ktime_add_ns(ktime_get(), ICM20608_SAMPLE_NS);
+		copied = copy_to_iter(data, sizeof(data), to);
+		done += copied;
+		if (copied < sizeof(data))
+		{
+			break;
+		}
+	}
+
+	drv_ref_leave(&dev->ref);
+
+	return done ? done : -EFAULT;
+}
+
+/**=============================================================================
+ * @brief           最后一个引用释放时释放设备状态
+ *
+ * @param[in]       kref:icm20608_dev_t中的ref.kref
+ *
+ * @return          none
+ *============================================================================*/
+static void icm20608_free(struct kref *kref)
+{
+	kfree(container_of(kref, icm20608_dev_t, ref.kref));
 }
 
 /**=============================================================================
- * @brief           关闭设备
+ * @brief           关闭设备，释放open持有的引用
  *
  * @param[in]       inode:节点
  * @param[in]		filp:设备文件
  *
- * @return          none
+ * @return          0
  *============================================================================*/
 static int icm20608_release(struct inode *inode, struct file *filp)
 {
+	icm20608_dev_t *dev = (icm20608_dev_t*)filp->private_data;
+
+	drv_ref_put(&dev->ref, icm20608_free);
+
 	return 0;
 }
 
@@ -329,59 +371,39 @@ static int icm20608_release(struct inode *inode, struct file *filp)
 static int icm20608_probe(struct spi_device *spi)
 {
 	int ret = 0;
+	icm20608_dev_t *dev = NULL;
 
 	printk("icm20608 devices and driver mathced\r\n");
 
-	/* 1. 构建设备号 */
-	if (icm20608dev.major)
-	{
-		icm20608dev.devid = MKDEV(icm20608dev.major, 0);
-		register_chrdev_region(icm20608dev.devid, ICM20608_CNT, ICM20608_NAME);
-	}
-	else
-	{
-		alloc_chrdev_region(&icm20608dev.devid, 0, ICM20608_CNT, ICM20608_NAME);
-		icm20608dev.major = MAJOR(icm20608dev.devid);
-	}
-
-	/* 2. 注册设备 */
-	cdev_init(&icm20608dev.cdev, &icm20608_ops);
-	cdev_add(&icm20608dev.cdev, icm20608dev.devid, ICM20608_CNT);
-
-	/* 3. 创建类 */
-	icm20608dev.class = class_create(THIS_MODULE, ICM20608_NAME);
-	if (IS_ERR(icm20608dev.class))
+	/* 每个spi设备一份状态，文件打开期间解绑时由最后一次close释放 */
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (dev == NULL)
 	{
-		return PTR_ERR(icm20608dev.class);
-	}
-	
-	/* 4. 创建设备 */
-	icm20608dev.device = device_create(icm20608dev.class, NULL, icm20608dev.devid, 
-										NULL, ICM20608_NAME);
-	if (IS_ERR(icm20608dev.device))
-	{
-		return PTR_ERR(icm20608dev.device);
+		return -ENOMEM;
 	}
+	drv_ref_init(&dev->ref);
 
 	/* 获取设备树中CS片选信号 */
-	icm20608dev.nd = of_find_node_by_path(
+	dev->nd = of_find_node_by_path(
 		"/soc/aips-bus@02000000/spba-bus@02000000/ecspi@02010000");
-	if (icm20608dev.nd == NULL)
+	if (dev->nd == NULL)
 	{
 		printk("ecspi3 node not find!\r\n");
-		return -EINVAL;
+		ret = -EINVAL;
+		goto fail;
 	}
 	
 	/* 获取设备树中断GPIO属性，得到BEEP所使用的BEEP编号 */
-	icm20608dev.cs_gpio = of_get_named_gpio(icm20608dev.nd, "cs-gpio", 0);
-	if (icm20608dev.cs_gpio < 0)
+	dev->cs_gpio = of_get_named_gpio(dev->nd, "cs-gpio", 0);
+	if (dev->cs_gpio < 0)
 	{
 		printk("can't get cs-gpio");
-		return -EINVAL;
+		ret = -EINVAL;
+		goto fail;
 	}
 	
 	/* 设置GPIO1_IO20为输出，高电平 */
-	ret = gpio_direction_output(icm20608dev.cs_gpio, 1);
+	ret = gpio_direction_output(dev->cs_gpio, 1);
 	if (ret < 0)
 	{
 		printk("can't set gpio!\r\n");
@@ -390,32 +412,45 @@ static int icm20608_probe(struct spi_device *spi)
 	/* 初始化 spi_device */
 	spi->mode = SPI_MODE_0;
 	spi_setup(spi);
-	icm20608dev.private_data = spi;	/*!< 设置私有数据 */
+	dev->private_data = spi;	/*!< 设置私有数据 */
+	spi_set_drvdata(spi, dev);
 
 	/* 初始化ICM20608内部寄存器 */
-	icm20608_reg_init();
+	icm20608_reg_init(dev);
+
+	/* 最后创建设备节点 */
+	ret = drv_chrdev_add(&dev->chrdev, &spi->dev, ICM20608_NAME, &icm20608_ops, dev);
+	if (ret < 0)
+	{
+		goto fail;
+	}
 
 	printk("icm20608 driver probe finished\r\n");
 
 	return 0;
+
+fail:
+	kfree(dev);
+	return ret;
 }
 
 /**=============================================================================
- * @brief           i2c驱动的remove函数
+ * @brief           spi驱动的remove函数
  *
- * @param[in]       client:i2c设备	
+ * 先注销字符设备使新的open失败，再置dead使已打开的文件返回-ENODEV，
+ * 最后释放probe的引用，状态在最后一次close时释放
  *
- * @return          none
+ * @param[in]       spi:spi设备
+ *
+ * @return          0
  *============================================================================*/
 static int icm20608_remove(struct spi_device *spi)
 {
-	/* 删除设备 */
-	cdev_del(&icm20608dev.cdev);
-	unregister_chrdev_region(icm20608dev.devid, ICM20608_CNT);
+	icm20608_dev_t *dev = (icm20608_dev_t*)spi_get_drvdata(spi);
 
-	/* 注销类和设备 */
-	device_destroy(icm20608dev.class, icm20608dev.devid);
-	class_destroy(icm20608dev.class);
+	drv_chrdev_del(&dev->chrdev);
+	drv_ref_kill(&dev->ref);
+	drv_ref_put(&dev->ref, icm20608_free);
 
 	return 0;
 }
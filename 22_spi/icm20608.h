@@ -97,10 +97,33 @@ extern "C"{
 #define	ICM20_ZA_OFFSET_L 			0x7E
 
 /* Exported macros -----------------------------------------------------------*/
+#define ICM20608_BE16(p)	((signed short)(((p)[0] << 8) | (p)[1]))	/* 大端16位有符号数 */
 /* Exported typedef ----------------------------------------------------------*/
 /* Exported variables ------------------------------------------------------- */
 /* Exported functions ------------------------------------------------------- */
 
+/**=============================================================================
+ * @brief           解析从ICM20_ACCEL_XOUT_H开始的14个数据寄存器
+ *
+ * 寄存器顺序为ax ay az temp gx gy gz，每个通道为大端16位有符号数，
+ * 输出按读出记录的顺序排列，只依赖寄存器内容，驱动和用户空间程序都可以直接使用
+ *
+ * @param[in]       raw:14个寄存器的值
+ * @param[out]		rec:{gx, gy, gz, ax, ay, az, temp}
+ *
+ * @return          none
+ *============================================================================*/
+static inline void icm20608_decode(const unsigned char *raw, int *rec)
+{
+	rec[0] = ICM20608_BE16(raw + 8);
+	rec[1] = ICM20608_BE16(raw + 10);
+	rec[2] = ICM20608_BE16(raw + 12);
+	rec[3] = ICM20608_BE16(raw + 0);
+	rec[4] = ICM20608_BE16(raw + 2);
+	rec[5] = ICM20608_BE16(raw + 4);
+	rec[6] = ICM20608_BE16(raw + 6);
+}
+
 
 #ifdef __cplusplus
 }
@@ -70,7 +70,7 @@ int main(int argc, char *argv[])
 	while (1)
 	{
 		ret = read(fd, databuf, sizeof(databuf));
-		if(ret == 0) 	/* 数据读取成功 */
+		if(ret == sizeof(databuf)) 	/* 数据读取成功 */
 		{ 			
 			gyro_x_adc = databuf[0];
 			gyro_y_adc = databuf[1];
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/2_led/led.ko
-/home/xieli/linux/linux_drivers/2_led/led.o
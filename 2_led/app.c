@@ -18,6 +18,7 @@
 #include "fcntl.h"
 #include "stdlib.h"
 #include "string.h"
+#include "../common/led_bank.h"
 
 /* Private constants ---------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
@@ -39,9 +40,11 @@ int main(int argc, char *argv[])
 	char *filename;
 	unsigned char databuf = 0;
 
-	if (argc != 3)
+	if ((argc != 3) && (argc != 4))
 	{
 		printf("Error usage!\r\n");
+		printf("  %s <dev> <0|1>\r\n", argv[0]);
+		printf("  %s <dev> <mask> <value>\r\n", argv[0]);
 		return -1;
 	}
 
@@ -55,8 +58,19 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	databuf = atoi(argv[2]);
-	retvalue = write(fd, &databuf, sizeof(databuf));
+	if (argc == 4)	/*!< 按掩码一次更新多个LED */
+	{
+		struct led_bank_cmd cmd;
+
+		cmd.mask = strtoul(argv[2], NULL, 0);
+		cmd.value = strtoul(argv[3], NULL, 0);
+		retvalue = write(fd, &cmd, sizeof(cmd));
+	}
+	else
+	{
+		databuf = atoi(argv[2]);
+		retvalue = write(fd, &databuf, sizeof(databuf));
+	}
 	if (retvalue < 0)
 	{
 		printf("LED control failed!\r\n");
@@ -22,6 +22,9 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/led_bank.h"
+#include "../common/led_stats.h"
 
 /* Private constants ---------------------------------------------------------*/
 #define LED_MAJOR	200		/*!< 主设备号 */
@@ -29,8 +32,9 @@
 
 /* 寄存器物理地址 */
 #define CCM_CCGR1_BASE              (0x020C406C)
-#define SW_MUX_GPIO1_IO03_BASE		(0x020E0068)
-#define SW_PAD_GPIO1_IO03_BASE		(0x020E02F4)
+#define SW_MUX_GPIO1_IO00_BASE		(0x020E005C)	/*!< GPIO1_IO00~IO09连续排列 */
+#define SW_PAD_GPIO1_IO00_BASE		(0x020E02E8)
+#define GPIO1_IO_PAD_NUM			10				/*!< GPIO1_IO00~IO09 */
 #define GPIO1_DR_BASE		        (0x0209C000)
 #define GPIO1_GDIR_BASE		        (0x0209C004)
 
@@ -39,11 +43,22 @@
 /* Private variables ---------------------------------------------------------*/
 /* 映射后的寄存器虚拟地址指针 */
 static void __iomem *IMX6U_CCM_CCGR1;
-static void __iomem *SW_MUX_GPIO1_IO03;
-static void __iomem *SW_PAD_GPIO1_IO03;
+static void __iomem *SW_MUX_GPIO1_IO00;
+static void __iomem *SW_PAD_GPIO1_IO00;
 static void __iomem *GPIO1_DR;
 static void __iomem *GPIO1_GDIR;
 
+static drv_chrdev_t led_chrdev;
+static led_bank_t led_bank;
+static led_stats_t led_stats;
+
+static unsigned int led_pins = (1 << 3);	/*!< 管理的LED引脚，默认GPIO1_IO03 */
+module_param(led_pins, uint, S_IRUGO);
+MODULE_PARM_DESC(led_pins, "bitmask of GPIO1_IO00..IO09 pins driven as LEDs");
+
+static bool led_verify = false;	/*!< 写DR前回读，检查LED引脚并保留同一bank其他驱动的引脚 */
+module_param(led_verify, bool, S_IRUGO);
+MODULE_PARM_DESC(led_verify, "read GPIO1_DR before every write: warn when the LED pins were changed by someone else and keep the other pins current; needed when another driver toggles a pin on GPIO1");
 
 /* Private function ----------------------------------------------------------*/
 static int led_open(struct inode *inode, struct file *flip);
@@ -68,19 +83,7 @@ static struct file_operations led_fops = {
  *============================================================================*/
 static void led_switch(uint8_t on)
 {
-	uint32_t val = 0;
-
-    val = readl(GPIO1_DR);
-	if (on)
-	{
-		val &= ~(1<<3);
-	}
-	else
-	{
-		val |= (1<<3);
-	}
-
-    writel(val, GPIO1_DR);
+	led_bank_update(&led_bank, led_pins, on ? led_pins : 0);
 }
 
 /**=============================================================================
@@ -120,20 +123,14 @@ static ssize_t led_read(struct file *flip, char __user *buf, size_t cnt, loff_t
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
-	uint8_t databuf;
-
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
-	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
-	}
+	ssize_t ret = 0;
+	u64 start = led_stats_begin();
 
-    printk("databuf=%d\r\n", databuf);
-	led_switch(databuf);
+	/* 1字节开关全部LED，或struct led_bank_cmd按掩码一次更新多个LED */
+	ret = led_bank_write(&led_bank, buf, cnt);
+	led_stats_end(&led_stats, start, ret);
 
-	return 0;
+	return ret;
 }
 
 /**=============================================================================
@@ -148,6 +145,22 @@ static int led_release(struct inode *inode, struct file *flip)
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           取消寄存器映射
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void led_unmap(void)
+{
+	iounmap(IMX6U_CCM_CCGR1);
+	iounmap(SW_MUX_GPIO1_IO00);
+	iounmap(SW_PAD_GPIO1_IO00);
+	iounmap(GPIO1_DR);
+	iounmap(GPIO1_GDIR);
+}
+
 /**=============================================================================
  * @brief           驱动入口函数
  *
@@ -159,11 +172,14 @@ static int __init led_init(void)
 {
 	int retvalue = 0;
 	uint32_t val = 0;
+	unsigned int i = 0;
+
+	led_pins &= (1 << GPIO1_IO_PAD_NUM) - 1;
 
 	/* 1. 寄存器地址映射 */
 	IMX6U_CCM_CCGR1 = ioremap(CCM_CCGR1_BASE, 4);
-	SW_MUX_GPIO1_IO03 = ioremap(SW_MUX_GPIO1_IO03_BASE, 4);
-	SW_PAD_GPIO1_IO03 = ioremap(SW_PAD_GPIO1_IO03_BASE, 4);
+	SW_MUX_GPIO1_IO00 = ioremap(SW_MUX_GPIO1_IO00_BASE, 4 * GPIO1_IO_PAD_NUM);
+	SW_PAD_GPIO1_IO00 = ioremap(SW_PAD_GPIO1_IO00_BASE, 4 * GPIO1_IO_PAD_NUM);
 	GPIO1_DR = ioremap(GPIO1_DR_BASE, 4);
 	GPIO1_GDIR = ioremap(GPIO1_GDIR_BASE, 4);
 
@@ -174,24 +190,34 @@ static int __init led_init(void)
 	writel(val, IMX6U_CCM_CCGR1);
 
 	/* 3. 设置复用功能，IO属性 */
-	writel(5, SW_MUX_GPIO1_IO03);
-	writel(0x10B0, SW_PAD_GPIO1_IO03);
+	for (i = 0; i < GPIO1_IO_PAD_NUM; i++)
+	{
+		if (led_pins & (1 << i))
+		{
+			writel(5, SW_MUX_GPIO1_IO00 + 4 * i);
+			writel(0x10B0, SW_PAD_GPIO1_IO00 + 4 * i);
+		}
+	}
 
-	/* 4. 设置GPIO1_IO03输出功能 */
-	val = readl(GPIO1_DR);
-	val &= ~(1 << 3);
-	val |= (1 << 3);
+	/* 4. 设置LED引脚输出功能 */
+	val = readl(GPIO1_GDIR);
+	val |= led_pins;
 	writel(val, GPIO1_GDIR);
 
 	/* 5. 默认关闭LED */
-	val = readl(GPIO1_DR);
-	val |= (1 << 3);
-	writel(val, GPIO1_DR);
+	led_bank_init(&led_bank, GPIO1_DR, led_pins, led_verify);
+	led_switch(0);
+	led_stats_init(&led_stats, LED_NAME);
 
-	retvalue = register_chrdev(LED_MAJOR, LED_NAME, &led_fops);
+	/* 6. 使用固定的主设备号注册，同时创建/dev/led */
+	led_chrdev.major = LED_MAJOR;
+	retvalue = drv_chrdev_add(&led_chrdev, NULL, LED_NAME, &led_fops, NULL);
 	if (retvalue < 0)
 	{
 		printk("register chrdriver failed\r\n");
+		led_stats_exit(&led_stats);
+		led_unmap();
+		return retvalue;
 	}
 
 	return 0;
@@ -206,13 +232,10 @@ static int __init led_init(void)
  *============================================================================*/
 static void __exit led_exit(void)
 {
-	iounmap(IMX6U_CCM_CCGR1);
-	iounmap(SW_MUX_GPIO1_IO03);
-	iounmap(SW_PAD_GPIO1_IO03);
-	iounmap(GPIO1_DR);
-	iounmap(GPIO1_GDIR);
-	
-	unregister_chrdev(LED_MAJOR, LED_NAME);
+	/* 先注销设备，之后不会再有写操作访问寄存器 */
+	drv_chrdev_del(&led_chrdev);
+	led_stats_exit(&led_stats);
+	led_unmap();
 }
 
 /**
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/3_newchrled/newchrled.ko
-/home/xieli/linux/linux_drivers/3_newchrled/newchrled.o
@@ -24,9 +24,14 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/led_bank.h"
+#include "../common/led_stats.h"
+
+#define CREATE_TRACE_POINTS
+#include "../common/led_trace.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define NEWCHRLED_CNT		1			/*!< 设备号个数 */
 #define NEWCHRLED_NAME		"newchrled"	/*!< 设备名 */
 
 /* 寄存器物理地址 */
@@ -35,16 +40,13 @@
 #define SW_PAD_GPIO1_IO03_BASE		(0x020E02F4)
 #define GPIO1_DR_BASE		        (0x0209C000)
 #define GPIO1_GDIR_BASE		        (0x0209C004)
+#define LED_PIN_MASK				(1 << 3)	/*!< GPIO1_IO03 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
+	led_stats_t stats;		/*!< write()计数 */
 }newchrled_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -57,6 +59,12 @@ static void __iomem *GPIO1_GDIR;
 
 static newchrled_dev_t newchrled;
 
+static led_bank_t led_bank;
+
+static bool led_verify = false;	/*!< 写DR前回读，检查LED引脚并保留同一bank其他驱动的引脚 */
+module_param(led_verify, bool, S_IRUGO);
+MODULE_PARM_DESC(led_verify, "read GPIO1_DR before every write: warn when the LED pins were changed by someone else and keep the other pins current; needed when another driver toggles a pin on GPIO1");
+
 /* Private function ----------------------------------------------------------*/
 static int led_open(struct inode *inode, struct file *flip);
 static ssize_t led_read(struct file *flip, char __user *buf, size_t cnt, loff_t *offt);
@@ -80,19 +88,7 @@ static struct file_operations newchrled_fops = {
  *============================================================================*/
 static void led_switch(uint8_t on)
 {
-	uint32_t val = 0;
-
-    val = readl(GPIO1_DR);
-	if (on)
-	{
-		val &= ~(1<<3);
-	}
-	else
-	{
-		val |= (1<<3);
-	}
-
-    writel(val, GPIO1_DR);
+	led_bank_update(&led_bank, LED_PIN_MASK, on ? LED_PIN_MASK : 0);
 }
 
 /**=============================================================================
@@ -134,20 +130,30 @@ static ssize_t led_read(struct file *filp, char __user *buf, size_t cnt, loff_t
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
+	ssize_t ret = 0;
 	uint8_t databuf;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
+	if (cnt != sizeof(databuf))
 	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
+		ret = -EINVAL;
+		goto out;
 	}
 
-    printk("databuf=%d\r\n", databuf);
+	if (copy_from_user(&databuf, buf, sizeof(databuf)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
+
+	trace_led_write(NEWCHRLED_NAME, databuf);
 	led_switch(databuf);
+	ret = cnt;
 
-	return 0;
+out:
+	led_stats_end(&newchrled.stats, start, ret);
+
+	return ret;
 }
 
 /**=============================================================================
@@ -162,6 +168,22 @@ static int led_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           取消寄存器映射
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void led_unmap(void)
+{
+	iounmap(IMX6U_CCM_CCGR1);
+	iounmap(SW_MUX_GPIO1_IO03);
+	iounmap(SW_PAD_GPIO1_IO03);
+	iounmap(GPIO1_DR);
+	iounmap(GPIO1_GDIR);
+}
+
 /**=============================================================================
  * @brief           驱动入口函数
  *
@@ -171,6 +193,7 @@ static int led_release(struct inode *inode, struct file *filp)
  *============================================================================*/
 static int __init led_init(void)
 {
+	int ret = 0;
 	uint32_t val = 0;
 
 	/* 1. 寄存器地址映射 */
@@ -191,51 +214,26 @@ static int __init led_init(void)
 	writel(0x10B0, SW_PAD_GPIO1_IO03);
 
 	/* 4. 设置GPIO1_IO03输出功能 */
-	val = readl(GPIO1_DR);
-	val &= ~(1 << 3);
-	val |= (1 << 3);
+	val = readl(GPIO1_GDIR);
+	val |= LED_PIN_MASK;
 	writel(val, GPIO1_GDIR);
 
 	/* 5. 默认关闭LED */
-	val = readl(GPIO1_DR);
-	val |= (1 << 3);
-	writel(val, GPIO1_DR);
-
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (newchrled.major)	/*!< 定义了设备号 */
-	{
-		newchrled.devid = MKDEV(newchrled.major, 0);
-		register_chrdev_region(newchrled.devid, NEWCHRLED_CNT, NEWCHRLED_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&newchrled.devid, 0, NEWCHRLED_CNT, NEWCHRLED_NAME);	/*!< 申请设备号 */
-		newchrled.major = MAJOR(newchrled.devid);	/*!< 获取主设备号 */
-		newchrled.minor = MINOR(newchrled.devid);	/*!< 获取次设备号 */
-	}
-	printk("newchrled.major=%d, newchrled.minor=%d\r\n", newchrled.major, newchrled.minor);
+	led_bank_init(&led_bank, GPIO1_DR, LED_PIN_MASK, led_verify);
+	led_switch(0);
 
-	/* 2. 初始化cdev */
-	newchrled.cdev.owner = THIS_MODULE;
-	cdev_init(&newchrled.cdev, &newchrled_fops);
+	led_stats_init(&newchrled.stats, NEWCHRLED_NAME);
 
-	/* 3. 添加一个cdev */
-	cdev_add(&newchrled.cdev, newchrled.devid, NEWCHRLED_CNT);
-
-	/* 4. 创建类 */
-	newchrled.class = class_create(THIS_MODULE, NEWCHRLED_NAME);
-	if (IS_ERR(newchrled.class))
-	{
-		return PTR_ERR(newchrled.class);
-	}
-
-	/* 5. 创建设备 */
-	newchrled.device = device_create(newchrled.class, NULL, newchrled.devid, NULL, NEWCHRLED_NAME);
-	if (IS_ERR(newchrled.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&newchrled.chrdev, NULL, NEWCHRLED_NAME, &newchrled_fops, &newchrled);
+	if (ret < 0)
 	{
-		return PTR_ERR(newchrled.device);
+		led_stats_exit(&newchrled.stats);
+		led_unmap();
+		return ret;
 	}
+	printk("newchrled.major=%d, newchrled.minor=%d\r\n", newchrled.chrdev.major,
+			MINOR(newchrled.chrdev.devid));
 
 	return 0;
 }
@@ -249,18 +247,10 @@ static int __init led_init(void)
  *============================================================================*/
 static void __exit led_exit(void)
 {
-	iounmap(IMX6U_CCM_CCGR1);
-	iounmap(SW_MUX_GPIO1_IO03);
-	iounmap(SW_PAD_GPIO1_IO03);
-	iounmap(GPIO1_DR);
-	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&newchrled.cdev);
-	unregister_chrdev_region(newchrled.devid, NEWCHRLED_CNT);
-
-	device_destroy(newchrled.class, newchrled.devid);
-	class_destroy(newchrled.class);
+	/* 先注销设备，之后不会再有写操作访问寄存器 */
+	drv_chrdev_del(&newchrled.chrdev);
+	led_stats_exit(&newchrled.stats);
+	led_unmap();
 }
 
 /**
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/4_dtsled/dtsled.ko
-/home/xieli/linux/linux_drivers/4_dtsled/dtsled.o
@@ -26,20 +26,17 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/led_bank.h"
+#include "../common/led_stats.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define DTSLED_CNT		1			/*!< 设备号个数 */
 #define DTSLED_NAME		"dtsled"	/*!< 设备名 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 }dtsled_dev_t;
 
@@ -51,6 +48,16 @@ static void __iomem *SW_PAD_GPIO1_IO03;
 static void __iomem *GPIO1_DR;
 static void __iomem *GPIO1_GDIR;
 
+static led_bank_t led_bank;
+static led_stats_t led_stats;
+
+static unsigned int led_pins = (1 << 3);	/*!< 管理的LED引脚，默认GPIO1_IO03 */
+module_param(led_pins, uint, S_IRUGO);
+MODULE_PARM_DESC(led_pins, "bitmask of GPIO1 pins driven as LEDs, pins other than IO03 must be muxed by pinctrl");
+
+static bool led_verify = false;	/*!< 写DR前回读，检查LED引脚并保留同一bank其他驱动的引脚 */
+module_param(led_verify, bool, S_IRUGO);
+MODULE_PARM_DESC(led_verify, "read GPIO1_DR before every write: warn when the LED pins were changed by someone else and keep the other pins current; needed when another driver toggles a pin on GPIO1");
 static dtsled_dev_t dtsled;
 
 /* Private function ----------------------------------------------------------*/
@@ -76,19 +83,7 @@ static struct file_operations dtsled_fops = {
  *============================================================================*/
 static void led_switch(uint8_t on)
 {
-	uint32_t val = 0;
-
-    val = readl(GPIO1_DR);
-	if (on)
-	{
-		val &= ~(1<<3);
-	}
-	else
-	{
-		val |= (1<<3);
-	}
-
-    writel(val, GPIO1_DR);
+	led_bank_update(&led_bank, led_pins, on ? led_pins : 0);
 }
 
 /**=============================================================================
@@ -130,20 +125,14 @@ static ssize_t led_read(struct file *filp, char __user *buf, size_t cnt, loff_t
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
-	uint8_t databuf;
+	ssize_t ret = 0;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
-	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
-	}
+	/* 1字节开关全部LED，或struct led_bank_cmd按掩码一次更新多个LED */
+	ret = led_bank_write(&led_bank, buf, cnt);
+	led_stats_end(&led_stats, start, ret);
 
-    printk("databuf=%d\r\n", databuf);
-	led_switch(databuf);
-
-	return 0;
+	return ret;
 }
 
 /**=============================================================================
@@ -158,6 +147,22 @@ static int led_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           取消寄存器映射
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void led_unmap(void)
+{
+	iounmap(IMX6U_CCM_CCGR1);
+	iounmap(SW_MUX_GPIO1_IO03);
+	iounmap(SW_PAD_GPIO1_IO03);
+	iounmap(GPIO1_DR);
+	iounmap(GPIO1_GDIR);
+}
+
 /**=============================================================================
  * @brief           驱动入口函数
  *
@@ -247,52 +252,27 @@ static int __init led_init(void)
 	writel(5, SW_MUX_GPIO1_IO03);
 	writel(0x10B0, SW_PAD_GPIO1_IO03);
 
-	/* 4. 设置GPIO1_IO03输出功能 */
-	val = readl(GPIO1_DR);
-	val &= ~(1 << 3);
-	val |= (1 << 3);
+	/* 4. 设置LED引脚输出功能 */
+	val = readl(GPIO1_GDIR);
+	val |= led_pins;
 	writel(val, GPIO1_GDIR);
 
 	/* 5. 默认关闭LED */
-	val = readl(GPIO1_DR);
-	val |= (1 << 3);
-	writel(val, GPIO1_DR);
-
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (dtsled.major)	/*!< 定义了设备号 */
-	{
-		dtsled.devid = MKDEV(dtsled.major, 0);
-		register_chrdev_region(dtsled.devid, DTSLED_CNT, DTSLED_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&dtsled.devid, 0, DTSLED_CNT, DTSLED_NAME);	/*!< 申请设备号 */
-		dtsled.major = MAJOR(dtsled.devid);	/*!< 获取主设备号 */
-		dtsled.minor = MINOR(dtsled.devid);	/*!< 获取次设备号 */
-	}
-	printk("dtsled.major=%d, dtsled.minor=%d\r\n", dtsled.major, dtsled.minor);
-
-	/* 2. 初始化cdev */
-	dtsled.cdev.owner = THIS_MODULE;
-	cdev_init(&dtsled.cdev, &dtsled_fops);
+	led_bank_init(&led_bank, GPIO1_DR, led_pins, led_verify);
+	led_switch(0);
 
-	/* 3. 添加一个cdev */
-	cdev_add(&dtsled.cdev, dtsled.devid, DTSLED_CNT);
+	led_stats_init(&led_stats, DTSLED_NAME);
 
-	/* 4. 创建类 */
-	dtsled.class = class_create(THIS_MODULE, DTSLED_NAME);
-	if (IS_ERR(dtsled.class))
-	{
-		return PTR_ERR(dtsled.class);
-	}
-
-	/* 5. 创建设备 */
-	dtsled.device = device_create(dtsled.class, NULL, dtsled.devid, NULL, DTSLED_NAME);
-	if (IS_ERR(dtsled.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&dtsled.chrdev, NULL, DTSLED_NAME, &dtsled_fops, &dtsled);
+	if (ret < 0)
 	{
-		return PTR_ERR(dtsled.device);
+		led_stats_exit(&led_stats);
+		led_unmap();
+		return ret;
 	}
+	printk("dtsled.major=%d, dtsled.minor=%d\r\n", dtsled.chrdev.major,
+			MINOR(dtsled.chrdev.devid));
 
 	return 0;
 }
@@ -306,18 +286,10 @@ static int __init led_init(void)
  *============================================================================*/
 static void __exit led_exit(void)
 {
-	iounmap(IMX6U_CCM_CCGR1);
-	iounmap(SW_MUX_GPIO1_IO03);
-	iounmap(SW_PAD_GPIO1_IO03);
-	iounmap(GPIO1_DR);
-	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&dtsled.cdev);
-	unregister_chrdev_region(dtsled.devid, DTSLED_CNT);
-
-	device_destroy(dtsled.class, dtsled.devid);
-	class_destroy(dtsled.class);
+	/* 先注销设备，之后不会再有写操作访问寄存器 */
+	drv_chrdev_del(&dtsled.chrdev);
+	led_stats_exit(&led_stats);
+	led_unmap();
 }
 
 /**
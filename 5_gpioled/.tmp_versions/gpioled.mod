@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/5_gpioled/gpioled.ko
-/home/xieli/linux/linux_drivers/5_gpioled/gpioled.o
@@ -18,6 +18,8 @@
 #include "fcntl.h"
 #include "stdlib.h"
 #include "string.h"
+#include "sys/ioctl.h"
+#include "../common/led_pwm.h"
 
 /* Private constants ---------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
@@ -39,9 +41,11 @@ int main(int argc, char *argv[])
 	char *filename;
 	unsigned char databuf = 0;
 
-	if (argc != 3)
+	if ((argc != 3) && !((argc == 5) && !strcmp(argv[2], "pwm")))
 	{
 		printf("Error usage!\r\n");
+		printf("  %s <dev> <0|1>\r\n", argv[0]);
+		printf("  %s <dev> pwm <period_us> <duty 0~%d>\r\n", argv[0], LED_PWM_DUTY_MAX);
 		return -1;
 	}
 
@@ -55,6 +59,23 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (argc == 5)	/*!< PWM调光 */
+	{
+		struct led_pwm_cfg cfg;
+
+		cfg.period_us = atoi(argv[3]);
+		cfg.duty = atoi(argv[4]);
+		retvalue = ioctl(fd, LED_PWM_SET, &cfg);
+		if (retvalue < 0)
+		{
+			printf("LED pwm failed!\r\n");
+			close(fd);
+			return -1;
+		}
+		close(fd);
+		return 0;
+	}
+
 	databuf = atoi(argv[2]);
 	retvalue = write(fd, &databuf, sizeof(databuf));
 	if (retvalue < 0)
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/6_beep/beep.ko
-/home/xieli/linux/linux_drivers/6_beep/beep.o
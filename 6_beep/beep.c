@@ -27,22 +27,24 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/led_stats.h"
+#include "../common/led_cmdq.h"
+
+#define CREATE_TRACE_POINTS
+#include "../common/led_trace.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define BEEP_CNT		1			/*!< 设备号个数 */
 #define BEEP_NAME		"beep"		/*!< 设备名 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int beep_gpio;			/*!< beep的GPIO编号 */
+	led_cmdq_t cmdq;		/*!< 异步命令队列 */
+	led_stats_t stats;		/*!< write()计数 */
 }beep_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -59,6 +61,7 @@ static beep_dev_t beep;
 static int beep_open(struct inode *inode, struct file *flip);
 static ssize_t beep_read(struct file *flip, char __user *buf, size_t cnt, loff_t *offt);
 static ssize_t beep_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static unsigned int beep_poll(struct file *filp, struct poll_table_struct *wait);
 static int beep_release(struct inode *inode, struct file *flip);
 
 static struct file_operations beep_fops = {
@@ -66,6 +69,7 @@ static struct file_operations beep_fops = {
 	.open = beep_open,
 	.read = beep_read,
 	.write = beep_write,
+	.poll = beep_poll,
 	.release = beep_release,
 };
 
@@ -123,6 +127,23 @@ static ssize_t beep_read(struct file *filp, char __user *buf, size_t cnt, loff_t
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           在工作队列中执行开关命令
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		value:开关值
+ * @param[in]		tag:未使用
+ *
+ * @return          none
+ *============================================================================*/
+static void beep_apply(led_cmdq_t *q, u8 value, u32 tag)
+{
+	beep_dev_t *dev = container_of(q, beep_dev_t, cmdq);
+
+	/* 开关beep */
+	value?gpio_set_value(dev->beep_gpio, 0):gpio_set_value(dev->beep_gpio, 1);
+}
+
 /**=============================================================================
  * @brief           向设备写数据
  *
@@ -132,23 +153,51 @@ static ssize_t beep_read(struct file *filp, char __user *buf, size_t cnt, loff_t
  *============================================================================*/
 static ssize_t beep_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
+	ssize_t ret = 0;
 	uint8_t databuf;
 	beep_dev_t *dev = filp->private_data;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
+	if (cnt != sizeof(databuf))
 	{
-		printk("kernel write faibeep!\r\n");
-        return -EFAULT;
+		ret = -EINVAL;
+		goto out;
 	}
 
-    printk("databuf=%d\r\n", databuf);
+	if (copy_from_user(&databuf, buf, sizeof(databuf)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
 
-	/* 开关beep */
-	databuf?gpio_set_value(dev->beep_gpio, 0):gpio_set_value(dev->beep_gpio, 1);
+	trace_led_write(BEEP_NAME, databuf);
 
-	return 0;
+	/* 只入队，由工作队列写GPIO，write()不等待 */
+	ret = led_cmdq_push(&dev->cmdq, databuf, 0, filp->f_flags & O_NONBLOCK);
+	if (ret == 0)
+	{
+		ret = cnt;
+	}
+
+out:
+	led_stats_end(&dev->stats, start, ret);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           poll函数，命令队列有空位时可写
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          设备状态
+ *============================================================================*/
+static unsigned int beep_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	beep_dev_t *dev = filp->private_data;
+
+	return led_cmdq_poll(&dev->cmdq, filp, wait);
 }
 
 /**=============================================================================
@@ -293,42 +342,20 @@ static int __init beep_init(void)
 
 	/* 3. 设置GPIO1_IO03为输出，默认关闭beep */
 	ret = gpio_direction_output(beep.beep_gpio, 1);
+	led_cmdq_init(&beep.cmdq, BEEP_NAME, beep_apply);
 
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (beep.major)	/*!< 定义了设备号 */
-	{
-		beep.devid = MKDEV(beep.major, 0);
-		register_chrdev_region(beep.devid, BEEP_CNT, BEEP_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&beep.devid, 0, BEEP_CNT, BEEP_NAME);	/*!< 申请设备号 */
-		beep.major = MAJOR(beep.devid);	/*!< 获取主设备号 */
-		beep.minor = MINOR(beep.devid);	/*!< 获取次设备号 */
-	}
-	printk("beep.major=%d, beep.minor=%d\r\n", beep.major, beep.minor);
-
-	/* 2. 初始化cdev */
-	beep.cdev.owner = THIS_MODULE;
-	cdev_init(&beep.cdev, &beep_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&beep.cdev, beep.devid, BEEP_CNT);
-
-	/* 4. 创建类 */
-	beep.class = class_create(THIS_MODULE, BEEP_NAME);
-	if (IS_ERR(beep.class))
-	{
-		return PTR_ERR(beep.class);
-	}
+	led_stats_init(&beep.stats, BEEP_NAME);
 
-	/* 5. 创建设备 */
-	beep.device = device_create(beep.class, NULL, beep.devid, NULL, BEEP_NAME);
-	if (IS_ERR(beep.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&beep.chrdev, NULL, BEEP_NAME, &beep_fops, &beep);
+	if (ret < 0)
 	{
-		return PTR_ERR(beep.device);
+		led_stats_exit(&beep.stats);
+		led_cmdq_exit(&beep.cmdq);
+		return ret;
 	}
+	printk("beep.major=%d, beep.minor=%d\r\n", beep.chrdev.major,
+			MINOR(beep.chrdev.devid));
 
 	return 0;
 }
@@ -342,18 +369,16 @@ static int __init beep_init(void)
  *============================================================================*/
 static void __exit beep_exit(void)
 {
+	/* 先注销设备，之后不会再有新的写操作 */
+	drv_chrdev_del(&beep.chrdev);
+	led_stats_exit(&beep.stats);
+	led_cmdq_exit(&beep.cmdq);
+
 	iounmap(IMX6U_CCM_CCGR1);
 	iounmap(SW_MUX_GPIO1_IO03);
 	iounmap(SW_PAD_GPIO1_IO03);
 	iounmap(GPIO1_DR);
 	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&beep.cdev);
-	unregister_chrdev_region(beep.devid, BEEP_CNT);
-
-	device_destroy(beep.class, beep.devid);
-	class_destroy(beep.class);
 }
 
 /**
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/7_atomic/atomic.ko
-/home/xieli/linux/linux_drivers/7_atomic/atomic.o
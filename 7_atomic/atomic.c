@@ -27,23 +27,29 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/led_pwm.h"
+#include "../common/led_stats.h"
+#include "../common/led_lease.h"
+#include "../common/led_cmdq.h"
+
+#define CREATE_TRACE_POINTS
+#include "../common/led_trace.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define GPIOLED_CNT		1			/*!< 设备号个数 */
 #define GPIOLED_NAME		"gpioled"	/*!< 设备名 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int led_gpio;			/*!< LED的GPIO编号 */
+	led_pwm_t pwm;			/*!< 软件PWM引擎 */
 	atomic_t lock;			/*!< 原子变量 */
+	led_lease_t lease;		/*!< 共享模式下的独占租用 */
+	led_cmdq_t cmdq;		/*!< 异步命令队列 */
+	led_stats_t stats;		/*!< write()计数 */
 }gpioled_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -56,10 +62,16 @@ static void __iomem *GPIO1_GDIR;
 
 static gpioled_dev_t gpioled;
 
+static bool shared = false;	/*!< 允许多个进程同时打开，每次操作单独加锁 */
+module_param(shared, bool, S_IRUGO);
+MODULE_PARM_DESC(shared, "allow concurrent openers and take the atomic lock for each write instead of holding it from open() to close(), LED_LEASE_ACQUIRE gives exclusive use");
+
 /* Private function ----------------------------------------------------------*/
 static int led_open(struct inode *inode, struct file *flip);
 static ssize_t led_read(struct file *flip, char __user *buf, size_t cnt, loff_t *offt);
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+static unsigned int led_poll(struct file *filp, struct poll_table_struct *wait);
 static int led_release(struct inode *inode, struct file *flip);
 
 static struct file_operations gpioled_fops = {
@@ -67,6 +79,8 @@ static struct file_operations gpioled_fops = {
 	.open = led_open,
 	.read = led_read,
 	.write = led_write,
+	.unlocked_ioctl = led_ioctl,
+	.poll = led_poll,
 	.release = led_release,
 };
 
@@ -94,6 +108,48 @@ static void led_switch(uint8_t on)
     writel(val, GPIO1_DR);
 }
 
+/**=============================================================================
+ * @brief           开始一次操作：共享模式下把原子变量当作自旋锁，独占模式下open已经持有
+ *
+ * 临界区很短且不睡眠，关抢占后忙等，减1后为0表示拿到
+ *
+ * @param[in]       dev:设备
+ *
+ * @return          none
+ *============================================================================*/
+static void led_op_lock(gpioled_dev_t *dev)
+{
+	if (!shared)
+	{
+		return;
+	}
+
+	preempt_disable();
+	while (!atomic_dec_and_test(&dev->lock))
+	{
+		atomic_inc(&dev->lock);
+		cpu_relax();
+	}
+}
+
+/**=============================================================================
+ * @brief           结束led_op_lock()开始的操作
+ *
+ * @param[in]       dev:设备
+ *
+ * @return          none
+ *============================================================================*/
+static void led_op_unlock(gpioled_dev_t *dev)
+{
+	if (!shared)
+	{
+		return;
+	}
+
+	atomic_inc(&dev->lock);
+	preempt_enable();
+}
+
 /**=============================================================================
  * @brief           打开设备
  *
@@ -104,6 +160,12 @@ static void led_switch(uint8_t on)
  *============================================================================*/
 static int led_open(struct inode *inode, struct file *filp)
 {
+	if (shared)	/*!< 共享模式不在open中占用设备 */
+	{
+		filp->private_data = &gpioled;
+		return 0;
+	}
+
 	if (!atomic_dec_and_test(&gpioled.lock))	/*!< 减1后是否为0,为0返回真 */
 	{
 		atomic_inc(&gpioled.lock);	/*!< 原子变量小于0，恢复为0 */
@@ -130,6 +192,38 @@ static ssize_t led_read(struct file *filp, char __user *buf, size_t cnt, loff_t
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           在工作队列中执行开关命令
+ *
+ * 在原子锁内检查租用并写GPIO，入队之后租用变化过的命令被丢弃。
+ * 停止PWM会睡眠，在原子锁外由PWM引擎自己的锁串行化
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		value:开关值
+ * @param[in]		tag:入队时的租用代数
+ *
+ * @return          none
+ *============================================================================*/
+static void led_apply(led_cmdq_t *q, u8 value, u32 tag)
+{
+	gpioled_dev_t *dev = container_of(q, gpioled_dev_t, cmdq);
+
+	if (!led_lease_current(&dev->lease, tag))
+	{
+		return;
+	}
+
+	led_pwm_stop(&dev->pwm);	/*!< 写开关值时退出PWM模式 */
+
+	led_op_lock(dev);
+	if (led_lease_current(&dev->lease, tag))
+	{
+		/* 开关LED */
+		value?gpio_set_value(dev->led_gpio, 0):gpio_set_value(dev->led_gpio, 1);
+	}
+	led_op_unlock(dev);
+}
+
 /**=============================================================================
  * @brief           向设备写数据
  *
@@ -139,23 +233,116 @@ static ssize_t led_read(struct file *filp, char __user *buf, size_t cnt, loff_t
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
+	ssize_t ret = 0;
+	u32 gen = 0;
 	uint8_t databuf;
 	gpioled_dev_t *dev = filp->private_data;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
+	if (cnt != sizeof(databuf))
 	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
+		ret = -EINVAL;
+		goto out;
 	}
 
-    printk("databuf=%d\r\n", databuf);
+	if (copy_from_user(&databuf, buf, sizeof(databuf)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
 
-	/* 开关LED */
-	databuf?gpio_set_value(dev->led_gpio, 0):gpio_set_value(dev->led_gpio, 1);
+	trace_led_write(GPIOLED_NAME, databuf);
 
-	return 0;
+	/* 只入队，由工作队列写GPIO，write()不等待；原子锁内不能睡眠，队列满时放开后等待 */
+	while (1)
+	{
+		led_op_lock(dev);
+		ret = led_lease_check(&dev->lease, filp, &gen);
+		if (ret == 0)
+		{
+			ret = led_cmdq_push(&dev->cmdq, databuf, gen, true);
+		}
+		led_op_unlock(dev);
+
+		if (ret == -EBUSY)	/*!< 被别的打开者租用 */
+		{
+			ret = led_lease_wait(&dev->lease, filp);
+		}
+		else if ((ret == -EAGAIN) && !(filp->f_flags & O_NONBLOCK))
+		{
+			ret = led_cmdq_wait(&dev->cmdq);
+		}
+		else
+		{
+			break;
+		}
+
+		if (ret)
+		{
+			goto out;
+		}
+	}
+
+	if (ret == 0)
+	{
+		ret = cnt;
+	}
+
+out:
+	led_stats_end(&dev->stats, start, ret);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           ioctl函数，处理租用和PWM命令
+ *
+ * @param[in]       filp:设备文件
+ * @parma[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	long ret = 0;
+	gpioled_dev_t *dev = filp->private_data;
+
+	/* 先执行完排队的开关命令，保持顺序 */
+	led_cmdq_flush(&dev->cmdq);
+
+	ret = led_lease_ioctl(&dev->lease, filp, cmd);
+	if (ret != -ENOTTY)
+	{
+		return ret;
+	}
+
+	/* PWM命令会睡眠，不能在原子锁内，只检查租用，由PWM引擎自己的锁串行化 */
+	while (led_lease_check(&dev->lease, filp, NULL))
+	{
+		ret = led_lease_wait(&dev->lease, filp);
+		if (ret)
+		{
+			return ret;
+		}
+	}
+
+	return led_pwm_ioctl(&dev->pwm, cmd, arg);
+}
+
+/**=============================================================================
+ * @brief           poll函数，命令队列有空位时可写
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          设备状态
+ *============================================================================*/
+static unsigned int led_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	gpioled_dev_t *dev = filp->private_data;
+
+	return led_cmdq_poll(&dev->cmdq, filp, wait);
 }
 
 /**=============================================================================
@@ -168,7 +355,14 @@ static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt,
 static int led_release(struct inode *inode, struct file *filp)
 {
 	gpioled_dev_t *dev = filp->private_data;
-	
+
+	led_cmdq_flush(&dev->cmdq);	/*!< 本文件写入的命令在释放租用和设备前执行完 */
+	led_lease_release(&dev->lease, filp);	/*!< 关闭时自动释放租用 */
+	if (shared)
+	{
+		return 0;
+	}
+
 	/* 关闭驱动文件释放原子变量 */
 	atomic_inc(&dev->lock);
 
@@ -309,42 +503,23 @@ static int __init led_init(void)
 
 	/* 3. 设置GPIO1_IO03为输出，默认关闭LED */
 	ret = gpio_direction_output(gpioled.led_gpio, 1);
+	led_pwm_init(&gpioled.pwm, gpioled.led_gpio);
+	led_cmdq_init(&gpioled.cmdq, GPIOLED_NAME, led_apply);
+	led_lease_init(&gpioled.lease);
 
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (gpioled.major)	/*!< 定义了设备号 */
-	{
-		gpioled.devid = MKDEV(gpioled.major, 0);
-		register_chrdev_region(gpioled.devid, GPIOLED_CNT, GPIOLED_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&gpioled.devid, 0, GPIOLED_CNT, GPIOLED_NAME);	/*!< 申请设备号 */
-		gpioled.major = MAJOR(gpioled.devid);	/*!< 获取主设备号 */
-		gpioled.minor = MINOR(gpioled.devid);	/*!< 获取次设备号 */
-	}
-	printk("gpioled.major=%d, gpioled.minor=%d\r\n", gpioled.major, gpioled.minor);
-
-	/* 2. 初始化cdev */
-	gpioled.cdev.owner = THIS_MODULE;
-	cdev_init(&gpioled.cdev, &gpioled_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&gpioled.cdev, gpioled.devid, GPIOLED_CNT);
-
-	/* 4. 创建类 */
-	gpioled.class = class_create(THIS_MODULE, GPIOLED_NAME);
-	if (IS_ERR(gpioled.class))
-	{
-		return PTR_ERR(gpioled.class);
-	}
+	led_stats_init(&gpioled.stats, GPIOLED_NAME);
+	lock_stats_debugfs(&gpioled.lease.stats, "lease_lock", gpioled.stats.dir);
 
-	/* 5. 创建设备 */
-	gpioled.device = device_create(gpioled.class, NULL, gpioled.devid, NULL, GPIOLED_NAME);
-	if (IS_ERR(gpioled.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&gpioled.chrdev, NULL, GPIOLED_NAME, &gpioled_fops, &gpioled);
+	if (ret < 0)
 	{
-		return PTR_ERR(gpioled.device);
+		led_stats_exit(&gpioled.stats);
+		led_cmdq_exit(&gpioled.cmdq);
+		return ret;
 	}
+	printk("gpioled.major=%d, gpioled.minor=%d\r\n", gpioled.chrdev.major,
+			MINOR(gpioled.chrdev.devid));
 
 	return 0;
 }
@@ -358,18 +533,19 @@ static int __init led_init(void)
  *============================================================================*/
 static void __exit led_exit(void)
 {
+	/* 先注销设备，之后不会再有新的写操作 */
+	drv_chrdev_del(&gpioled.chrdev);
+	led_stats_exit(&gpioled.stats);
+	led_cmdq_exit(&gpioled.cmdq);
+
+	led_pwm_stop(&gpioled.pwm);
+	gpio_set_value(gpioled.led_gpio, 1);	/*!< 卸载关闭LED */
+
 	iounmap(IMX6U_CCM_CCGR1);
 	iounmap(SW_MUX_GPIO1_IO03);
 	iounmap(SW_PAD_GPIO1_IO03);
 	iounmap(GPIO1_DR);
 	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&gpioled.cdev);
-	unregister_chrdev_region(gpioled.devid, GPIOLED_CNT);
-
-	device_destroy(gpioled.class, gpioled.devid);
-	class_destroy(gpioled.class);
 }
 
 /**
@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/8_spinlock/spinlock.ko
-/home/xieli/linux/linux_drivers/8_spinlock/spinlock.o
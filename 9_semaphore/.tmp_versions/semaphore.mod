@@ -1,2 +0,0 @@
-/home/xieli/linux/linux_drivers/9_semaphore/semaphore.ko
-/home/xieli/linux/linux_drivers/9_semaphore/semaphore.o
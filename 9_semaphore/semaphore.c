@@ -28,23 +28,31 @@
 #include <asm/mach/map.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include "../common/drv_chrdev.h"
+#include "../common/led_pwm.h"
+#include "../common/led_stats.h"
+#include "../common/led_lease.h"
+#include "../common/lock_stats.h"
+#include "../common/led_cmdq.h"
+
+#define CREATE_TRACE_POINTS
+#include "../common/led_trace.h"
 
 /* Private constants ---------------------------------------------------------*/
-#define GPIOLED_CNT		1			/*!< 设备号个数 */
 #define GPIOLED_NAME		"gpioled"	/*!< 设备名 */
 
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 typedef struct {
-	dev_t devid;			/*!< 设备号 */
-	struct cdev cdev;		/*!< cdev */
-	struct class *class;	/*!< 类 */
-	struct device *device;	/*!< 设备 */
-	int major;				/*!< 主设备号 */
-	int minor;				/*!< 次设备号 */
+	drv_chrdev_t chrdev;	/*!< 字符设备 */
 	struct device_node *nd; /*!< 设备节点 */
 	int led_gpio;			/*!< LED的GPIO编号 */
+	led_pwm_t pwm;			/*!< 软件PWM引擎 */
 	struct semaphore sem;	/*!< 信号量 */
+	lock_stats_t lock_stats;	/*!< 锁竞争统计 */
+	led_lease_t lease;		/*!< 共享模式下的独占租用 */
+	led_cmdq_t cmdq;		/*!< 异步命令队列 */
+	led_stats_t stats;		/*!< write()计数 */
 }gpioled_dev_t;
 
 /* Private variables ---------------------------------------------------------*/
@@ -57,10 +65,16 @@ static void __iomem *GPIO1_GDIR;
 
 static gpioled_dev_t gpioled;
 
+static bool shared = false;	/*!< 允许多个进程同时打开，每次操作单独加锁 */
+module_param(shared, bool, S_IRUGO);
+MODULE_PARM_DESC(shared, "allow concurrent openers and take the lock for each write/ioctl instead of holding it from open() to close(), LED_LEASE_ACQUIRE gives exclusive use");
+
 /* Private function ----------------------------------------------------------*/
 static int led_open(struct inode *inode, struct file *flip);
 static ssize_t led_read(struct file *flip, char __user *buf, size_t cnt, loff_t *offt);
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt);
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
+static unsigned int led_poll(struct file *filp, struct poll_table_struct *wait);
 static int led_release(struct inode *inode, struct file *flip);
 
 static struct file_operations gpioled_fops = {
@@ -68,6 +82,8 @@ static struct file_operations gpioled_fops = {
 	.open = led_open,
 	.read = led_read,
 	.write = led_write,
+	.unlocked_ioctl = led_ioctl,
+	.poll = led_poll,
 	.release = led_release,
 };
 #if 0
@@ -95,6 +111,68 @@ static void led_switch(uint8_t on)
     writel(val, GPIO1_DR);
 }
 #endif
+
+/**=============================================================================
+ * @brief           获取信号量并记录竞争统计，等待时可以被信号打断
+ *
+ * @param[in]       dev:设备
+ *
+ * @return          0:成功;-ERESTARTSYS:被信号打断
+ *============================================================================*/
+static int led_lock(gpioled_dev_t *dev)
+{
+	u64 start = lock_stats_begin();
+	bool contended = (down_trylock(&dev->sem) != 0);
+
+	if (contended && down_interruptible(&dev->sem))
+	{
+		return -ERESTARTSYS;
+	}
+	lock_stats_acquired(&dev->lock_stats, start, contended);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           释放信号量并记录持有时间
+ *
+ * @param[in]       dev:设备
+ *
+ * @return          none
+ *============================================================================*/
+static void led_unlock(gpioled_dev_t *dev)
+{
+	lock_stats_released(&dev->lock_stats);
+	up(&dev->sem);
+}
+
+/**=============================================================================
+ * @brief           开始一次操作：共享模式下获取信号量，独占模式下open已经持有
+ *
+ * @param[in]       dev:设备
+ *
+ * @return          0:成功;-ERESTARTSYS:被信号打断
+ *============================================================================*/
+static int led_op_lock(gpioled_dev_t *dev)
+{
+	return shared ? led_lock(dev) : 0;
+}
+
+/**=============================================================================
+ * @brief           结束led_op_lock()开始的操作
+ *
+ * @param[in]       dev:设备
+ *
+ * @return          none
+ *============================================================================*/
+static void led_op_unlock(gpioled_dev_t *dev)
+{
+	if (shared)
+	{
+		led_unlock(dev);
+	}
+}
+
 /**=============================================================================
  * @brief           打开设备
  *
@@ -107,8 +185,13 @@ static int led_open(struct inode *inode, struct file *filp)
 {
     filp->private_data = &gpioled;	/*!< 设置私有数据 */
 
+	if (shared)	/*!< 共享模式不在open中占用设备 */
+	{
+		return 0;
+	}
+
 	/* 获取信号量，进入休眠状态的进程可以被信号打断 */
-	if (down_interruptible(&gpioled.sem))
+	if (led_lock(&gpioled))
 	{
 		return -ERESTARTSYS;
 	}	
@@ -134,6 +217,37 @@ static ssize_t led_read(struct file *filp, char __user *buf, size_t cnt, loff_t
 	return 0;
 }
 
+/**=============================================================================
+ * @brief           在工作队列中执行开关命令
+ *
+ * 共享模式下在信号量内执行，入队之后租用变化过的命令被丢弃
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		value:开关值
+ * @param[in]		tag:入队时的租用代数
+ *
+ * @return          none
+ *============================================================================*/
+static void led_apply(led_cmdq_t *q, u8 value, u32 tag)
+{
+	gpioled_dev_t *dev = container_of(q, gpioled_dev_t, cmdq);
+
+	if (led_op_lock(dev))
+	{
+		return;
+	}
+
+	if (led_lease_current(&dev->lease, tag))
+	{
+		led_pwm_stop(&dev->pwm);	/*!< 写开关值时退出PWM模式 */
+
+		/* 开关LED */
+		value?gpio_set_value(dev->led_gpio, 0):gpio_set_value(dev->led_gpio, 1);
+	}
+
+	led_op_unlock(dev);
+}
+
 /**=============================================================================
  * @brief           向设备写数据
  *
@@ -143,23 +257,131 @@ static ssize_t led_read(struct file *filp, char __user *buf, size_t cnt, loff_t
  *============================================================================*/
 static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
 {
-	int retvalue = 0;
+	ssize_t ret = 0;
+	u32 gen = 0;
 	uint8_t databuf;
 	gpioled_dev_t *dev = filp->private_data;
+	u64 start = led_stats_begin();
 
-	retvalue = copy_from_user(&databuf, buf, cnt);
-	if (retvalue < 0)
+	if (cnt != sizeof(databuf))
 	{
-		printk("kernel write failed!\r\n");
-        return -EFAULT;
+		ret = -EINVAL;
+		goto out;
 	}
 
-    printk("databuf=%d\r\n", databuf);
+	if (copy_from_user(&databuf, buf, sizeof(databuf)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
 
-	/* 开关LED */
-	databuf?gpio_set_value(dev->led_gpio, 0):gpio_set_value(dev->led_gpio, 1);
+	trace_led_write(GPIOLED_NAME, databuf);
 
-	return 0;
+	/* 只入队，由工作队列写GPIO，write()不等待；执行函数也要拿信号量，队列满时放开后等待 */
+	while (1)
+	{
+		ret = led_op_lock(dev);
+		if (ret)
+		{
+			goto out;
+		}
+		ret = led_lease_check(&dev->lease, filp, &gen);
+		if (ret == 0)
+		{
+			ret = led_cmdq_push(&dev->cmdq, databuf, gen, true);
+		}
+		led_op_unlock(dev);
+
+		if (ret == -EBUSY)	/*!< 被别的打开者租用 */
+		{
+			ret = led_lease_wait(&dev->lease, filp);
+		}
+		else if ((ret == -EAGAIN) && !(filp->f_flags & O_NONBLOCK))
+		{
+			ret = led_cmdq_wait(&dev->cmdq);
+		}
+		else
+		{
+			break;
+		}
+
+		if (ret)
+		{
+			goto out;
+		}
+	}
+
+	if (ret == 0)
+	{
+		ret = cnt;
+	}
+
+out:
+	led_stats_end(&dev->stats, start, ret);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           ioctl函数，处理租用和PWM命令
+ *
+ * @param[in]       filp:设备文件
+ * @parma[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static long led_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	long ret = 0;
+	gpioled_dev_t *dev = filp->private_data;
+
+	/* 先执行完排队的开关命令，保持顺序；工作函数要拿信号量，不能在锁内等待 */
+	led_cmdq_flush(&dev->cmdq);
+
+	ret = led_lease_ioctl(&dev->lease, filp, cmd);
+	if (ret != -ENOTTY)
+	{
+		return ret;
+	}
+
+	while (1)
+	{
+		ret = led_op_lock(dev);
+		if (ret)
+		{
+			return ret;
+		}
+		ret = led_lease_check(&dev->lease, filp, NULL);
+		if (ret == 0)
+		{
+			ret = led_pwm_ioctl(&dev->pwm, cmd, arg);
+			led_op_unlock(dev);
+			return ret;
+		}
+		led_op_unlock(dev);
+
+		ret = led_lease_wait(&dev->lease, filp);
+		if (ret)
+		{
+			return ret;
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           poll函数，命令队列有空位时可写
+ *
+ * @param[in]       filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          设备状态
+ *============================================================================*/
+static unsigned int led_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	gpioled_dev_t *dev = filp->private_data;
+
+	return led_cmdq_poll(&dev->cmdq, filp, wait);
 }
 
 /**=============================================================================
@@ -172,8 +394,15 @@ static ssize_t led_write(struct file *filp, const char __user *buf, size_t cnt,
 static int led_release(struct inode *inode, struct file *filp)
 {
 	gpioled_dev_t *dev = filp->private_data;
-	
-	up(&dev->sem);	/*!< 释放信号量 */
+
+	led_cmdq_flush(&dev->cmdq);	/*!< 本文件写入的命令在释放租用和设备前执行完 */
+	led_lease_release(&dev->lease, filp);	/*!< 关闭时自动释放租用 */
+	if (shared)
+	{
+		return 0;
+	}
+
+	led_unlock(dev);	/*!< 释放信号量 */
 
 	return 0;
 }
@@ -284,6 +513,7 @@ static int __init led_init(void)
 
 	/* 初始化信号量 */
 	sema_init(&gpioled.sem, 1);
+	lock_stats_init(&gpioled.lock_stats);
 
 	/* 设置LED所使用的GPIO */
 	/* 1. 获取设备节点：gpioled */
@@ -312,42 +542,24 @@ static int __init led_init(void)
 
 	/* 3. 设置GPIO1_IO03为输出，默认关闭LED */
 	ret = gpio_direction_output(gpioled.led_gpio, 1);
+	led_pwm_init(&gpioled.pwm, gpioled.led_gpio);
+	led_cmdq_init(&gpioled.cmdq, GPIOLED_NAME, led_apply);
+	led_lease_init(&gpioled.lease);
 
-	/* 注册字符设备驱动 */
-	/* 1. 创建设备号 */
-	if (gpioled.major)	/*!< 定义了设备号 */
-	{
-		gpioled.devid = MKDEV(gpioled.major, 0);
-		register_chrdev_region(gpioled.devid, GPIOLED_CNT, GPIOLED_NAME);
-	}
-	else					/*!< 未定义设备号 */
-	{
-		alloc_chrdev_region(&gpioled.devid, 0, GPIOLED_CNT, GPIOLED_NAME);	/*!< 申请设备号 */
-		gpioled.major = MAJOR(gpioled.devid);	/*!< 获取主设备号 */
-		gpioled.minor = MINOR(gpioled.devid);	/*!< 获取次设备号 */
-	}
-	printk("gpioled.major=%d, gpioled.minor=%d\r\n", gpioled.major, gpioled.minor);
-
-	/* 2. 初始化cdev */
-	gpioled.cdev.owner = THIS_MODULE;
-	cdev_init(&gpioled.cdev, &gpioled_fops);
-
-	/* 3. 添加一个cdev */
-	cdev_add(&gpioled.cdev, gpioled.devid, GPIOLED_CNT);
+	led_stats_init(&gpioled.stats, GPIOLED_NAME);
+	lock_stats_debugfs(&gpioled.lock_stats, "lock", gpioled.stats.dir);
+	lock_stats_debugfs(&gpioled.lease.stats, "lease_lock", gpioled.stats.dir);
 
-	/* 4. 创建类 */
-	gpioled.class = class_create(THIS_MODULE, GPIOLED_NAME);
-	if (IS_ERR(gpioled.class))
-	{
-		return PTR_ERR(gpioled.class);
-	}
-
-	/* 5. 创建设备 */
-	gpioled.device = device_create(gpioled.class, NULL, gpioled.devid, NULL, GPIOLED_NAME);
-	if (IS_ERR(gpioled.device))
+	/* 注册字符设备驱动 */
+	ret = drv_chrdev_add(&gpioled.chrdev, NULL, GPIOLED_NAME, &gpioled_fops, &gpioled);
+	if (ret < 0)
 	{
-		return PTR_ERR(gpioled.device);
+		led_stats_exit(&gpioled.stats);
+		led_cmdq_exit(&gpioled.cmdq);
+		return ret;
 	}
+	printk("gpioled.major=%d, gpioled.minor=%d\r\n", gpioled.chrdev.major,
+			MINOR(gpioled.chrdev.devid));
 
 	return 0;
 }
@@ -361,18 +573,19 @@ static int __init led_init(void)
  *============================================================================*/
 static void __exit led_exit(void)
 {
+	/* 先注销设备，之后不会再有新的写操作 */
+	drv_chrdev_del(&gpioled.chrdev);
+	led_stats_exit(&gpioled.stats);
+	led_cmdq_exit(&gpioled.cmdq);
+
+	led_pwm_stop(&gpioled.pwm);
+	gpio_set_value(gpioled.led_gpio, 1);	/*!< 卸载关闭LED */
+
 	iounmap(IMX6U_CCM_CCGR1);
 	iounmap(SW_MUX_GPIO1_IO03);
 	iounmap(SW_PAD_GPIO1_IO03);
 	iounmap(GPIO1_DR);
 	iounmap(GPIO1_GDIR);
-	
-	/* 注销字符设备 */
-	cdev_del(&gpioled.cdev);
-	unregister_chrdev_region(gpioled.devid, GPIOLED_CNT);
-
-	device_destroy(gpioled.class, gpioled.devid);
-	class_destroy(gpioled.class);
 }
 
 /**
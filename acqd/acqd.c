@@ -0,0 +1,580 @@
+/**
+  ******************************************************************************
+  * @file			acqd.c
+  * @brief			传感器和按键的采集守护进程，一个epoll循环驱动所有设备并分发给订阅者
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-04
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 编译：arm-linux-gnueabihf-gcc acqd.c shm_ring.c ../20_input/input_reader.c -I../20_input -o acqd -lrt
+  * 使用：./acqd -i /dev/icm20608:10 -a /dev/ap3216c:200 -k /dev/input/event1 -m /acqd
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include "stdio.h"
+#include "unistd.h"
+#include "stdint.h"
+#include "sys/types.h"
+#include "sys/stat.h"
+#include "sys/epoll.h"
+#include "sys/timerfd.h"
+#include "sys/socket.h"
+#include "sys/uio.h"
+#include "sys/un.h"
+#include "sys/mman.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "signal.h"
+#include "time.h"
+#include <linux/input.h>
+#include "input_reader.h"
+#include "shm_ring.h"
+#include "acqd.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define MAX_SENSORS			4			/*!< 最多的传感器数 */
+#define MAX_SUBSCRIBERS		16			/*!< 最多的订阅者数 */
+#define MAX_EVENTS			32			/*!< 每次epoll_wait最多处理的事件数 */
+#define RECORD_MAX			32			/*!< 最大记录字节数 */
+
+/* epoll_event.data.u32的高16位为类型，低16位为序号 */
+#define TAG_LISTEN			0
+#define TAG_INPUT			1
+#define TAG_SENSOR			2
+#define TAG_SUB				3
+
+/* Private macro -------------------------------------------------------------*/
+#define TAG(type, index)	(((uint32_t)(type) << 16) | (index))
+
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 定时采样的传感器
+*
+* 缓冲区启动时分配一次，循环中不再分配；
+* 每次定时器到期只采样一条记录。驱动的read()采的是当前值，错过的周期
+* 无法补采，超期多次时多出的周期全部计入overruns
+*/
+typedef struct {
+	int fd;					/*!< 设备文件 */
+	int tfd;				/*!< timerfd */
+	acqd_src_t src;			/*!< 数据源 */
+	uint16_t index;			/*!< 同类设备的序号 */
+	uint16_t size;			/*!< 记录字节数 */
+	unsigned long samples;	/*!< 已采样的记录数 */
+	unsigned long overruns;	/*!< 来不及采样而跳过的周期数 */
+	uint8_t buf[RECORD_MAX];	/*!< 固定采样缓冲区 */
+}sensor_t;
+
+/**
+* @brief 订阅者
+*/
+typedef struct {
+	int fd;					/*!< 连接，-1为空闲 */
+	uint32_t mask;			/*!< 订阅掩码，收到订阅请求前为0 */
+	uint32_t dropped;		/*!< 丢弃的消息数 */
+}subscriber_t;
+
+/**
+* @brief 守护进程
+*/
+typedef struct {
+	int epfd;				/*!< epoll文件描述符 */
+	int lfd;				/*!< 监听socket */
+	int sensor_cnt;			/*!< 传感器数 */
+	int key_cnt;			/*!< 按键设备数 */
+	sensor_t sensor[MAX_SENSORS];	/*!< 传感器 */
+	subscriber_t sub[MAX_SUBSCRIBERS];	/*!< 订阅者 */
+	input_reader_t reader;	/*!< 按键读取器 */
+	shm_ring_t ring;		/*!< 共享内存发布，hdr为NULL时不使用 */
+}acqd_t;
+
+/* Private variables ---------------------------------------------------------*/
+static acqd_t acqd;
+static volatile sig_atomic_t running = 1;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           获取单调时钟，单位ns
+ *
+ * @param[in]       none
+ *
+ * @return          当前时间
+ *============================================================================*/
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**=============================================================================
+ * @brief           把fd加入epoll
+ *
+ * @param[in]       fd:文件描述符
+ * @param[in]		tag:TAG(type, index)
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int watch(int fd, uint32_t tag)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = tag;
+
+	return epoll_ctl(acqd.epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/**=============================================================================
+ * @brief           把一条消息发布到共享内存，并发给所有订阅了src的socket订阅者
+ *
+ * 不等待：共享内存的读者落后时自己跳过，socket订阅者的缓冲区满时丢弃本条消息并计数，
+ * 慢订阅者不拖住采集
+ *
+ * @param[in]       src:数据源
+ * @param[in]		index:同类设备的序号
+ * @param[in]		rec:记录
+ * @param[in]		size:每条记录的字节数
+ * @param[in]		count:记录数
+ * @param[in]		stamp:采样时间
+ *
+ * @return          none
+ *============================================================================*/
+static void publish(acqd_src_t src, uint16_t index, const void *rec, uint16_t size,
+					uint16_t count, int64_t stamp)
+{
+	int i = 0;
+	acqd_hdr_t hdr;
+	struct iovec iov[2];
+	struct msghdr msg;
+	subscriber_t *sub = NULL;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.src = src;
+	hdr.index = index;
+	hdr.count = count;
+	hdr.size = size;
+	hdr.stamp_ns = stamp;
+
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = (void *)rec;
+	iov[1].iov_len = (size_t)size * count;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	if (acqd.ring.hdr)
+	{
+		shm_ring_publish(&acqd.ring, &hdr, sizeof(hdr), rec, iov[1].iov_len);
+	}
+
+	for (i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		sub = &acqd.sub[i];
+		if ((sub->fd < 0) || !(sub->mask & (1u << src)))
+		{
+			continue;
+		}
+
+		hdr.dropped = sub->dropped;
+		if (sendmsg(sub->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		{
+			if ((errno == EAGAIN) || (errno == ENOBUFS))
+			{
+				sub->dropped++;
+			}
+			else	/*!< 对端已关闭，等EPOLLIN/EPOLLHUP时回收 */
+			{
+				sub->mask = 0;
+			}
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           按键帧回调，一帧作为一条消息分发
+ *
+ * @param[in]       index:设备序号
+ * @param[in]		ev:事件数组
+ * @param[in]		cnt:事件个数
+ * @param[in]		arg:回调参数
+ *
+ * @return          none
+ *============================================================================*/
+static void key_frame(int index, const struct input_event *ev, int cnt, void *arg)
+{
+	(void)arg;
+
+	if (cnt > 0)
+	{
+		publish(ACQD_SRC_KEY, index, ev, sizeof(*ev), cnt, now_ns());
+	}
+}
+
+/**=============================================================================
+ * @brief           定时器到期，采样一条记录，错过的周期计入overruns
+ *
+ * @param[in]       s:传感器
+ *
+ * @return          none
+ *============================================================================*/
+static void sensor_sample(sensor_t *s)
+{
+	uint64_t expired = 0;
+	ssize_t ret = 0;
+
+	if (read(s->tfd, &expired, sizeof(expired)) != sizeof(expired))
+	{
+		return;
+	}
+
+	/* 超期多次说明循环被耽搁了，此时再多读几条也只是同一时刻的值 */
+	s->overruns += expired - 1;
+
+	ret = read(s->fd, s->buf, s->size);
+	if (ret != s->size)
+	{
+		return;
+	}
+
+	s->samples++;
+	publish(s->src, s->index, s->buf, s->size, 1, now_ns());
+}
+
+/**=============================================================================
+ * @brief           添加一个定时采样的传感器
+ *
+ * @param[in]       src:数据源
+ * @param[in]		arg:"设备文件:周期ms"
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int sensor_add(acqd_src_t src, char *arg)
+{
+	int i = 0;
+	int period_ms = 100;
+	char *colon = strrchr(arg, ':');
+	sensor_t *s = &acqd.sensor[acqd.sensor_cnt];
+	struct itimerspec its;
+
+	if (acqd.sensor_cnt >= MAX_SENSORS)
+	{
+		return -ENOSPC;
+	}
+
+	if (colon)
+	{
+		*colon = '\0';
+		period_ms = atoi(colon + 1);
+	}
+	if (period_ms <= 0)
+	{
+		return -EINVAL;
+	}
+
+	s->src = src;
+	s->size = (src == ACQD_SRC_ICM20608) ? 7 * sizeof(int32_t) : 3 * sizeof(uint16_t);
+	for (i = 0; i < acqd.sensor_cnt; i++)
+	{
+		s->index += (acqd.sensor[i].src == src);
+	}
+
+	s->fd = open(arg, O_RDONLY | O_CLOEXEC);
+	if (s->fd < 0)
+	{
+		return -errno;
+	}
+
+	s->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (s->tfd < 0)
+	{
+		close(s->fd);
+		return -errno;
+	}
+
+	memset(&its, 0, sizeof(its));
+	its.it_interval.tv_sec = period_ms / 1000;
+	its.it_interval.tv_nsec = (period_ms % 1000) * 1000000L;
+	its.it_value = its.it_interval;
+	timerfd_settime(s->tfd, 0, &its, NULL);
+
+	if (watch(s->tfd, TAG(TAG_SENSOR, acqd.sensor_cnt)) < 0)
+	{
+		close(s->tfd);
+		close(s->fd);
+		return -errno;
+	}
+	acqd.sensor_cnt++;
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           接受新的订阅者
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void sub_accept(void)
+{
+	int i = 0;
+	int fd = accept4(acqd.lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+	if (fd < 0)
+	{
+		return;
+	}
+
+	for (i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		if (acqd.sub[i].fd < 0)
+		{
+			break;
+		}
+	}
+	if ((i == MAX_SUBSCRIBERS) || (watch(fd, TAG(TAG_SUB, i)) < 0))
+	{
+		close(fd);
+		return;
+	}
+
+	acqd.sub[i].fd = fd;
+	acqd.sub[i].mask = 0;
+	acqd.sub[i].dropped = 0;
+}
+
+/**=============================================================================
+ * @brief           处理订阅者发来的订阅请求或断开
+ *
+ * @param[in]       i:订阅者序号
+ *
+ * @return          none
+ *============================================================================*/
+static void sub_request(int i)
+{
+	acqd_sub_t req;
+	subscriber_t *sub = &acqd.sub[i];
+	ssize_t ret = recv(sub->fd, &req, sizeof(req), MSG_DONTWAIT);
+
+	if (ret == sizeof(req))
+	{
+		sub->mask = req.mask;
+		return;
+	}
+	if ((ret < 0) && (errno == EAGAIN))
+	{
+		return;
+	}
+
+	epoll_ctl(acqd.epfd, EPOLL_CTL_DEL, sub->fd, NULL);
+	close(sub->fd);
+	sub->fd = -1;
+	sub->mask = 0;
+}
+
+/**=============================================================================
+ * @brief           创建监听socket
+ *
+ * @param[in]       path:socket路径
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int listen_init(const char *path)
+{
+	struct sockaddr_un addr;
+
+	acqd.lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (acqd.lfd < 0)
+	{
+		return -errno;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+
+	if ((bind(acqd.lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		|| (listen(acqd.lfd, MAX_SUBSCRIBERS) < 0)
+		|| (watch(acqd.lfd, TAG(TAG_LISTEN, 0)) < 0))
+	{
+		return -errno;
+	}
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           信号处理，退出主循环
+ *
+ * @param[in]       sig:信号
+ *
+ * @return          none
+ *============================================================================*/
+static void on_signal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+/**=============================================================================
+ * @brief           打印用法
+ *
+ * @param[in]       prog:程序名
+ *
+ * @return          none
+ *============================================================================*/
+static void usage(const char *prog)
+{
+	printf("Usage: %s [-s socket] [-m shm name] [-r shm slots] [-i icm20608:period_ms] "
+			"[-a ap3216c:period_ms] [-k /dev/input/eventN]...\r\n", prog);
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int i = 0;
+	int n = 0;
+	int opt = 0;
+	int ret = 0;
+	uint32_t tag = 0;
+	const char *path = ACQD_SOCKET;
+	const char *shm = NULL;
+	int slots = ACQD_SHM_SLOTS;
+	struct epoll_event events[MAX_EVENTS];
+
+	memset(&acqd, 0, sizeof(acqd));
+	for (i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		acqd.sub[i].fd = -1;
+	}
+
+	acqd.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if ((acqd.epfd < 0) || (input_reader_init(&acqd.reader, key_frame, NULL) < 0))
+	{
+		printf("Can't create epoll\r\n");
+		return -1;
+	}
+
+	while ((opt = getopt(argc, argv, "s:m:r:i:a:k:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': path = optarg; break;
+		case 'm': shm = optarg; break;
+		case 'r': slots = atoi(optarg); break;
+		case 'i': ret = sensor_add(ACQD_SRC_ICM20608, optarg); break;
+		case 'a': ret = sensor_add(ACQD_SRC_AP3216C, optarg); break;
+		case 'k':
+			ret = input_reader_add(&acqd.reader, optarg);
+			acqd.key_cnt += (ret >= 0);
+			break;
+		default: usage(argv[0]); return -1;
+		}
+		if (ret < 0)
+		{
+			printf("Can't add %s: %s\r\n", optarg, strerror(-ret));
+			return -1;
+		}
+	}
+
+	if ((acqd.sensor_cnt == 0) && (acqd.key_cnt == 0))
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	/* 按键读取器自己的epoll fd可读时说明有按键设备就绪 */
+	if ((acqd.key_cnt && (watch(acqd.reader.epfd, TAG(TAG_INPUT, 0)) < 0))
+		|| (listen_init(path) < 0))
+	{
+		printf("Can't listen on %s: %s\r\n", path, strerror(errno));
+		return -1;
+	}
+
+	/* 一个槽放得下一条最大的消息：一帧按键事件 */
+	if (shm)
+	{
+		ret = shm_ring_create(&acqd.ring, shm, sizeof(acqd_hdr_t)
+								+ INPUT_READER_FRAME_MAX * sizeof(struct input_event),
+								(slots > 0) ? slots : ACQD_SHM_SLOTS);
+		if (ret < 0)
+		{
+			printf("Can't create shm %s: %s\r\n", shm, strerror(-ret));
+			return -1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	while (running)
+	{
+		n = epoll_wait(acqd.epfd, events, MAX_EVENTS, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			tag = events[i].data.u32;
+			switch (tag >> 16)
+			{
+			case TAG_LISTEN: sub_accept(); break;
+			case TAG_INPUT: input_reader_poll(&acqd.reader, 0); break;
+			case TAG_SENSOR: sensor_sample(&acqd.sensor[tag & 0xFFFF]); break;
+			case TAG_SUB: sub_request(tag & 0xFFFF); break;
+			default: break;
+			}
+		}
+	}
+
+	for (i = 0; i < acqd.sensor_cnt; i++)
+	{
+		printf("sensor %d: samples=%lu overruns=%lu\r\n", i, acqd.sensor[i].samples,
+				acqd.sensor[i].overruns);
+		close(acqd.sensor[i].tfd);
+		close(acqd.sensor[i].fd);
+	}
+	for (i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		if (acqd.sub[i].fd >= 0)
+		{
+			close(acqd.sub[i].fd);
+		}
+	}
+	input_reader_deinit(&acqd.reader);
+	close(acqd.lfd);
+	close(acqd.epfd);
+	unlink(path);
+	if (shm)
+	{
+		shm_ring_close(&acqd.ring);
+		shm_unlink(shm);
+	}
+
+	return 0;
+}
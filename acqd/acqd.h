@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file			acqd.h
+  * @brief			采集守护进程与订阅者之间的消息格式
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-04
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 订阅者连接ACQD_SOCKET(SOCK_SEQPACKET)后发送一个acqd_sub_t，
+  * 之后每条消息为acqd_hdr_t + count条记录，一次recv()收一条；
+  * 也可以用shm_ring_open(ACQD_SHM)直接读共享内存，消息格式相同，dropped为0
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ACQD_H_
+#define __ACQD_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define ACQD_SOCKET			"/tmp/acqd.sock"	/*!< 默认监听地址 */
+#define ACQD_SHM			"/acqd"				/*!< 默认共享内存名 */
+#define ACQD_SHM_SLOTS		256					/*!< 默认共享内存槽数 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 数据源，订阅掩码按位对应
+*/
+typedef enum {
+	ACQD_SRC_ICM20608 = 0,	/*!< 记录为int32_t[7]{gx, gy, gz, ax, ay, az, temp} */
+	ACQD_SRC_AP3216C,		/*!< 记录为uint16_t[3]{ir, als, ps} */
+	ACQD_SRC_KEY,			/*!< 记录为struct input_event，一条消息为一帧 */
+	ACQD_SRC_MAX,
+}acqd_src_t;
+
+/**
+* @brief 订阅请求
+*/
+typedef struct {
+	uint32_t mask;			/*!< (1 << acqd_src_t)的组合 */
+}acqd_sub_t;
+
+/**
+* @brief 消息头
+*/
+typedef struct {
+	uint16_t src;			/*!< acqd_src_t */
+	uint16_t index;			/*!< 同类设备的序号 */
+	uint16_t count;			/*!< 记录数 */
+	uint16_t size;			/*!< 每条记录的字节数 */
+	uint32_t dropped;		/*!< 因本订阅者来不及接收而丢弃的消息累计数 */
+	uint32_t reserved;		/*!< 保留 */
+	int64_t stamp_ns;		/*!< 采样时间，CLOCK_MONOTONIC */
+}acqd_hdr_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __ACQD_H_ */
@@ -0,0 +1,225 @@
+/**
+  ******************************************************************************
+  * @file			acqd_client.c
+  * @brief			acqd订阅者示例，打印收到的传感器和按键数据
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-04
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "stdint.h"
+#include "sys/types.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include <linux/input.h>
+#include "shm_ring.h"
+#include "acqd.h"
+
+/* Private constants ---------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static const char *src_name[ACQD_SRC_MAX] = {
+	"icm20608", "ap3216c", "key",
+};
+
+/* 一条消息最大为消息头 + 64个按键事件，传感器每次唤醒只读1条记录 */
+static uint8_t msgbuf[sizeof(acqd_hdr_t) + 64 * sizeof(struct input_event)];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           打印一条记录
+ *
+ * @param[in]       src:数据源
+ * @param[in]		rec:记录
+ *
+ * @return          none
+ *============================================================================*/
+static void print_record(int src, const void *rec)
+{
+	const int32_t *imu = rec;
+	const uint16_t *als = rec;
+	const struct input_event *ev = rec;
+
+	switch (src)
+	{
+	case ACQD_SRC_ICM20608:
+		printf("  gx=%d gy=%d gz=%d ax=%d ay=%d az=%d temp=%d\r\n",
+				imu[0], imu[1], imu[2], imu[3], imu[4], imu[5], imu[6]);
+		break;
+	case ACQD_SRC_AP3216C:
+		printf("  ir=%u als=%u ps=%u\r\n", als[0], als[1], als[2]);
+		break;
+	case ACQD_SRC_KEY:
+		if (ev->type == EV_KEY)
+		{
+			printf("  key %d %s\r\n", ev->code, ev->value ? "press" : "release");
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**=============================================================================
+ * @brief           打印一条消息
+ *
+ * @param[in]       msg:消息
+ * @param[in]		len:消息长度
+ * @param[in]		mask:订阅掩码
+ *
+ * @return          none
+ *============================================================================*/
+static void print_msg(const uint8_t *msg, size_t len, uint32_t mask)
+{
+	int i = 0;
+	const acqd_hdr_t *hdr = (const acqd_hdr_t *)msg;
+
+	if ((len < sizeof(*hdr)) || (hdr->src >= ACQD_SRC_MAX) || !(mask & (1u << hdr->src))
+		|| (len < sizeof(*hdr) + (size_t)hdr->count * hdr->size))
+	{
+		return;
+	}
+
+	printf("%s%u t=%lld.%06llds n=%u dropped=%u\r\n", src_name[hdr->src], hdr->index,
+			(long long)(hdr->stamp_ns / 1000000000LL),
+			(long long)(hdr->stamp_ns % 1000000000LL) / 1000, hdr->count, hdr->dropped);
+	for (i = 0; i < hdr->count; i++)
+	{
+		print_record(hdr->src, msg + sizeof(*hdr) + (size_t)i * hdr->size);
+	}
+}
+
+/**=============================================================================
+ * @brief           从共享内存读
+ *
+ * 消息可以直接在共享内存中解析，这里要打印，先拷贝出来，
+ * 经shm_ring_done确认没有被覆盖后再输出
+ *
+ * @param[in]       name:共享内存名
+ * @param[in]		mask:订阅掩码
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int shm_loop(const char *name, uint32_t mask)
+{
+	int ret = 0;
+	uint32_t len = 0;
+	uint64_t lost = 0;
+	const uint8_t *msg = NULL;
+	shm_ring_t ring;
+
+	ret = shm_ring_open(&ring, name);
+	if (ret < 0)
+	{
+		printf("Can't open shm %s: %s\r\n", name, strerror(-ret));
+		return ret;
+	}
+
+	while (1)
+	{
+		msg = shm_ring_peek(&ring, &len, -1);
+		if (msg == NULL)
+		{
+			continue;
+		}
+
+		/* 先检查再打印，被覆盖的消息不输出 */
+		if (len <= sizeof(msgbuf))
+		{
+			memcpy(msgbuf, msg, len);
+		}
+		if ((shm_ring_done(&ring) == 0) && (len <= sizeof(msgbuf)))
+		{
+			print_msg(msgbuf, len, mask);
+		}
+		if (ring.lost != lost)
+		{
+			lost = ring.lost;
+			printf("lost=%llu\r\n", (unsigned long long)lost);
+		}
+	}
+
+	shm_ring_close(&ring);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int fd = 0;
+	int opt = 0;
+	ssize_t len = 0;
+	const char *path = ACQD_SOCKET;
+	const char *shm = NULL;
+	acqd_sub_t req = { 0 };
+	struct sockaddr_un addr;
+
+	while ((opt = getopt(argc, argv, "s:m:iak")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': path = optarg; break;
+		case 'm': shm = optarg; break;
+		case 'i': req.mask |= 1u << ACQD_SRC_ICM20608; break;
+		case 'a': req.mask |= 1u << ACQD_SRC_AP3216C; break;
+		case 'k': req.mask |= 1u << ACQD_SRC_KEY; break;
+		default:
+			printf("Usage: %s [-s socket | -m shm name] [-i] [-a] [-k]\r\n", argv[0]);
+			return -1;
+		}
+	}
+	if (req.mask == 0)
+	{
+		req.mask = (1u << ACQD_SRC_MAX) - 1;
+	}
+	setvbuf(stdout, NULL, _IOLBF, 0);	/*!< 输出接到管道时也逐行输出 */
+
+	if (shm)
+	{
+		return shm_loop(shm, req.mask);
+	}
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	if ((fd < 0) || (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		|| (send(fd, &req, sizeof(req), 0) != sizeof(req)))
+	{
+		printf("Can't connect to %s: %s\r\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (1)
+	{
+		len = recv(fd, msgbuf, sizeof(msgbuf), 0);
+		if (len <= 0)
+		{
+			break;
+		}
+		print_msg(msgbuf, len, req.mask);
+	}
+
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,336 @@
+/**
+  ******************************************************************************
+  * @file			shm_ring.c
+  * @brief			shm_ring function
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-05
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "string.h"
+#include "time.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "sys/syscall.h"
+#include <linux/futex.h>
+#include "shm_ring.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SLOT_ALIGN			64			/*!< 槽按cache line对齐 */
+
+/* Private macro -------------------------------------------------------------*/
+#define LOAD(p)				__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)			__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           futex系统调用，共享内存中使用，不加FUTEX_PRIVATE_FLAG
+ *
+ * @param[in]       addr:futex地址
+ * @param[in]		op:FUTEX_WAIT/FUTEX_WAKE
+ * @param[in]		val:期望值或唤醒个数
+ * @param[in]		ts:超时，NULL为一直等待
+ *
+ * @return          系统调用返回值
+ *============================================================================*/
+static long futex(uint32_t *addr, int op, uint32_t val, const struct timespec *ts)
+{
+	return syscall(SYS_futex, addr, op, val, ts, NULL, 0);
+}
+
+/**=============================================================================
+ * @brief           第seq条消息所在的槽
+ *
+ * @param[in]       ring:环形缓冲
+ * @param[in]		seq:序号
+ *
+ * @return          槽
+ *============================================================================*/
+static shm_ring_slot_t *slot_of(shm_ring_t *ring, uint64_t seq)
+{
+	return (shm_ring_slot_t *)(ring->slots + (seq & (ring->hdr->slot_count - 1)) * ring->stride);
+}
+
+/**=============================================================================
+ * @brief           映射共享内存
+ *
+ * @param[in]       ring:环形缓冲
+ * @param[in]		fd:共享内存文件
+ * @param[in]		len:映射长度
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int ring_map(shm_ring_t *ring, int fd, size_t len)
+{
+	void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (p == MAP_FAILED)
+	{
+		return -errno;
+	}
+
+	ring->hdr = p;
+	ring->slots = (uint8_t *)p + sizeof(shm_ring_hdr_t);
+	ring->map_len = len;
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           写者创建环形缓冲，已存在时重新初始化
+ *
+ * @param[in]       ring:环形缓冲
+ * @param[in]		name:共享内存名，如"/acqd"
+ * @param[in]		slot_size:每条消息最大字节数
+ * @param[in]		slot_count:槽数，向上取整到2的幂
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+int shm_ring_create(shm_ring_t *ring, const char *name, uint32_t slot_size, uint32_t slot_count)
+{
+	int fd = 0;
+	int ret = 0;
+	uint32_t count = 1;
+	size_t stride = 0;
+	size_t len = 0;
+
+	while (count < slot_count)
+	{
+		count <<= 1;
+	}
+	stride = (sizeof(shm_ring_slot_t) + slot_size + SLOT_ALIGN - 1) & ~(size_t)(SLOT_ALIGN - 1);
+	len = sizeof(shm_ring_hdr_t) + stride * count;
+
+	memset(ring, 0, sizeof(*ring));
+	fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		return -errno;
+	}
+	if (ftruncate(fd, len) < 0)
+	{
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+	ret = ring_map(ring, fd, len);
+	close(fd);
+	if (ret < 0)
+	{
+		return ret;
+	}
+
+	/* magic最后写，读者看到magic时其他字段已经有效 */
+	memset(ring->hdr, 0, len);
+	ring->hdr->version = SHM_RING_VERSION;
+	ring->hdr->slot_size = slot_size;
+	ring->hdr->slot_count = count;
+	ring->stride = stride;
+	STORE(&ring->hdr->magic, SHM_RING_MAGIC);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           读者打开环形缓冲，从当前最新位置开始读
+ *
+ * @param[in]       ring:环形缓冲
+ * @param[in]		name:共享内存名
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+int shm_ring_open(shm_ring_t *ring, const char *name)
+{
+	int fd = 0;
+	int ret = 0;
+	struct stat st;
+	shm_ring_hdr_t *hdr = NULL;
+
+	memset(ring, 0, sizeof(*ring));
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+	{
+		return -errno;
+	}
+	if ((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(shm_ring_hdr_t)))
+	{
+		close(fd);
+		return -EINVAL;
+	}
+	ret = ring_map(ring, fd, st.st_size);
+	close(fd);
+	if (ret < 0)
+	{
+		return ret;
+	}
+
+	hdr = ring->hdr;
+	ring->stride = (sizeof(shm_ring_slot_t) + hdr->slot_size + SLOT_ALIGN - 1)
+					& ~(size_t)(SLOT_ALIGN - 1);
+	if ((LOAD(&hdr->magic) != SHM_RING_MAGIC) || (hdr->version != SHM_RING_VERSION)
+		|| (sizeof(shm_ring_hdr_t) + ring->stride * hdr->slot_count > ring->map_len))
+	{
+		shm_ring_close(ring);
+		return -EPROTO;
+	}
+	ring->next = LOAD(&hdr->head);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           解除映射
+ *
+ * @param[in]       ring:环形缓冲
+ *
+ * @return          none
+ *============================================================================*/
+void shm_ring_close(shm_ring_t *ring)
+{
+	if (ring->hdr)
+	{
+		munmap(ring->hdr, ring->map_len);
+		ring->hdr = NULL;
+	}
+}
+
+/**=============================================================================
+ * @brief           写者发布一条消息，由a、b两段拼成，超出槽大小的部分截掉
+ *
+ * @param[in]       ring:环形缓冲
+ * @param[in]		a,alen:第一段，如消息头
+ * @param[in]		b,blen:第二段，如记录，可以为NULL
+ *
+ * @return          none
+ *============================================================================*/
+void shm_ring_publish(shm_ring_t *ring, const void *a, size_t alen, const void *b, size_t blen)
+{
+	shm_ring_hdr_t *hdr = ring->hdr;
+	uint64_t seq = hdr->head;
+	shm_ring_slot_t *slot = slot_of(ring, seq);
+
+	if (alen > hdr->slot_size)
+	{
+		alen = hdr->slot_size;
+	}
+	if (blen > hdr->slot_size - alen)
+	{
+		blen = hdr->slot_size - alen;
+	}
+
+	/* 先标记正在写，读者在此期间读到的内容会在shm_ring_done中被发现无效 */
+	STORE(&slot->seq, 2 * seq + 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(slot->data, a, alen);
+	if (b && blen)
+	{
+		memcpy(slot->data + alen, b, blen);
+	}
+	slot->len = alen + blen;
+	STORE(&slot->seq, 2 * seq + 2);
+	STORE(&hdr->head, seq + 1);
+
+	/* 与读者的waiters++/FUTEX_WAIT配对，两边都用SEQ_CST，不会漏掉唤醒 */
+	__atomic_add_fetch(&hdr->futex, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&hdr->waiters, __ATOMIC_SEQ_CST))
+	{
+		futex(&hdr->futex, FUTEX_WAKE, INT32_MAX, NULL);
+	}
+}
+
+/**=============================================================================
+ * @brief           读者取下一条消息，直接返回共享内存中的地址，不拷贝
+ *
+ * 使用完后必须调用shm_ring_done确认读取期间没有被写者覆盖
+ *
+ * @param[in]       ring:环形缓冲
+ * @param[out]		len:消息长度
+ * @param[in]		timeout_ms:没有新消息时的等待时间，-1为一直等待
+ *
+ * @return          消息地址;NULL:超时
+ *============================================================================*/
+const void *shm_ring_peek(shm_ring_t *ring, uint32_t *len, int timeout_ms)
+{
+	shm_ring_hdr_t *hdr = ring->hdr;
+	shm_ring_slot_t *slot = NULL;
+	uint64_t head = 0;
+	uint32_t seen = 0;
+	struct timespec ts;
+
+	while (1)
+	{
+		seen = LOAD(&hdr->futex);
+		head = LOAD(&hdr->head);
+
+		/* 落后超过一圈，跳到还没被覆盖的最旧消息 */
+		if (head - ring->next > hdr->slot_count)
+		{
+			ring->lost += head - ring->next - hdr->slot_count;
+			ring->next = head - hdr->slot_count;
+		}
+
+		if (ring->next != head)
+		{
+			slot = slot_of(ring, ring->next);
+			if (LOAD(&slot->seq) == 2 * ring->next + 2)
+			{
+				*len = (slot->len > hdr->slot_size) ? hdr->slot_size : slot->len;
+				return slot->data;
+			}
+			/* 槽已经开始被下一圈覆盖，跳过 */
+			ring->lost++;
+			ring->next++;
+			continue;
+		}
+
+		if (timeout_ms == 0)
+		{
+			return NULL;
+		}
+
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		__atomic_add_fetch(&hdr->waiters, 1, __ATOMIC_SEQ_CST);
+		if ((futex(&hdr->futex, FUTEX_WAIT, seen, (timeout_ms < 0) ? NULL : &ts) < 0)
+			&& (errno == ETIMEDOUT))
+		{
+			__atomic_sub_fetch(&hdr->waiters, 1, __ATOMIC_ACQ_REL);
+			return NULL;
+		}
+		__atomic_sub_fetch(&hdr->waiters, 1, __ATOMIC_ACQ_REL);
+	}
+}
+
+/**=============================================================================
+ * @brief           读者用完shm_ring_peek返回的消息，移动到下一条
+ *
+ * @param[in]       ring:环形缓冲
+ *
+ * @return          0:读取期间数据有效;-ESTALE:读取期间被覆盖，读到的内容应丢弃
+ *============================================================================*/
+int shm_ring_done(shm_ring_t *ring)
+{
+	shm_ring_slot_t *slot = slot_of(ring, ring->next);
+	uint64_t expect = 2 * ring->next + 2;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	ring->next++;
+	if (LOAD(&slot->seq) != expect)
+	{
+		ring->lost++;
+		return -ESTALE;
+	}
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file			shm_ring.h
+  * @brief			shm_ring header file，POSIX共享内存中的单写者多读者环形缓冲
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-05
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 写者不等待读者，读者各自维护读位置，落后超过一圈时跳过丢失的消息。
+  * 每个槽有序号，写入前置为奇数、写完置为偶数，读者直接在共享内存中读取，
+  * 读完后再检查序号，确认读取期间没有被覆盖(seqlock)
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SHM_RING_H_
+#define __SHM_RING_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdint.h"
+#include "stddef.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define SHM_RING_MAGIC		0x52494E47		/*!< "RING" */
+#define SHM_RING_VERSION	1				/*!< 布局版本 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 共享内存头，写者和读者的计数放在不同的cache line
+*/
+typedef struct {
+	uint32_t magic;			/*!< SHM_RING_MAGIC */
+	uint32_t version;		/*!< SHM_RING_VERSION */
+	uint32_t slot_size;		/*!< 每个槽的数据区字节数 */
+	uint32_t slot_count;	/*!< 槽数，2的幂 */
+	uint8_t pad0[48];
+	uint64_t head;			/*!< 下一条消息的序号，只由写者增加 */
+	uint32_t futex;			/*!< 每发布一条加1，读者在此等待 */
+	uint32_t waiters;		/*!< 正在等待的读者数，为0时写者不调用FUTEX_WAKE */
+	uint8_t pad1[48];
+}shm_ring_hdr_t;
+
+/**
+* @brief 槽
+*/
+typedef struct {
+	uint64_t seq;			/*!< 2*序号+1:正在写;2*序号+2:写完 */
+	uint32_t len;			/*!< 数据长度 */
+	uint32_t reserved;		/*!< 保留 */
+	uint8_t data[];			/*!< 数据，slot_size字节 */
+}shm_ring_slot_t;
+
+/**
+* @brief 映射到本进程的环形缓冲
+*/
+typedef struct {
+	shm_ring_hdr_t *hdr;	/*!< 共享内存头 */
+	uint8_t *slots;			/*!< 第一个槽 */
+	size_t stride;			/*!< 槽间距 */
+	size_t map_len;			/*!< 映射长度 */
+	uint64_t next;			/*!< 读者：下一条要读的序号 */
+	uint64_t lost;			/*!< 读者：因落后而丢失的消息数 */
+}shm_ring_t;
+
+/* Exported functions ------------------------------------------------------- */
+int shm_ring_create(shm_ring_t *ring, const char *name, uint32_t slot_size, uint32_t slot_count);
+int shm_ring_open(shm_ring_t *ring, const char *name);
+void shm_ring_close(shm_ring_t *ring);
+void shm_ring_publish(shm_ring_t *ring, const void *a, size_t alen, const void *b, size_t blen);
+const void *shm_ring_peek(shm_ring_t *ring, uint32_t *len, int timeout_ms);
+int shm_ring_done(shm_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SHM_RING_H_ */
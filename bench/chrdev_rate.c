@@ -0,0 +1,360 @@
+/**
+  ******************************************************************************
+  * @file			chrdev_rate.c
+  * @brief			字符设备管道(1_chrdevbase)的持续吞吐量测试，一个线程写一个线程读
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-03
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include "stdio.h"
+#include "unistd.h"
+#include "stdint.h"
+#include "sys/types.h"
+#include "sys/stat.h"
+#include "sys/time.h"
+#include "sys/resource.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+#include "poll.h"
+#include "pthread.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define DEFAULT_BLOCK		4096		/*!< 默认每次read/write的字节数 */
+#define DEFAULT_TOTAL		64			/*!< 默认传输总量，MiB */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 读写线程
+*/
+typedef struct {
+	pthread_t tid;			/*!< 线程ID */
+	int fd;					/*!< 设备文件描述符 */
+	int writer;				/*!< 1:写线程;0:读线程 */
+	long long bytes;		/*!< 已传输字节数 */
+	long long calls;		/*!< read/write调用次数 */
+	long long again;		/*!< 返回-EAGAIN的次数 */
+	long long errors;		/*!< 数据校验错误的字节数 */
+	long long elapsed;		/*!< 线程耗时，ns */
+	int pipefd[2];			/*!< 读线程splice用的管道 */
+}stream_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *filename = NULL;
+static size_t block = DEFAULT_BLOCK;
+static long long total = (long long)DEFAULT_TOTAL << 20;
+static int nonblock = 0;
+static int verify = 0;
+static int use_splice = 0;
+static int outfd = -1;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           获取单调时钟，单位ns
+ *
+ * @param[in]       none
+ *
+ * @return          当前时间
+ *============================================================================*/
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**=============================================================================
+ * @brief           timeval转换为us
+ *
+ * @param[in]       tv:时间
+ *
+ * @return          us
+ *============================================================================*/
+static long long tv_us(const struct timeval *tv)
+{
+	return (long long)tv->tv_sec * 1000000LL + tv->tv_usec;
+}
+
+/**=============================================================================
+ * @brief           数据流第pos字节的内容，用于校验
+ *
+ * @param[in]       pos:字节位置
+ *
+ * @return          字节内容
+ *============================================================================*/
+static unsigned char pattern(long long pos)
+{
+	return (unsigned char)(pos ^ (pos >> 8) ^ (pos >> 16));
+}
+
+/**=============================================================================
+ * @brief           读线程的splice方式：设备->管道->输出文件，数据不经过用户空间
+ *
+ * @param[in]       s:读线程
+ * @param[in]		len:最多传输的字节数
+ *
+ * @return          从设备取出的字节数;-1:失败
+ *============================================================================*/
+static ssize_t splice_once(stream_t *s, size_t len)
+{
+	ssize_t ret = 0;
+	ssize_t out = 0;
+	ssize_t n = 0;
+
+	ret = splice(s->fd, NULL, s->pipefd[1], NULL, len, SPLICE_F_MOVE | (nonblock ? SPLICE_F_NONBLOCK : 0));
+	if (ret <= 0)
+	{
+		return ret;
+	}
+
+	/* 管道里的数据全部送到输出文件，没有输出文件时丢到/dev/null */
+	while (out < ret)
+	{
+		n = splice(s->pipefd[0], NULL, outfd, NULL, ret - out, SPLICE_F_MOVE);
+		if (n <= 0)
+		{
+			return -1;
+		}
+		out += n;
+	}
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           读写线程，非阻塞时用poll等待
+ *
+ * @param[in]       arg:stream_t
+ *
+ * @return          NULL
+ *============================================================================*/
+static void *stream_thread(void *arg)
+{
+	stream_t *s = arg;
+	unsigned char *buf = NULL;
+	size_t len = 0;
+	ssize_t ret = 0;
+	long long i = 0;
+	long long start = 0;
+	struct pollfd pfd;
+
+	buf = malloc(block);
+	if (buf == NULL)
+	{
+		return NULL;
+	}
+
+	pfd.fd = s->fd;
+	pfd.events = s->writer ? POLLOUT : POLLIN;
+
+	start = now_ns();
+	while (s->bytes < total)
+	{
+		len = (total - s->bytes < (long long)block) ? (size_t)(total - s->bytes) : block;
+
+		if (s->writer && verify)
+		{
+			for (i = 0; i < (long long)len; i++)
+			{
+				buf[i] = pattern(s->bytes + i);
+			}
+		}
+
+		if (s->writer)
+		{
+			ret = write(s->fd, buf, len);
+		}
+		else
+		{
+			ret = use_splice ? splice_once(s, len) : read(s->fd, buf, len);
+		}
+		s->calls++;
+		if (ret < 0)
+		{
+			if (errno == EAGAIN)
+			{
+				s->again++;
+				poll(&pfd, 1, -1);
+				continue;
+			}
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			printf("%s failed: %s\r\n", s->writer ? "write" : "read", strerror(errno));
+			break;
+		}
+
+		if (!s->writer && verify && !use_splice)
+		{
+			for (i = 0; i < ret; i++)
+			{
+				s->errors += (buf[i] != pattern(s->bytes + i));
+			}
+		}
+		s->bytes += ret;
+	}
+	s->elapsed = now_ns() - start;
+
+	free(buf);
+	return NULL;
+}
+
+/**=============================================================================
+ * @brief           打印一个线程的结果
+ *
+ * @param[in]       s:读写线程
+ *
+ * @return          none
+ *============================================================================*/
+static void report(const stream_t *s)
+{
+	double sec = s->elapsed / 1e9;
+
+	printf("  %s: bytes=%lld calls=%lld avg=%lldB again=%lld %.1fMiB/s",
+			s->writer ? "write" : "read ", s->bytes, s->calls,
+			s->calls ? s->bytes / s->calls : 0, s->again,
+			sec > 0 ? s->bytes / sec / (1 << 20) : 0);
+	if (!s->writer && verify && !use_splice)
+	{
+		printf(" mismatch=%lld", s->errors);
+	}
+	printf("\r\n");
+}
+
+/**=============================================================================
+ * @brief           打印用法
+ *
+ * @param[in]       prog:程序名
+ *
+ * @return          none
+ *============================================================================*/
+static void usage(const char *prog)
+{
+	printf("Usage: %s -d <device> [-b block bytes] [-t total MiB] [-N] [-V] [-S] [-o file]\r\n"
+			"  -N  O_NONBLOCK + poll\r\n"
+			"  -V  write a known pattern and check it on the read side (not with -S)\r\n"
+			"  -S  read side uses splice() device->pipe->file instead of read()\r\n"
+			"  -o  where the read side puts the data, default /dev/null\r\n", prog);
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int i = 0;
+	int opt = 0;
+	int flags = O_RDWR;
+	const char *outname = "/dev/null";
+	long long start = 0;
+	long long elapsed = 0;
+	stream_t streams[2];
+	struct rusage before, after;
+
+	while ((opt = getopt(argc, argv, "d:b:t:NVSo:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': filename = optarg; break;
+		case 'b': block = strtoul(optarg, NULL, 0); break;
+		case 't': total = atoll(optarg) << 20; break;
+		case 'N': nonblock = 1; break;
+		case 'V': verify = 1; break;
+		case 'S': use_splice = 1; break;
+		case 'o': outname = optarg; break;
+		default: usage(argv[0]); return -1;
+		}
+	}
+
+	if (!filename || (block == 0) || (total <= 0))
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	if (nonblock)
+	{
+		flags |= O_NONBLOCK;
+	}
+
+	outfd = open(outname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (outfd < 0)
+	{
+		printf("Can't open file %s: %s\r\n", outname, strerror(errno));
+		return -1;
+	}
+
+	/* 读写各用一个文件，两端互不影响f_pos */
+	memset(streams, 0, sizeof(streams));
+	for (i = 0; i < 2; i++)
+	{
+		streams[i].writer = (i == 0);
+		streams[i].fd = open(filename, flags);
+		if (streams[i].fd < 0)
+		{
+			printf("Can't open file %s: %s\r\n", filename, strerror(errno));
+			return -1;
+		}
+	}
+	if (use_splice && pipe(streams[1].pipefd) < 0)
+	{
+		printf("pipe failed: %s\r\n", strerror(errno));
+		return -1;
+	}
+
+	getrusage(RUSAGE_SELF, &before);
+	start = now_ns();
+	for (i = 0; i < 2; i++)
+	{
+		pthread_create(&streams[i].tid, NULL, stream_thread, &streams[i]);
+	}
+	for (i = 0; i < 2; i++)
+	{
+		pthread_join(streams[i].tid, NULL);
+	}
+	elapsed = now_ns() - start;
+	getrusage(RUSAGE_SELF, &after);
+
+	printf("%s block=%zu total=%lldMiB %s%s elapsed=%lldus %.1fMiB/s\r\n",
+			filename, block, total >> 20, nonblock ? "nonblock" : "block", use_splice ? " splice" : "",
+			elapsed / 1000, streams[1].bytes / (elapsed / 1e9) / (1 << 20));
+	for (i = 0; i < 2; i++)
+	{
+		report(&streams[i]);
+	}
+	printf("  cpu: user=%lldus sys=%lldus (%.0f%% of wall)\r\n",
+			tv_us(&after.ru_utime) - tv_us(&before.ru_utime),
+			tv_us(&after.ru_stime) - tv_us(&before.ru_stime),
+			100.0 * (tv_us(&after.ru_utime) - tv_us(&before.ru_utime)
+					+ tv_us(&after.ru_stime) - tv_us(&before.ru_stime)) / (elapsed / 1000));
+
+	for (i = 0; i < 2; i++)
+	{
+		close(streams[i].fd);
+	}
+	if (use_splice)
+	{
+		close(streams[1].pipefd[0]);
+		close(streams[1].pipefd[1]);
+	}
+	close(outfd);
+
+	return 0;
+}
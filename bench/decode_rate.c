@@ -0,0 +1,146 @@
+/**
+  ******************************************************************************
+  * @file			decode_rate.c
+  * @brief			驱动热点路径的用户空间微基准：AP3216C/ICM20608数据解析和按键状态机
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-10
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 直接包含驱动使用的头文件，测的是与驱动完全相同的代码。
+  * 编译：gcc -O2 decode_rate.c -I../21_i2c -I../22_spi -I../20_input -o decode_rate
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "ap3216c.h"
+#include "icm20608.h"
+#include "key_fsm.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define DEFAULT_COUNT		10000000	/*!< 默认每项的调用次数 */
+#define RAW_SETS			256			/*!< 轮流使用的输入组数，避免被编译器当作常量 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static unsigned char ap_raw[RAW_SETS][6];
+static unsigned char icm_raw[RAW_SETS][14];
+static volatile unsigned long sink;		/*!< 累加输出，防止循环被优化掉 */
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           获取单调时钟，单位ns
+ *
+ * @param[in]       none
+ *
+ * @return          当前时间
+ *============================================================================*/
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**=============================================================================
+ * @brief           打印一项结果
+ *
+ * @param[in]       name:测试项
+ * @param[in]		count:调用次数
+ * @param[in]		elapsed:耗时，ns
+ *
+ * @return          none
+ *============================================================================*/
+static void report(const char *name, long count, long long elapsed)
+{
+	printf("%-16s calls=%ld elapsed=%lldus %.2fns/call\r\n", name, count,
+			elapsed / 1000, (double)elapsed / count);
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int opt = 0;
+	long i = 0;
+	long count = DEFAULT_COUNT;
+	long long start = 0;
+	unsigned long acc = 0;
+	unsigned short als[3];
+	int imu[7];
+	unsigned int act = 0;
+	key_fsm_t fsm;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': count = atol(optarg); break;
+		default:
+			printf("Usage: %s [-n calls]\r\n", argv[0]);
+			return -1;
+		}
+	}
+	if (count <= 0)
+	{
+		return -1;
+	}
+
+	srand(1);
+	for (i = 0; i < RAW_SETS; i++)
+	{
+		for (opt = 0; opt < 6; opt++)
+		{
+			ap_raw[i][opt] = rand();
+		}
+		for (opt = 0; opt < 14; opt++)
+		{
+			icm_raw[i][opt] = rand();
+		}
+	}
+
+	start = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		ap3216c_decode(ap_raw[i % RAW_SETS], als);
+		acc += als[0] + als[1] + als[2];
+	}
+	report("ap3216c_decode", count, now_ns() - start);
+
+	start = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		icm20608_decode(icm_raw[i % RAW_SETS], imu);
+		acc += imu[0] + imu[3] + imu[6];
+	}
+	report("icm20608_decode", count, now_ns() - start);
+
+	/* 每64次中前48次按下(16次后上报长按)、后16次松开，时间每次加1 */
+	memset(&fsm, 0, sizeof(fsm));
+	start = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		act = key_fsm_step(&fsm, (i & 63) < 48, i, 16);
+		acc += act;
+	}
+	report("key_fsm_step", count, now_ns() - start);
+
+	sink = acc;
+
+	return 0;
+}
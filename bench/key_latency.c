@@ -0,0 +1,551 @@
+/**
+  ******************************************************************************
+  * @file			key_latency.c
+  * @brief			GPIO边沿到应用程序收到按键事件的延时测试
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-22
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 运行环境：开发板上把一个空闲GPIO用导线接到KEY0(GPIO1_IO18)，用-p指定该GPIO的
+  * sysfs value文件(/sys/class/gpio/gpioN/value)由本程序驱动电平。
+  * 本仓库的驱动基于4.1内核，gpio-mockup(4.9+)和gpio-sim(5.17+)都不可用，
+  * 两者的控制文件仍然支持，只用于把驱动移植到新内核后的测试；QEMU中无法驱动按键。
+  *
+  * 驱动在松开后10ms消抖定时器到期才上报，jiffies定时器在HZ=100时有0~10ms抖动，
+  * 会淹没各种接收方式之间的差别。13~16的驱动在mmap状态页中记录了定时器更新状态
+  * 的时间，这里同时给出"edge"(电平变化到收到事件)和"deliver"(定时器到收到事件)
+  * 两组结果，比较接收方式时看deliver；20_input没有状态页，只有edge
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "sys/types.h"
+#include "sys/stat.h"
+#include "sys/select.h"
+#include "sys/mman.h"
+#include "stdint.h"
+#include "poll.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+#include "signal.h"
+#include "errno.h"
+#include "time.h"
+#include <linux/input.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define HIST_BUCKETS		24			/*!< 直方图桶数，按2的幂划分微秒 */
+#define DEFAULT_COUNT		1000		/*!< 默认测试次数 */
+#define DEFAULT_HOLD_MS		30			/*!< 按下保持时间，需大于驱动10ms消抖 */
+#define EVENT_TIMEOUT_MS	1000		/*!< 单次事件等待超时 */
+
+/* Private macro -------------------------------------------------------------*/
+#define READ_ONCE_U32(x)	(*(const volatile uint32_t*)&(x))
+
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 按键状态页，与驱动中的key_state_page_t一致
+*/
+typedef struct {
+	uint32_t seq;			/*!< 序列号，奇数表示正在更新 */
+	uint32_t keys;			/*!< 按键状态位图 */
+	uint32_t events;		/*!< 状态变化次数 */
+	uint32_t reserved;		/*!< 保留 */
+	uint64_t stamp_ns;		/*!< 最近一次变化的时间 */
+}key_state_page_t;
+
+/**
+* @brief 事件接收方式
+*/
+typedef enum {
+	MODE_SPIN = 0,		/*!< 非阻塞read轮询(13_irq) */
+	MODE_READ,			/*!< 阻塞read(14_blockio) */
+	MODE_POLL,			/*!< poll(15_noblockio) */
+	MODE_SELECT,		/*!< select(15_noblockio) */
+	MODE_SIGIO,			/*!< 异步通知(16_asyncnoti) */
+	MODE_EVDEV,			/*!< input子系统(20_input) */
+	MODE_MAX,
+}bench_mode_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *mode_name[MODE_MAX] = {
+	"spin", "read", "poll", "select", "sigio", "evdev",
+};
+
+static unsigned long hist[HIST_BUCKETS];		/*!< edge延时直方图 */
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           获取单调时钟，单位ns
+ *
+ * @param[in]       none
+ *
+ * @return          当前时间
+ *============================================================================*/
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**=============================================================================
+ * @brief           设置接到按键上的GPIO电平
+ *
+ * @param[in]       pull:sysfs gpio的value文件，或gpio-sim的pull、gpio-mockup的debugfs文件
+ * @param[in]		level:电平
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int sim_set_level(const char *pull, int level)
+{
+	int fd = 0;
+	int ret = 0;
+	const char *val = NULL;
+
+	if (strstr(pull, "pull"))	/*!< gpio-sim */
+	{
+		val = level ? "pull-up" : "pull-down";
+	}
+	else						/*!< sysfs gpio、gpio-mockup */
+	{
+		val = level ? "1" : "0";
+	}
+
+	fd = open(pull, O_WRONLY);
+	if (fd < 0)
+	{
+		return -errno;
+	}
+	ret = write(fd, val, strlen(val));
+	close(fd);
+
+	return (ret < 0) ? -errno : 0;
+}
+
+/**=============================================================================
+ * @brief           等待文件可读
+ *
+ * @param[in]       fd:设备文件描述符
+ *
+ * @return          0:可读;-ETIMEDOUT:超时
+ *============================================================================*/
+static int wait_readable(int fd)
+{
+	struct pollfd fds;
+
+	fds.fd = fd;
+	fds.events = POLLIN;
+	fds.revents = 0;
+
+	return (poll(&fds, 1, EVENT_TIMEOUT_MS) > 0) ? 0 : -ETIMEDOUT;
+}
+
+/**=============================================================================
+ * @brief           读取状态页中最近一次变化的时间
+ *
+ * @param[in]       state:映射的状态页，NULL时返回0
+ *
+ * @return          时间，ns
+ *============================================================================*/
+static long long state_stamp(const key_state_page_t *state)
+{
+	uint32_t seq = 0;
+	long long stamp = 0;
+
+	if (state == NULL)
+	{
+		return 0;
+	}
+
+	do
+	{
+		while ((seq = READ_ONCE_U32(state->seq)) & 1)
+		{
+		}
+		__sync_synchronize();
+		stamp = state->stamp_ns;
+		__sync_synchronize();
+	} while (READ_ONCE_U32(state->seq) != seq);
+
+	return stamp;
+}
+
+/**=============================================================================
+ * @brief           等待一次按键释放事件
+ *
+ * @param[in]       fd:设备文件描述符
+ * @param[in]		mode:接收方式
+ *
+ * @return          0:成功;其他:失败或超时
+ *============================================================================*/
+static int wait_release(int fd, int mode)
+{
+	int ret = 0;
+	unsigned char data = 0;
+	long long deadline = now_ns() + EVENT_TIMEOUT_MS * 1000000LL;
+	struct pollfd fds;
+	fd_set readfds;
+	struct timeval timeout;
+	struct input_event ev[16];
+	struct timespec ts;
+	sigset_t set;
+
+	switch (mode)
+	{
+	case MODE_SPIN:
+		while (now_ns() < deadline)
+		{
+			data = 0;
+			ret = read(fd, &data, sizeof(data));
+			if ((ret >= 0) && data)
+			{
+				return 0;
+			}
+		}
+		return -ETIMEDOUT;
+
+	case MODE_READ:	/*!< 先带超时等待，丢失边沿时不会永远阻塞在read中 */
+		if (wait_readable(fd) < 0)
+		{
+			return -ETIMEDOUT;
+		}
+		ret = read(fd, &data, sizeof(data));
+		return (ret < 0) ? -errno : 0;
+
+	case MODE_POLL:
+		fds.fd = fd;
+		fds.events = POLLIN;
+		ret = poll(&fds, 1, EVENT_TIMEOUT_MS);
+		if (ret <= 0)
+		{
+			return -ETIMEDOUT;
+		}
+		read(fd, &data, sizeof(data));
+		return 0;
+
+	case MODE_SELECT:
+		FD_ZERO(&readfds);
+		FD_SET(fd, &readfds);
+		timeout.tv_sec = EVENT_TIMEOUT_MS / 1000;
+		timeout.tv_usec = (EVENT_TIMEOUT_MS % 1000) * 1000;
+		ret = select(fd + 1, &readfds, NULL, NULL, &timeout);
+		if (ret <= 0)
+		{
+			return -ETIMEDOUT;
+		}
+		read(fd, &data, sizeof(data));
+		return 0;
+
+	case MODE_SIGIO:	/*!< SIGIO已被屏蔽，同步等待避免信号处理函数与pause()竞争 */
+		sigemptyset(&set);
+		sigaddset(&set, SIGIO);
+		ts.tv_sec = EVENT_TIMEOUT_MS / 1000;
+		ts.tv_nsec = (EVENT_TIMEOUT_MS % 1000) * 1000000L;
+		if (sigtimedwait(&set, NULL, &ts) < 0)
+		{
+			return -ETIMEDOUT;
+		}
+		read(fd, &data, sizeof(data));
+		return 0;
+
+	case MODE_EVDEV:
+		while (now_ns() < deadline)
+		{
+			int i = 0;
+
+			if (wait_readable(fd) < 0)
+			{
+				return -ETIMEDOUT;
+			}
+			ret = read(fd, ev, sizeof(ev));
+			if (ret < 0)
+			{
+				return -errno;
+			}
+			for (i = 0; i < ret / (int)sizeof(ev[0]); i++)
+			{
+				if ((ev[i].type == EV_KEY) && (ev[i].value == 0))
+				{
+					return 0;
+				}
+			}
+		}
+		return -ETIMEDOUT;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+/**=============================================================================
+ * @brief           记录一次延时
+ *
+ * @param[in]       ns:延时
+ *
+ * @return          none
+ *============================================================================*/
+static void hist_add(long long ns)
+{
+	int i = 0;
+	long long us = ns / 1000;
+
+	while ((us > 1) && (i < HIST_BUCKETS - 1))
+	{
+		us >>= 1;
+		i++;
+	}
+	hist[i]++;
+}
+
+/**=============================================================================
+ * @brief           排序比较函数
+ *
+ * @param[in]       a,b:比较元素
+ *
+ * @return          比较结果
+ *============================================================================*/
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long*)a;
+	long long y = *(const long long*)b;
+
+	return (x > y) - (x < y);
+}
+
+/**=============================================================================
+ * @brief           打印一组延时的统计
+ *
+ * @param[in]       name:测量区间
+ * @param[in]		lat:延时数组，会被排序
+ * @param[in]		cnt:有效样本数
+ *
+ * @return          none
+ *============================================================================*/
+static void report_one(const char *name, long long *lat, int cnt)
+{
+	int i = 0;
+	long long sum = 0;
+
+	qsort(lat, cnt, sizeof(lat[0]), cmp_ll);
+	for (i = 0; i < cnt; i++)
+	{
+		sum += lat[i];
+	}
+
+	printf("  %-7s min=%lldus avg=%lldus p50=%lldus p99=%lldus max=%lldus\r\n", name,
+			lat[0] / 1000, sum / cnt / 1000, lat[cnt / 2] / 1000,
+			lat[cnt * 99 / 100] / 1000, lat[cnt - 1] / 1000);
+}
+
+/**=============================================================================
+ * @brief           打印测试结果
+ *
+ * @param[in]       mode:接收方式
+ * @param[in]		lat:edge延时数组
+ * @param[in]		dlv:deliver延时数组，NULL表示没有状态页
+ * @param[in]		cnt:有效样本数
+ * @param[in]		lost:超时次数
+ *
+ * @return          none
+ *============================================================================*/
+static void report(int mode, long long *lat, long long *dlv, int cnt, int lost)
+{
+	int i = 0;
+
+	if (cnt == 0)
+	{
+		printf("%s: no events received, %d lost\r\n", mode_name[mode], lost);
+		return;
+	}
+
+	printf("mode=%s samples=%d lost=%d\r\n", mode_name[mode], cnt, lost);
+	report_one("edge", lat, cnt);
+	if (dlv)
+	{
+		report_one("deliver", dlv, cnt);
+	}
+	printf("  histogram of %s latency:\r\n", dlv ? "deliver" : "edge (includes 10ms debounce)");
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		if (hist[i])
+		{
+			printf("  [%8luus, %8luus) %lu\r\n",
+					i ? (1UL << i) : 0UL, 1UL << (i + 1), hist[i]);
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           打印用法
+ *
+ * @param[in]       prog:程序名
+ *
+ * @return          none
+ *============================================================================*/
+static void usage(const char *prog)
+{
+	printf("Usage: %s -m <spin|read|poll|select|sigio|evdev> -d <device> "
+			"-p <sysfs gpio value | gpio-sim pull | gpio-mockup debugfs file> "
+			"[-n count] [-t hold_ms]\r\n", prog);
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int i = 0;
+	int fd = 0;
+	int opt = 0;
+	int mode = -1;
+	int flags = 0;
+	int cnt = 0;
+	int lost = 0;
+	int count = DEFAULT_COUNT;
+	int hold_ms = DEFAULT_HOLD_MS;
+	char *filename = NULL;
+	char *pull = NULL;
+	long long start = 0;
+	long long end = 0;
+	long long stamp = 0;
+	long long *lat = NULL;
+	long long *dlv = NULL;
+	key_state_page_t *state = NULL;
+
+	while ((opt = getopt(argc, argv, "m:d:p:n:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			for (i = 0; i < MODE_MAX; i++)
+			{
+				if (strcmp(optarg, mode_name[i]) == 0)
+				{
+					mode = i;
+				}
+			}
+			break;
+		case 'd': filename = optarg; break;
+		case 'p': pull = optarg; break;
+		case 'n': count = atoi(optarg); break;
+		case 't': hold_ms = atoi(optarg); break;
+		default: usage(argv[0]); return -1;
+		}
+	}
+
+	if ((mode < 0) || !filename || !pull || (count <= 0))
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	lat = calloc(count, sizeof(*lat));
+	dlv = calloc(count, sizeof(*dlv));
+	if ((lat == NULL) || (dlv == NULL))
+	{
+		free(lat);
+		free(dlv);
+		return -1;
+	}
+
+	flags = O_RDWR;
+	if ((mode == MODE_SPIN) || (mode == MODE_SIGIO))
+	{
+		flags |= O_NONBLOCK;
+	}
+	else if (mode == MODE_EVDEV)
+	{
+		flags = O_RDONLY;
+	}
+
+	fd = open(filename, flags);
+	if (fd < 0)
+	{
+		printf("Can't open file %s\r\n", filename);
+		free(lat);
+		free(dlv);
+		return -1;
+	}
+
+	/* 13~16的驱动提供按键状态页，用其中的时间扣除消抖定时器 */
+	if (mode != MODE_EVDEV)
+	{
+		state = mmap(NULL, sizeof(*state), PROT_READ, MAP_SHARED, fd, 0);
+		if (state == MAP_FAILED)
+		{
+			state = NULL;
+		}
+	}
+
+	if (mode == MODE_SIGIO)
+	{
+		sigset_t set;
+
+		sigemptyset(&set);
+		sigaddset(&set, SIGIO);
+		sigprocmask(SIG_BLOCK, &set, NULL);
+		fcntl(fd, F_SETOWN, getpid());
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | FASYNC);
+	}
+
+	/* 先拉高，保证处于松开状态 */
+	if (sim_set_level(pull, 1) < 0)
+	{
+		printf("Can't drive gpio %s\r\n", pull);
+		close(fd);
+		free(lat);
+		free(dlv);
+		return -1;
+	}
+	usleep(hold_ms * 1000);
+
+	for (i = 0; i < count; i++)
+	{
+		/* 按下，等待消抖完成 */
+		sim_set_level(pull, 0);
+		usleep(hold_ms * 1000);
+
+		/* 松开并开始计时，驱动只在松开时上报 */
+		start = now_ns();
+		sim_set_level(pull, 1);
+		if (wait_release(fd, mode) == 0)
+		{
+			end = now_ns();
+			stamp = state_stamp(state);
+			lat[cnt] = end - start;
+			dlv[cnt] = (stamp > start) ? end - stamp : 0;
+			hist_add(state ? dlv[cnt] : lat[cnt]);
+			cnt++;
+		}
+		else
+		{
+			lost++;
+		}
+		usleep(hold_ms * 1000);
+	}
+
+	report(mode, lat, state ? dlv : NULL, cnt, lost);
+
+	if (state)
+	{
+		munmap(state, sizeof(*state));
+	}
+	close(fd);
+	free(lat);
+	free(dlv);
+
+	return 0;
+}
@@ -0,0 +1,464 @@
+/**
+  ******************************************************************************
+  * @file			led_toggle.c
+  * @brief			LED驱动write()翻转速率、单次耗时和CPU开销测试
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-29
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 运行环境：
+  * byte/bank两种方式测的是本仓库的LED驱动，只能在开发板上运行，驱动依赖设备树
+  * 和I.MX6ULL的寄存器，普通PC或gpio-sim上加载不了；
+  * cdev方式只测GPIO字符设备本身，需要4.8以上内核的GPIO_GET_LINEHANDLE_IOCTL，
+  * 开发板的4.1内核没有，只能在PC上配合gpio-sim(5.17+)或gpio-mockup(4.9+)运行，
+  * 配合-v回读模拟引脚。两者不在同一台机器上，cdev的结果只作为量级参考
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "stdint.h"
+#include "sys/types.h"
+#include "sys/stat.h"
+#include "sys/ioctl.h"
+#include "sys/time.h"
+#include "sys/resource.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+#include <linux/gpio.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define HIST_BUCKETS		24			/*!< 直方图桶数，按2的幂划分ns */
+#define DEFAULT_COUNT		100000		/*!< 默认翻转次数 */
+#define DEFAULT_WARMUP		1000		/*!< 预热次数，不计入结果 */
+#define DEFAULT_CHECK		1000		/*!< 每隔多少次回读一次模拟GPIO电平 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 写入方式
+*/
+typedef enum {
+	MODE_BYTE = 0,		/*!< 1字节开关，所有LED驱动 */
+	MODE_BANK,			/*!< struct led_bank_cmd，2/4/17的ioremap驱动 */
+	MODE_CDEV,			/*!< 参考：PC上通过GPIO字符设备翻转gpio-sim引脚，不经过LED驱动 */
+	MODE_MAX,
+}bench_mode_t;
+
+/**
+* @brief 与common/led_bank.h中struct led_bank_cmd一致
+*/
+typedef struct {
+	uint32_t mask;
+	uint32_t value;
+}bank_cmd_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *mode_name[MODE_MAX] = {
+	"byte", "bank", "cdev",
+};
+
+static unsigned long hist[HIST_BUCKETS];		/*!< 耗时直方图 */
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           获取单调时钟，单位ns
+ *
+ * @param[in]       none
+ *
+ * @return          当前时间
+ *============================================================================*/
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**=============================================================================
+ * @brief           timeval转换为us
+ *
+ * @param[in]       tv:时间
+ *
+ * @return          us
+ *============================================================================*/
+static long long tv_us(const struct timeval *tv)
+{
+	return (long long)tv->tv_sec * 1000000LL + tv->tv_usec;
+}
+
+/**=============================================================================
+ * @brief           通过GPIO字符设备申请一个输出引脚
+ *
+ * @param[in]       chip:/dev/gpiochipN
+ * @param[in]		line:引脚偏移
+ *
+ * @return          引脚句柄;负值为失败
+ *============================================================================*/
+static int cdev_request(const char *chip, int line)
+{
+	int fd = 0;
+	int ret = 0;
+	struct gpiohandle_request req;
+
+	fd = open(chip, O_RDWR);
+	if (fd < 0)
+	{
+		return -errno;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.lineoffsets[0] = line;
+	req.lines = 1;
+	req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+	strncpy(req.consumer_label, "led_toggle", sizeof(req.consumer_label) - 1);
+	ret = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+	close(fd);
+
+	return (ret < 0) ? -errno : req.fd;
+}
+
+/**=============================================================================
+ * @brief           写一次LED状态
+ *
+ * @param[in]       fd:设备或引脚句柄
+ * @param[in]		mode:写入方式
+ * @param[in]		mask:MODE_BANK时要更新的引脚
+ * @param[in]		on:1点亮;0关闭
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int led_set(int fd, int mode, uint32_t mask, int on)
+{
+	unsigned char data = on;
+	bank_cmd_t cmd;
+	struct gpiohandle_data hd;
+
+	switch (mode)
+	{
+	case MODE_BYTE:
+		return (write(fd, &data, sizeof(data)) < 0) ? -errno : 0;
+
+	case MODE_BANK:
+		cmd.mask = mask;
+		cmd.value = on ? mask : 0;
+		return (write(fd, &cmd, sizeof(cmd)) < 0) ? -errno : 0;
+
+	case MODE_CDEV:
+		memset(&hd, 0, sizeof(hd));
+		hd.values[0] = !on;		/*!< 与驱动一致，低电平点亮 */
+		return (ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &hd) < 0) ? -errno : 0;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+/**=============================================================================
+ * @brief           读取模拟GPIO电平
+ *
+ * @param[in]       path:gpio-sim的value文件或gpio-mockup的debugfs文件
+ *
+ * @return          0/1:电平;负值为失败
+ *============================================================================*/
+static int sim_get_level(const char *path)
+{
+	int fd = 0;
+	int ret = 0;
+	char buf[4] = {0};
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return -errno;
+	}
+	ret = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	return (ret <= 0) ? -EIO : (buf[0] == '1');
+}
+
+/**=============================================================================
+ * @brief           清零驱动的debugfs计数
+ *
+ * @param[in]       path:debugfs stats文件
+ *
+ * @return          none
+ *============================================================================*/
+static void stats_reset(const char *path)
+{
+	int fd = open(path, O_WRONLY);
+
+	if (fd < 0)
+	{
+		printf("Can't open %s, kernel counters disabled\r\n", path);
+		return;
+	}
+	write(fd, "0", 1);
+	close(fd);
+}
+
+/**=============================================================================
+ * @brief           打印驱动的debugfs计数
+ *
+ * @param[in]       path:debugfs stats文件
+ *
+ * @return          none
+ *============================================================================*/
+static void stats_dump(const char *path)
+{
+	char line[128];
+	FILE *fp = fopen(path, "r");
+
+	if (fp == NULL)
+	{
+		return;
+	}
+
+	printf("kernel (%s):\r\n", path);
+	while (fgets(line, sizeof(line), fp))
+	{
+		printf("  %s", line);
+	}
+	fclose(fp);
+}
+
+/**=============================================================================
+ * @brief           记录一次耗时
+ *
+ * @param[in]       ns:耗时
+ *
+ * @return          none
+ *============================================================================*/
+static void hist_add(long long ns)
+{
+	int i = 0;
+
+	while ((ns > 1) && (i < HIST_BUCKETS - 1))
+	{
+		ns >>= 1;
+		i++;
+	}
+	hist[i]++;
+}
+
+/**=============================================================================
+ * @brief           排序比较函数
+ *
+ * @param[in]       a,b:比较元素
+ *
+ * @return          比较结果
+ *============================================================================*/
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long*)a;
+	long long y = *(const long long*)b;
+
+	return (x > y) - (x < y);
+}
+
+/**=============================================================================
+ * @brief           打印用户态测得的结果
+ *
+ * @param[in]       mode:写入方式
+ * @param[in]		lat:单次耗时数组
+ * @param[in]		cnt:样本数
+ * @param[in]		elapsed:总耗时，ns
+ * @param[in]		before,after:测试前后的资源使用
+ *
+ * @return          none
+ *============================================================================*/
+static void report(int mode, long long *lat, int cnt, long long elapsed,
+					const struct rusage *before, const struct rusage *after)
+{
+	int i = 0;
+	long long sum = 0;
+	long long utime = tv_us(&after->ru_utime) - tv_us(&before->ru_utime);
+	long long stime = tv_us(&after->ru_stime) - tv_us(&before->ru_stime);
+
+	qsort(lat, cnt, sizeof(lat[0]), cmp_ll);
+	for (i = 0; i < cnt; i++)
+	{
+		sum += lat[i];
+	}
+
+	printf("mode=%s writes=%d elapsed=%lldus rate=%.0f/s\r\n", mode_name[mode],
+			cnt, elapsed / 1000, cnt * 1e9 / elapsed);
+	printf("  per call: min=%lldns avg=%lldns p50=%lldns p99=%lldns max=%lldns\r\n",
+			lat[0], sum / cnt, lat[cnt / 2], lat[cnt * 99 / 100], lat[cnt - 1]);
+	printf("  cpu: user=%lldus sys=%lldus (%.0fns/call) vcsw=%ld ivcsw=%ld\r\n",
+			utime, stime, (utime + stime) * 1000.0 / cnt,
+			after->ru_nvcsw - before->ru_nvcsw, after->ru_nivcsw - before->ru_nivcsw);
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		if (hist[i])
+		{
+			printf("  [%10luns, %10luns) %lu\r\n",
+					i ? (1UL << i) : 0UL, 1UL << (i + 1), hist[i]);
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           打印用法
+ *
+ * @param[in]       prog:程序名
+ *
+ * @return          none
+ *============================================================================*/
+static void usage(const char *prog)
+{
+	printf("Usage: %s -d <device|/dev/gpiochipN> [-m byte|bank|cdev] [-l line] "
+			"[-k mask] [-n count] [-w warmup] [-s debugfs stats] "
+			"[-v gpio-sim value | gpio-mockup debugfs file]\r\n", prog);
+	printf("  byte/bank: LED drivers, on the board only\r\n");
+	printf("  cdev: GPIO chardev of a 4.8+ kernel, e.g. gpio-sim on a PC\r\n");
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int i = 0;
+	int fd = 0;
+	int opt = 0;
+	int mode = MODE_BYTE;
+	int line = 0;
+	int errors = 0;
+	int mismatch = 0;
+	int count = DEFAULT_COUNT;
+	int warmup = DEFAULT_WARMUP;
+	uint32_t mask = 1 << 3;
+	char *filename = NULL;
+	char *stats = NULL;
+	char *value = NULL;
+	long long t0 = 0;
+	long long start = 0;
+	long long elapsed = 0;
+	long long *lat = NULL;
+	struct rusage before, after;
+
+	while ((opt = getopt(argc, argv, "d:m:l:k:n:w:s:v:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': filename = optarg; break;
+		case 'm':
+			for (mode = 0; mode < MODE_MAX; mode++)
+			{
+				if (strcmp(optarg, mode_name[mode]) == 0)
+				{
+					break;
+				}
+			}
+			break;
+		case 'l': line = atoi(optarg); break;
+		case 'k': mask = strtoul(optarg, NULL, 0); break;
+		case 'n': count = atoi(optarg); break;
+		case 'w': warmup = atoi(optarg); break;
+		case 's': stats = optarg; break;
+		case 'v': value = optarg; break;
+		default: usage(argv[0]); return -1;
+		}
+	}
+
+	if ((mode >= MODE_MAX) || !filename || (count <= 0) || (warmup < 0))
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	lat = calloc(count, sizeof(*lat));
+	if (lat == NULL)
+	{
+		return -1;
+	}
+
+	fd = (mode == MODE_CDEV) ? cdev_request(filename, line) : open(filename, O_RDWR);
+	if ((mode == MODE_CDEV) && (fd == -ENOTTY))
+	{
+		printf("%s has no line handle ioctl, cdev mode needs a 4.8+ kernel\r\n", filename);
+		free(lat);
+		return -1;
+	}
+	if (fd < 0)
+	{
+		printf("Can't open file %s\r\n", filename);
+		free(lat);
+		return -1;
+	}
+
+	/* 预热，让页表、缓存和CPU频率稳定下来 */
+	for (i = 0; i < warmup; i++)
+	{
+		led_set(fd, mode, mask, i & 1);
+	}
+
+	if (stats)
+	{
+		stats_reset(stats);
+	}
+
+	getrusage(RUSAGE_SELF, &before);
+	start = now_ns();
+	for (i = 0; i < count; i++)
+	{
+		t0 = now_ns();
+		if (led_set(fd, mode, mask, !(i & 1)) < 0)
+		{
+			errors++;
+		}
+		lat[i] = now_ns() - t0;
+		hist_add(lat[i]);
+
+		/* 回读模拟GPIO会引入额外的系统调用，只抽样检查，不计入耗时 */
+		if (value && ((i % DEFAULT_CHECK) == 0))
+		{
+			long long pause = now_ns();
+
+			if (sim_get_level(value) != (i & 1))	/*!< 低电平点亮 */
+			{
+				mismatch++;
+			}
+			start += now_ns() - pause;
+		}
+	}
+	elapsed = now_ns() - start;
+	getrusage(RUSAGE_SELF, &after);
+
+	led_set(fd, mode, mask, 0);
+
+	report(mode, lat, count, elapsed, &before, &after);
+	if (errors)
+	{
+		printf("  write errors: %d\r\n", errors);
+	}
+	if (value)
+	{
+		printf("  pin check: %d/%d mismatched\r\n", mismatch, (count + DEFAULT_CHECK - 1) / DEFAULT_CHECK);
+	}
+	if (stats)
+	{
+		stats_dump(stats);
+	}
+
+	close(fd);
+	free(lat);
+
+	return 0;
+}
@@ -0,0 +1,401 @@
+/**
+  ******************************************************************************
+  * @file			lock_stress.c
+  * @brief			多线程并发访问LED驱动，配合驱动的debugfs锁统计比较各种锁的开销
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-31
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "unistd.h"
+#include "sys/types.h"
+#include "sys/stat.h"
+#include "sys/ioctl.h"
+#include "fcntl.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "time.h"
+#include "sched.h"
+#include "pthread.h"
+#include "../common/led_lease.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define DEFAULT_THREADS		4			/*!< 默认线程数 */
+#define DEFAULT_COUNT		1000		/*!< 默认每个线程的操作次数 */
+#define MAX_THREADS			64			/*!< 最多线程数 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 每次操作的内容
+*/
+typedef enum {
+	MODE_OPEN = 0,		/*!< open-写-保持-关闭，测试open中的独占锁 */
+	MODE_WRITE,			/*!< 只打开一次，反复写，测试shared=1下的按操作加锁 */
+	MODE_LEASE,			/*!< 只打开一次，租用-写-保持-释放，测试shared=1下的租用 */
+	MODE_MAX,
+}bench_mode_t;
+
+/**
+* @brief 线程参数和结果
+*/
+typedef struct {
+	pthread_t tid;			/*!< 线程ID */
+	int index;				/*!< 线程序号 */
+	int done;				/*!< 完成的操作数 */
+	int busy;				/*!< open返回-EBUSY的次数 */
+	int errors;				/*!< 其他错误次数 */
+	long long *lat;			/*!< 每次操作的等待时间 */
+}worker_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *mode_name[MODE_MAX] = {
+	"open", "write", "lease",
+};
+
+static const char *debugfs_files[] = {
+	"stats", "lock", "lease_lock",
+};
+
+static const char *filename = NULL;
+static int mode = MODE_OPEN;
+static int count = DEFAULT_COUNT;
+static int hold_us = 0;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           获取单调时钟，单位ns
+ *
+ * @param[in]       none
+ *
+ * @return          当前时间
+ *============================================================================*/
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**=============================================================================
+ * @brief           写一次LED
+ *
+ * @param[in]       fd:设备文件描述符
+ * @param[in]		on:1点亮;0关闭
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int led_set(int fd, int on)
+{
+	unsigned char data = on;
+
+	return (write(fd, &data, sizeof(data)) < 0) ? -errno : 0;
+}
+
+/**=============================================================================
+ * @brief           一次open-写-保持-关闭，-EBUSY时重试
+ *
+ * @param[in]       w:线程
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int op_open(worker_t *w)
+{
+	int fd = 0;
+	long long start = now_ns();
+
+	/* 9/10在open中睡眠等待，7/8直接返回-EBUSY，这里重试使两者可比 */
+	while ((fd = open(filename, O_RDWR)) < 0)
+	{
+		if (errno != EBUSY)
+		{
+			return -errno;
+		}
+		w->busy++;
+		sched_yield();
+	}
+	w->lat[w->done] = now_ns() - start;
+
+	led_set(fd, 1);
+	if (hold_us)
+	{
+		usleep(hold_us);
+	}
+	led_set(fd, 0);
+	close(fd);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           一次写，或一次租用-写-保持-释放
+ *
+ * @param[in]       w:线程
+ * @param[in]		fd:设备文件描述符
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int op_shared(worker_t *w, int fd)
+{
+	int ret = 0;
+	long long start = now_ns();
+
+	if (mode == MODE_WRITE)
+	{
+		ret = led_set(fd, w->done & 1);
+		w->lat[w->done] = now_ns() - start;
+		return ret;
+	}
+
+	if (ioctl(fd, LED_LEASE_ACQUIRE) < 0)
+	{
+		return -errno;
+	}
+	w->lat[w->done] = now_ns() - start;
+
+	led_set(fd, 1);
+	if (hold_us)
+	{
+		usleep(hold_us);
+	}
+	led_set(fd, 0);
+	ioctl(fd, LED_LEASE_RELEASE);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           工作线程
+ *
+ * @param[in]       arg:worker_t
+ *
+ * @return          NULL
+ *============================================================================*/
+static void *worker(void *arg)
+{
+	int fd = -1;
+	worker_t *w = arg;
+
+	if (mode != MODE_OPEN)
+	{
+		fd = open(filename, O_RDWR);
+		if (fd < 0)
+		{
+			printf("thread %d: can't open %s: %s\r\n", w->index, filename, strerror(errno));
+			return NULL;
+		}
+	}
+
+	while (w->done < count)
+	{
+		if (((mode == MODE_OPEN) ? op_open(w) : op_shared(w, fd)) < 0)
+		{
+			w->errors++;
+			if (w->errors > count)
+			{
+				break;
+			}
+			continue;
+		}
+		w->done++;
+	}
+
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+
+	return NULL;
+}
+
+/**=============================================================================
+ * @brief           清零或打印驱动的debugfs统计
+ *
+ * @param[in]       dir:debugfs目录，如/sys/kernel/debug/gpioled
+ * @param[in]		dump:0清零;1打印
+ *
+ * @return          none
+ *============================================================================*/
+static void debugfs_stats(const char *dir, int dump)
+{
+	unsigned int i = 0;
+	char path[256];
+	char line[128];
+	FILE *fp = NULL;
+
+	for (i = 0; i < sizeof(debugfs_files) / sizeof(debugfs_files[0]); i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", dir, debugfs_files[i]);
+		fp = fopen(path, dump ? "r" : "w");
+		if (fp == NULL)
+		{
+			continue;
+		}
+
+		if (dump)
+		{
+			printf("kernel %s:\r\n", path);
+			while (fgets(line, sizeof(line), fp))
+			{
+				printf("  %s", line);
+			}
+		}
+		else
+		{
+			fputs("0", fp);
+		}
+		fclose(fp);
+	}
+}
+
+/**=============================================================================
+ * @brief           排序比较函数
+ *
+ * @param[in]       a,b:比较元素
+ *
+ * @return          比较结果
+ *============================================================================*/
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long*)a;
+	long long y = *(const long long*)b;
+
+	return (x > y) - (x < y);
+}
+
+/**=============================================================================
+ * @brief           打印用法
+ *
+ * @param[in]       prog:程序名
+ *
+ * @return          none
+ *============================================================================*/
+static void usage(const char *prog)
+{
+	printf("Usage: %s -d <device> [-m open|write|lease] [-t threads] [-n count] "
+			"[-H hold_us] [-s debugfs dir]\r\n", prog);
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       argc:数组元素个数
+ * @param[in]		argv:具体参数
+ *
+ * @return          none
+ *============================================================================*/
+int main(int argc, char *argv[])
+{
+	int i = 0;
+	int opt = 0;
+	int total = 0;
+	int busy = 0;
+	int errors = 0;
+	int threads = DEFAULT_THREADS;
+	char *stats = NULL;
+	long long sum = 0;
+	long long start = 0;
+	long long elapsed = 0;
+	long long *lat = NULL;
+	worker_t *workers = NULL;
+
+	while ((opt = getopt(argc, argv, "d:m:t:n:H:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': filename = optarg; break;
+		case 'm':
+			for (mode = 0; mode < MODE_MAX; mode++)
+			{
+				if (strcmp(optarg, mode_name[mode]) == 0)
+				{
+					break;
+				}
+			}
+			break;
+		case 't': threads = atoi(optarg); break;
+		case 'n': count = atoi(optarg); break;
+		case 'H': hold_us = atoi(optarg); break;
+		case 's': stats = optarg; break;
+		default: usage(argv[0]); return -1;
+		}
+	}
+
+	if (!filename || (mode >= MODE_MAX) || (threads <= 0) || (threads > MAX_THREADS)
+		|| (count <= 0) || (hold_us < 0))
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	/* 所有线程的样本放在一个数组里，结束后一起排序 */
+	lat = calloc((size_t)threads * count, sizeof(*lat));
+	workers = calloc(threads, sizeof(*workers));
+	if (!lat || !workers)
+	{
+		free(lat);
+		free(workers);
+		return -1;
+	}
+
+	if (stats)
+	{
+		debugfs_stats(stats, 0);
+	}
+
+	start = now_ns();
+	for (i = 0; i < threads; i++)
+	{
+		workers[i].index = i;
+		workers[i].lat = lat + (size_t)i * count;
+		pthread_create(&workers[i].tid, NULL, worker, &workers[i]);
+	}
+	for (i = 0; i < threads; i++)
+	{
+		pthread_join(workers[i].tid, NULL);
+	}
+	elapsed = now_ns() - start;
+
+	/* 把各线程的有效样本挪到一起 */
+	for (i = 0; i < threads; i++)
+	{
+		memmove(lat + total, workers[i].lat, workers[i].done * sizeof(*lat));
+		total += workers[i].done;
+		busy += workers[i].busy;
+		errors += workers[i].errors;
+		printf("thread %d: ops=%d busy=%d errors=%d\r\n", i, workers[i].done,
+				workers[i].busy, workers[i].errors);
+	}
+
+	if (total)
+	{
+		qsort(lat, total, sizeof(lat[0]), cmp_ll);
+		for (i = 0; i < total; i++)
+		{
+			sum += lat[i];
+		}
+		printf("mode=%s threads=%d ops=%d busy=%d errors=%d elapsed=%lldus rate=%.0f/s\r\n",
+				mode_name[mode], threads, total, busy, errors, elapsed / 1000,
+				total * 1e9 / elapsed);
+		printf("  wait: min=%lldns avg=%lldns p50=%lldns p99=%lldns max=%lldns\r\n",
+				lat[0], sum / total, lat[total / 2], lat[total * 99 / 100], lat[total - 1]);
+	}
+
+	if (stats)
+	{
+		debugfs_stats(stats, 1);
+	}
+
+	free(lat);
+	free(workers);
+
+	return 0;
+}
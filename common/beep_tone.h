@@ -0,0 +1,379 @@
+/**
+  ******************************************************************************
+  * @file			beep_tone.h
+  * @brief			蜂鸣器音调发生器，音符队列由hrtimer翻转GPIO异步播放
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-01
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __BEEP_TONE_H_
+#define __BEEP_TONE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define BEEP_TONE_QUEUE_LEN		64			/*!< 音符队列长度，必须是2的幂 */
+#define BEEP_TONE_MIN_HZ		20			/*!< 最低频率 */
+#define BEEP_TONE_MAX_HZ		10000		/*!< 最高频率，半周期50us */
+#define BEEP_TONE_MAX_MS		60000		/*!< 单个音符最长时间 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 一个音符
+*/
+struct beep_note {
+	__u32 freq_hz;			/*!< 频率，0为休止符 */
+	__u32 duration_ms;		/*!< 时长，ms */
+};
+
+/**
+* @brief 一次追加到队列的音符
+*/
+struct beep_tone {
+	__u32 count;			/*!< 音符数，不超过BEEP_TONE_QUEUE_LEN */
+	__u32 reserved;			/*!< 保留，填0 */
+	__u64 notes;			/*!< 用户空间struct beep_note数组地址 */
+};
+
+/* Exported macros -----------------------------------------------------------*/
+#define BEEP_TONE_QUEUE		_IOW(0xEE, 0x30, struct beep_tone)	/*!< 追加音符，队列满时等待 */
+#define BEEP_TONE_STOP		_IO(0xEE, 0x31)						/*!< 清空队列并静音 */
+
+#ifdef __KERNEL__
+
+#include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+
+/**
+* @brief 音调发生器，GPIO低电平发声
+*/
+typedef struct {
+	struct hrtimer timer;	/*!< 高精度定时器 */
+	spinlock_t lock;		/*!< 保护队列和播放状态 */
+	wait_queue_head_t wait;	/*!< 等待队列有空位 */
+	int gpio;				/*!< GPIO编号 */
+	struct beep_note queue[BEEP_TONE_QUEUE_LEN];	/*!< 音符队列 */
+	u32 head;				/*!< 写入位置，自由增长 */
+	u32 tail;				/*!< 读出位置，自由增长 */
+	bool playing;			/*!< 定时器是否在运行 */
+	int level;				/*!< 当前是否发声 */
+	u32 half_ns;			/*!< 当前音符的半周期 */
+	u64 halves;				/*!< 当前音符剩余的半周期数 */
+}beep_tone_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           取出下一个音符开始播放，调用者持有lock
+ *
+ * @param[in]       tone:音调发生器
+ * @param[out]		next_ns:到下一次定时器到期的时间
+ *
+ * @return          true:开始播放新音符;false:队列已空
+ *============================================================================*/
+static inline bool beep_tone_next(beep_tone_t *tone, u64 *next_ns)
+{
+	struct beep_note *note = NULL;
+
+	if (tone->head == tone->tail)
+	{
+		return false;
+	}
+
+	note = &tone->queue[tone->tail++ & (BEEP_TONE_QUEUE_LEN - 1)];
+	if (note->freq_hz == 0)		/*!< 休止符，整段时间只需要一次到期 */
+	{
+		tone->level = 0;
+		tone->halves = 0;
+		*next_ns = (u64)note->duration_ms * NSEC_PER_MSEC;
+	}
+	else
+	{
+		tone->level = 1;
+		tone->half_ns = NSEC_PER_SEC / (2 * note->freq_hz);
+		tone->halves = div_u64((u64)note->duration_ms * note->freq_hz * 2, MSEC_PER_SEC);
+		tone->halves = tone->halves ? tone->halves - 1 : 0;	/*!< 第一个半周期现在开始 */
+		*next_ns = tone->half_ns;
+	}
+	gpio_set_value(tone->gpio, !tone->level);
+
+	return true;
+}
+
+/**=============================================================================
+ * @brief           定时器回调，翻转GPIO或切换到下一个音符
+ *
+ * @param[in]       timer:到期的定时器
+ *
+ * @return          HRTIMER_RESTART:继续;HRTIMER_NORESTART:队列播放完毕
+ *============================================================================*/
+static inline enum hrtimer_restart beep_tone_callback(struct hrtimer *timer)
+{
+	beep_tone_t *tone = container_of(timer, beep_tone_t, timer);
+	u64 next_ns = 0;
+
+	spin_lock(&tone->lock);
+	if (tone->halves)
+	{
+		tone->halves--;
+		tone->level = !tone->level;
+		gpio_set_value(tone->gpio, !tone->level);
+		next_ns = tone->half_ns;
+	}
+	else if (!beep_tone_next(tone, &next_ns))
+	{
+		tone->playing = false;
+		tone->level = 0;
+		gpio_set_value(tone->gpio, 1);	/*!< 播放完毕静音 */
+		spin_unlock(&tone->lock);
+		return HRTIMER_NORESTART;
+	}
+	else
+	{
+		wake_up_interruptible(&tone->wait);		/*!< 取走一个音符，队列有空位了 */
+	}
+	spin_unlock(&tone->lock);
+
+	/* 以上次到期点为基准，音高和节拍都不随回调延迟漂移 */
+	hrtimer_forward_now(timer, ns_to_ktime(next_ns));
+
+	return HRTIMER_RESTART;
+}
+
+/**=============================================================================
+ * @brief           初始化音调发生器
+ *
+ * @param[in]       tone:音调发生器
+ * @param[in]		gpio:GPIO编号
+ *
+ * @return          none
+ *============================================================================*/
+static inline void beep_tone_init(beep_tone_t *tone, int gpio)
+{
+	memset(tone, 0, sizeof(*tone));
+	spin_lock_init(&tone->lock);
+	init_waitqueue_head(&tone->wait);
+	hrtimer_init(&tone->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	tone->timer.function = beep_tone_callback;
+	tone->gpio = gpio;
+}
+
+/**=============================================================================
+ * @brief           清空队列并停止播放，之后由调用者直接控制GPIO
+ *
+ * @param[in]       tone:音调发生器
+ *
+ * @return          none
+ *============================================================================*/
+static inline void beep_tone_stop(beep_tone_t *tone)
+{
+	unsigned long flags;
+
+	hrtimer_cancel(&tone->timer);
+
+	spin_lock_irqsave(&tone->lock, flags);
+	tone->head = tone->tail = 0;
+	tone->halves = 0;
+	tone->playing = false;
+	spin_unlock_irqrestore(&tone->lock, flags);
+
+	wake_up_interruptible(&tone->wait);
+}
+
+/**=============================================================================
+ * @brief           队列空位数，调用者持有lock
+ *
+ * @param[in]       tone:音调发生器
+ *
+ * @return          空位数
+ *============================================================================*/
+static inline u32 beep_tone_room(beep_tone_t *tone)
+{
+	return BEEP_TONE_QUEUE_LEN - (tone->head - tone->tail);
+}
+
+/**=============================================================================
+ * @brief           队列是否放得下count个音符，不持锁读取，只用于等待条件
+ *
+ * @param[in]       tone:音调发生器
+ * @param[in]		count:音符数
+ *
+ * @return          true:放得下;false:放不下
+ *============================================================================*/
+static inline bool beep_tone_fits(beep_tone_t *tone, u32 count)
+{
+	return READ_ONCE(tone->head) - READ_ONCE(tone->tail) <= BEEP_TONE_QUEUE_LEN - count;
+}
+
+/**=============================================================================
+ * @brief           等待队列放得下用户空间这次要追加的音符
+ *
+ * 驱动在自己的锁内以nonblock方式追加，-EAGAIN时放开锁在这里等待后重试；
+ * 音符数不合法时直接返回，由重试的beep_tone_queue报错
+ *
+ * @param[in]       tone:音调发生器
+ * @param[in]		uarg:用户空间struct beep_tone地址
+ *
+ * @return          0:可以重试;其他:失败
+ *============================================================================*/
+static inline int beep_tone_wait(beep_tone_t *tone, const void __user *uarg)
+{
+	struct beep_tone desc;
+
+	if (copy_from_user(&desc, uarg, sizeof(desc)))
+	{
+		return -EFAULT;
+	}
+
+	if ((desc.count == 0) || (desc.count > BEEP_TONE_QUEUE_LEN))
+	{
+		return 0;
+	}
+
+	return wait_event_interruptible(tone->wait, beep_tone_fits(tone, desc.count));
+}
+
+/**=============================================================================
+ * @brief           从用户空间追加音符，没有在播放时开始播放
+ *
+ * @param[in]       tone:音调发生器
+ * @param[in]		uarg:用户空间struct beep_tone地址
+ * @param[in]		nonblock:队列空位不够时不等待，返回-EAGAIN
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int beep_tone_queue(beep_tone_t *tone, const void __user *uarg, bool nonblock)
+{
+	u32 i = 0;
+	int ret = 0;
+	bool start = false;
+	unsigned long flags;
+	struct beep_tone desc;
+	struct beep_note *notes = NULL;
+
+	if (copy_from_user(&desc, uarg, sizeof(desc)))
+	{
+		return -EFAULT;
+	}
+
+	if ((desc.count == 0) || (desc.count > BEEP_TONE_QUEUE_LEN))
+	{
+		return -EINVAL;
+	}
+
+	notes = kmalloc_array(desc.count, sizeof(*notes), GFP_KERNEL);
+	if (notes == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	if (copy_from_user(notes, (const void __user *)(unsigned long)desc.notes,
+						desc.count * sizeof(*notes)))
+	{
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < desc.count; i++)
+	{
+		if ((notes[i].duration_ms == 0) || (notes[i].duration_ms > BEEP_TONE_MAX_MS)
+			|| (notes[i].freq_hz && ((notes[i].freq_hz < BEEP_TONE_MIN_HZ)
+									|| (notes[i].freq_hz > BEEP_TONE_MAX_HZ))))
+		{
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	spin_lock_irqsave(&tone->lock, flags);
+	while (beep_tone_room(tone) < desc.count)
+	{
+		spin_unlock_irqrestore(&tone->lock, flags);
+		if (nonblock)
+		{
+			ret = -EAGAIN;
+			goto out;
+		}
+		ret = wait_event_interruptible(tone->wait, beep_tone_fits(tone, desc.count));
+		if (ret)
+		{
+			goto out;
+		}
+		spin_lock_irqsave(&tone->lock, flags);
+	}
+
+	for (i = 0; i < desc.count; i++)
+	{
+		tone->queue[tone->head++ & (BEEP_TONE_QUEUE_LEN - 1)] = notes[i];
+	}
+	if (!tone->playing)
+	{
+		tone->playing = true;
+		start = true;
+	}
+	spin_unlock_irqrestore(&tone->lock, flags);
+
+	/* 定时器空闲时立即到期，在回调中取出第一个音符 */
+	if (start)
+	{
+		hrtimer_start(&tone->timer, ktime_set(0, 0), HRTIMER_MODE_REL);
+	}
+
+out:
+	kfree(notes);
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           音调相关的ioctl处理
+ *
+ * @param[in]       tone:音调发生器
+ * @param[in]		cmd:命令
+ * @param[in]		arg:参数
+ * @param[in]		nonblock:设备文件是否以O_NONBLOCK打开
+ *
+ * @return          0:成功;-ENOTTY:不是音调命令;其他:失败
+ *============================================================================*/
+static inline long beep_tone_ioctl(beep_tone_t *tone, unsigned int cmd, unsigned long arg, bool nonblock)
+{
+	switch (cmd)
+	{
+	case BEEP_TONE_QUEUE:
+		return beep_tone_queue(tone, (const void __user *)arg, nonblock);
+
+	case BEEP_TONE_STOP:
+		beep_tone_stop(tone);
+		gpio_set_value(tone->gpio, 1);
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif /* __KERNEL__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __BEEP_TONE_H_ */
@@ -0,0 +1,292 @@
+/**
+  ******************************************************************************
+  * @file			drv_chrdev.h
+  * @brief			字符设备注册的公共部分：设备号、cdev、类和设备节点
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-12
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 各驱动原来都要重复alloc_chrdev_region/cdev_init/cdev_add/class_create/
+  * device_create，失败时大多没有回退。这里一次完成注册，失败时按相反顺序撤销；
+  * 总线驱动的remove要先drv_chrdev_del摘掉节点，再drv_ref_kill，最后停硬件，
+  * devm的注销在remove返回之后才执行，所以17、18、21、22都手动注销；
+  * devm_drv_chrdev_add只适合remove里没有别的资源要先停的驱动。
+  *
+  * cdev由cdev_alloc动态分配，生命周期由内核管理，不嵌在驱动结构体里：
+  * 4.1内核在release之后才cdev_put，嵌入的cdev会让驱动在最后一次close时
+  * 无法释放自己的结构体。open先进入这里的drv_chrdev_open，在锁内按设备号
+  * 找到注册信息并记为正在打开，把filp->private_data设为drvdata后换成驱动的
+  * fops再调用驱动的open。驱动的open不在锁内执行，可以睡眠等待设备空闲；
+  * drv_chrdev_del摘除注册后等待正在进行的open结束，返回后不会再有open进入
+  * 驱动。驱动状态需要在解绑后继续存在时配合drv_ref.h
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DRV_CHRDEV_H_
+#define __DRV_CHRDEV_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/cdev.h>
+#include <linux/compiler.h>
+#include <linux/device.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 一个字符设备，嵌入驱动自己的设备结构体中
+*/
+typedef struct {
+	dev_t devid;			/*!< 设备号 */
+	struct cdev *cdev;		/*!< cdev，动态分配 */
+	struct class *class;	/*!< 类 */
+	struct device *device;	/*!< 设备 */
+	int major;				/*!< 主设备号，注册前非0则使用指定的主设备号 */
+	const struct file_operations *fops;	/*!< 驱动的操作函数 */
+	void *drvdata;			/*!< open时放入filp->private_data */
+	struct list_head node;	/*!< 挂在drv_chrdev_list上 */
+	unsigned int opening;	/*!< 正在执行驱动open的个数，drv_chrdev_lock保护 */
+	wait_queue_head_t wait;	/*!< drv_chrdev_del等待opening为0 */
+}drv_chrdev_t;
+
+/* Private variables ---------------------------------------------------------*/
+/* 每个模块一份，包含本头文件的驱动只看到自己注册的设备 */
+static LIST_HEAD(drv_chrdev_list);
+static DEFINE_MUTEX(drv_chrdev_lock);
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           所有drv_chrdev设备共用的open，找到注册信息后转给驱动
+ *
+ * @param[in]       inode:节点
+ * @param[in]		filp:设备文件
+ *
+ * @return          0:成功;-ENODEV:设备已注销;其他:驱动open的返回值
+ *============================================================================*/
+static inline int drv_chrdev_open(struct inode *inode, struct file *filp)
+{
+	int ret = -ENODEV;
+	drv_chrdev_t *cd = NULL;
+	const struct file_operations *fops = NULL;
+
+	mutex_lock(&drv_chrdev_lock);
+	list_for_each_entry(cd, &drv_chrdev_list, node)
+	{
+		if (cd->devid == inode->i_rdev)
+		{
+			fops = fops_get(cd->fops);
+			cd->opening++;
+			break;
+		}
+	}
+	mutex_unlock(&drv_chrdev_lock);
+
+	if (fops == NULL)
+	{
+		return ret;
+	}
+
+	filp->private_data = cd->drvdata;
+	replace_fops(filp, fops);
+	ret = fops->open ? fops->open(inode, filp) : 0;
+
+	/* 在锁内唤醒，drv_chrdev_del等到opening为0后再拿一次锁才返回 */
+	mutex_lock(&drv_chrdev_lock);
+	if (--cd->opening == 0)
+	{
+		wake_up(&cd->wait);
+	}
+	mutex_unlock(&drv_chrdev_lock);
+
+	return ret;
+}
+
+static const struct file_operations drv_chrdev_fops = {
+	.owner = THIS_MODULE,
+	.open = drv_chrdev_open,
+	.llseek = noop_llseek,
+};
+
+/**=============================================================================
+ * @brief           注册字符设备并创建/dev/<name>
+ *
+ * @param[in]       cd:字符设备，major以外的成员由本函数填写
+ * @param[in]		parent:父设备，可以为NULL
+ * @param[in]		name:设备号、类和设备节点的名字
+ * @param[in]		fops:操作函数
+ * @param[in]		drvdata:设备的私有数据，open时放入filp->private_data，
+ *					也可以用dev_get_drvdata(cd->device)取回
+ *
+ * @return          0:成功;其他:失败，已注册的部分全部撤销
+ *============================================================================*/
+static inline int drv_chrdev_add(drv_chrdev_t *cd, struct device *parent, const char *name,
+								const struct file_operations *fops, void *drvdata)
+{
+	int ret = 0;
+
+	cd->fops = fops;
+	cd->drvdata = drvdata;
+	cd->opening = 0;
+	init_waitqueue_head(&cd->wait);
+
+	/* 1. 设备号 */
+	if (cd->major)
+	{
+		cd->devid = MKDEV(cd->major, 0);
+		ret = register_chrdev_region(cd->devid, 1, name);
+	}
+	else
+	{
+		ret = alloc_chrdev_region(&cd->devid, 0, 1, name);
+		cd->major = MAJOR(cd->devid);
+	}
+	if (ret < 0)
+	{
+		return ret;
+	}
+
+	/* 2. cdev，先登记再cdev_add，节点可以打开时一定能找到 */
+	cd->cdev = cdev_alloc();
+	if (cd->cdev == NULL)
+	{
+		ret = -ENOMEM;
+		goto fail_region;
+	}
+	cd->cdev->ops = &drv_chrdev_fops;
+	cd->cdev->owner = fops->owner;
+
+	mutex_lock(&drv_chrdev_lock);
+	list_add(&cd->node, &drv_chrdev_list);
+	mutex_unlock(&drv_chrdev_lock);
+
+	ret = cdev_add(cd->cdev, cd->devid, 1);
+	if (ret < 0)
+	{
+		kobject_put(&cd->cdev->kobj);
+		goto fail_list;
+	}
+
+	/* 3. 类 */
+	cd->class = class_create(fops->owner, name);
+	if (IS_ERR(cd->class))
+	{
+		ret = PTR_ERR(cd->class);
+		goto fail_cdev;
+	}
+
+	/* 4. 设备 */
+	cd->device = device_create(cd->class, parent, cd->devid, drvdata, "%s", name);
+	if (IS_ERR(cd->device))
+	{
+		ret = PTR_ERR(cd->device);
+		goto fail_class;
+	}
+
+	return 0;
+
+fail_class:
+	class_destroy(cd->class);
+fail_cdev:
+	cdev_del(cd->cdev);
+fail_list:
+	mutex_lock(&drv_chrdev_lock);
+	list_del(&cd->node);
+	mutex_unlock(&drv_chrdev_lock);
+fail_region:
+	unregister_chrdev_region(cd->devid, 1);
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           注销drv_chrdev_add注册的字符设备
+ *
+ * 返回后不会再有open进入驱动，正在执行的open也已经返回；已经打开的文件
+ * 继续使用驱动的fops，fops->owner使模块在文件打开期间不能卸载。总线设备
+ * 解绑后驱动状态还要被这些文件访问时，用drv_ref.h管理状态的生命周期
+ *
+ * @param[in]       cd:字符设备
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_chrdev_del(drv_chrdev_t *cd)
+{
+	mutex_lock(&drv_chrdev_lock);
+	list_del(&cd->node);
+	mutex_unlock(&drv_chrdev_lock);
+	wait_event(cd->wait, READ_ONCE(cd->opening) == 0);
+
+	/* 减计数和wake_up都在锁内，拿一次锁保证最后一个open已经不再访问cd */
+	mutex_lock(&drv_chrdev_lock);
+	mutex_unlock(&drv_chrdev_lock);
+
+	device_destroy(cd->class, cd->devid);
+	class_destroy(cd->class);
+	cdev_del(cd->cdev);
+	unregister_chrdev_region(cd->devid, 1);
+}
+
+/**=============================================================================
+ * @brief           devm回调
+ *
+ * @param[in]       data:字符设备
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_chrdev_release(void *data)
+{
+	drv_chrdev_del((drv_chrdev_t*)data);
+}
+
+/**=============================================================================
+ * @brief           devm版本的drv_chrdev_add，dev解绑时自动注销
+ *
+ * 注销顺序与devm资源申请的顺序相反，所以应在probe中最后调用，
+ * 节点出现时硬件已经初始化完毕，节点消失前硬件资源都还有效。
+ * 注销发生在remove返回之后，remove里要停的硬件或drv_ref_kill都会
+ * 早于节点消失，这类驱动应在remove开头调用drv_chrdev_del
+ *
+ * @param[in]       dev:总线设备，同时作为设备节点的父设备
+ * @param[in]		cd:字符设备
+ * @param[in]		name:名字
+ * @param[in]		fops:操作函数
+ * @param[in]		drvdata:设备的私有数据
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int devm_drv_chrdev_add(struct device *dev, drv_chrdev_t *cd, const char *name,
+									const struct file_operations *fops, void *drvdata)
+{
+	int ret = 0;
+
+	ret = drv_chrdev_add(cd, dev, name, fops, drvdata);
+	if (ret < 0)
+	{
+		return ret;
+	}
+
+	ret = devm_add_action(dev, drv_chrdev_release, cd);
+	if (ret < 0)
+	{
+		drv_chrdev_del(cd);
+	}
+
+	return ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DRV_CHRDEV_H_ */
@@ -0,0 +1,323 @@
+/**
+  ******************************************************************************
+  * @file			drv_evq.h
+  * @brief			中断产生、read()消费的事件队列：阻塞读、poll、fasync和计数
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-12
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 事件在中断或定时器中入队，满时丢弃新事件并计数；read()一次取出尽可能多的
+  * 完整记录，每条记录为事件值的低rec_size字节。驱动只需要在file_operations中
+  * 把read/poll/fasync转给这里，在release中调用drv_evq_fasync(-1, filp, 0, q)
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DRV_EVQ_H_
+#define __DRV_EVQ_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define DRV_EVQ_LEN			32		/*!< 队列长度，必须是2的幂 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 事件队列，在/sys/kernel/debug/<驱动名>/evq中查看计数
+*/
+typedef struct {
+	spinlock_t lock;		/*!< 保护队列和计数 */
+	wait_queue_head_t wait;	/*!< 读等待队列 */
+	struct fasync_struct *async_queue;	/*!< 异步通知 */
+	unsigned int rec_size;	/*!< 每条记录的字节数：1、2或4 */
+	u32 ring[DRV_EVQ_LEN];	/*!< 事件环形缓冲 */
+	u32 head;				/*!< 写入位置，自由增长 */
+	u32 tail;				/*!< 读出位置，自由增长 */
+	u64 pushed;				/*!< 入队事件数 */
+	u64 dropped;			/*!< 队列满丢弃的事件数 */
+	u64 delivered;			/*!< 被read()取走的事件数 */
+	u32 peak;				/*!< 队列最大深度 */
+}drv_evq_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           初始化事件队列
+ *
+ * @param[in]       q:事件队列
+ * @param[in]		rec_size:read()中每条记录的字节数，1、2或4
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_evq_init(drv_evq_t *q, unsigned int rec_size)
+{
+	memset(q, 0, sizeof(*q));
+	spin_lock_init(&q->lock);
+	init_waitqueue_head(&q->wait);
+	q->rec_size = rec_size;
+}
+
+/**=============================================================================
+ * @brief           事件入队并通知读者，可在中断和定时器中调用
+ *
+ * poll/epoll等待者各收到一次边沿，阻塞读者只唤醒一个
+ *
+ * @param[in]       q:事件队列
+ * @param[in]		value:事件值
+ *
+ * @return          0:成功;-ENOSPC:队列满，事件被丢弃
+ *============================================================================*/
+static inline int drv_evq_push(drv_evq_t *q, u32 value)
+{
+	unsigned long flags;
+	u32 depth = 0;
+
+	spin_lock_irqsave(&q->lock, flags);
+	depth = q->head - q->tail;
+	if (depth >= DRV_EVQ_LEN)
+	{
+		q->dropped++;
+		spin_unlock_irqrestore(&q->lock, flags);
+		return -ENOSPC;
+	}
+	q->ring[q->head & (DRV_EVQ_LEN - 1)] = value;
+	q->head++;
+	q->pushed++;
+	if (depth + 1 > q->peak)
+	{
+		q->peak = depth + 1;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	wake_up_interruptible_poll(&q->wait, POLLIN | POLLRDNORM);
+	kill_fasync(&q->async_queue, SIGIO, POLL_IN);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           队列是否为空，无锁读取，只用于等待条件和poll
+ *
+ * @param[in]       q:事件队列
+ *
+ * @return          非0:空
+ *============================================================================*/
+static inline int drv_evq_empty(drv_evq_t *q)
+{
+	return READ_ONCE(q->head) == READ_ONCE(q->tail);
+}
+
+/**=============================================================================
+ * @brief           取出最多max个事件
+ *
+ * @param[in]       q:事件队列
+ * @param[out]		buf:事件
+ * @param[in]		max:最多取出的个数
+ *
+ * @return          取出的个数
+ *============================================================================*/
+static inline unsigned int drv_evq_pop(drv_evq_t *q, u32 *buf, unsigned int max)
+{
+	unsigned long flags;
+	unsigned int n = 0;
+
+	spin_lock_irqsave(&q->lock, flags);
+	while ((n < max) && (q->tail != q->head))
+	{
+		buf[n++] = q->ring[q->tail & (DRV_EVQ_LEN - 1)];
+		q->tail++;
+	}
+	q->delivered += n;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	return n;
+}
+
+/**=============================================================================
+ * @brief           read()的实现，队列空时阻塞或返回-EAGAIN
+ *
+ * 事件先原子地取出再拷贝，多个读者时同一事件只会被一个读者拿到
+ *
+ * @param[in]       q:事件队列
+ * @param[in]		filp:设备文件，用于判断O_NONBLOCK
+ * @param[out]		buf:用户空间缓冲区
+ * @param[in]		cnt:缓冲区大小
+ *
+ * @return          读取的字节数;-EINVAL:放不下一条记录;-EAGAIN;-ERESTARTSYS;-EFAULT
+ *============================================================================*/
+static inline ssize_t drv_evq_read(drv_evq_t *q, struct file *filp, char __user *buf, size_t cnt)
+{
+	int ret = 0;
+	unsigned int i = 0;
+	unsigned int n = 0;
+	u32 ev[DRV_EVQ_LEN];
+	u8 out[DRV_EVQ_LEN * sizeof(u32)];
+	unsigned int max = cnt / q->rec_size;
+
+	if (max == 0)
+	{
+		return -EINVAL;
+	}
+	if (max > DRV_EVQ_LEN)
+	{
+		max = DRV_EVQ_LEN;
+	}
+
+	while ((n = drv_evq_pop(q, ev, max)) == 0)
+	{
+		if (filp->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+
+		/* 独占等待，避免惊群 */
+		ret = wait_event_interruptible_exclusive(q->wait, !drv_evq_empty(q));
+		if (ret)
+		{
+			/* 被信号打断时把唤醒传递给下一个等待者，防止事件滞留 */
+			if (!drv_evq_empty(q))
+			{
+				wake_up_interruptible_poll(&q->wait, POLLIN | POLLRDNORM);
+			}
+			return ret;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		switch (q->rec_size)
+		{
+		case 1: out[i] = ev[i]; break;
+		case 2: ((u16*)out)[i] = ev[i]; break;
+		default: ((u32*)out)[i] = ev[i]; break;
+		}
+	}
+
+	if (copy_to_user(buf, out, n * q->rec_size))
+	{
+		return -EFAULT;
+	}
+
+	return n * q->rec_size;
+}
+
+/**=============================================================================
+ * @brief           poll()的实现
+ *
+ * @param[in]       q:事件队列
+ * @param[in]		filp:设备文件
+ * @param[in]		wait:等待列表
+ *
+ * @return          POLLIN|POLLRDNORM:有事件;0:无事件
+ *============================================================================*/
+static inline unsigned int drv_evq_poll(drv_evq_t *q, struct file *filp,
+										struct poll_table_struct *wait)
+{
+	poll_wait(filp, &q->wait, wait);
+
+	return drv_evq_empty(q) ? 0 : (POLLIN | POLLRDNORM);
+}
+
+/**=============================================================================
+ * @brief           fasync()的实现，release时以fd=-1、on=0调用以删除异步通知
+ *
+ * @param[in]       fd:文件描述符
+ * @param[in]		filp:设备文件
+ * @param[in]		on:模式
+ * @param[in]		q:事件队列
+ *
+ * @return          负数则执行失败
+ *============================================================================*/
+static inline int drv_evq_fasync(int fd, struct file *filp, int on, drv_evq_t *q)
+{
+	return fasync_helper(fd, filp, on, &q->async_queue);
+}
+
+/**=============================================================================
+ * @brief           debugfs evq文件输出
+ *
+ * @param[in]       m:seq_file
+ * @param[in]		v:未使用
+ *
+ * @return          0
+ *============================================================================*/
+static inline int drv_evq_show(struct seq_file *m, void *v)
+{
+	drv_evq_t *q = (drv_evq_t*)m->private;
+	unsigned long flags;
+	u64 pushed, dropped, delivered;
+	u32 depth, peak;
+
+	spin_lock_irqsave(&q->lock, flags);
+	pushed = q->pushed;
+	dropped = q->dropped;
+	delivered = q->delivered;
+	depth = q->head - q->tail;
+	peak = q->peak;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	seq_printf(m, "pushed: %llu\ndropped: %llu\ndelivered: %llu\ndepth: %u/%u\npeak: %u\n",
+				pushed, dropped, delivered, depth, DRV_EVQ_LEN, peak);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           debugfs evq文件打开
+ *
+ * @param[in]       inode:节点
+ * @param[in]		file:文件
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int drv_evq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, drv_evq_show, inode->i_private);
+}
+
+static const struct file_operations drv_evq_fops = {
+	.owner = THIS_MODULE,
+	.open = drv_evq_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**=============================================================================
+ * @brief           在debugfs目录下创建evq文件
+ *
+ * debugfs不可用时只是看不到计数，不影响驱动本身，所以这里不返回错误
+ *
+ * @param[in]       q:事件队列
+ * @param[in]		dir:debugfs目录，随目录一起删除
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_evq_debugfs(drv_evq_t *q, struct dentry *dir)
+{
+	if (!IS_ERR_OR_NULL(dir))
+	{
+		debugfs_create_file("evq", S_IRUGO, dir, q, &drv_evq_fops);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DRV_EVQ_H_ */
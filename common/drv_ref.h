@@ -0,0 +1,143 @@
+/**
+  ******************************************************************************
+  * @file			drv_ref.h
+  * @brief			总线设备状态的引用计数：设备解绑后已打开的文件返回-ENODEV
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-15
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 总线设备可以在文件打开期间解绑，状态不能再用devm分配。probe持有一个引用，
+  * 每个打开的文件持有一个引用，最后一个put时释放状态。remove先注销字符设备，
+  * 再在锁内置dead，之后的文件操作在drv_ref_enter中返回-ENODEV，不再访问总线设备：
+  *
+  *	open:    drv_ref_get(&dev->ref);                      release: drv_ref_put(&dev->ref, free);
+  *	read:    ret = drv_ref_enter(&dev->ref); if (ret) return ret; ... drv_ref_leave(&dev->ref);
+  *	remove:  drv_chrdev_del(&dev->chrdev); drv_ref_kill(&dev->ref); drv_ref_put(&dev->ref, free);
+  *
+  * 状态是静态变量时(如17、18的platform LED驱动)不需要get/put，只用enter/leave和kill
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DRV_REF_H_
+#define __DRV_REF_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/errno.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/types.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 引用计数和解绑标志，嵌入驱动的状态结构体中
+*/
+typedef struct {
+	struct kref kref;		/*!< probe和每个打开的文件各持有一个引用 */
+	struct mutex lock;		/*!< 串行化文件操作，保护dead */
+	bool dead;				/*!< 总线设备已解绑 */
+}drv_ref_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           初始化，调用者持有第一个引用
+ *
+ * @param[in]       r:引用计数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_ref_init(drv_ref_t *r)
+{
+	kref_init(&r->kref);
+	mutex_init(&r->lock);
+	r->dead = false;
+}
+
+/**=============================================================================
+ * @brief           增加一个引用，在open中调用
+ *
+ * @param[in]       r:引用计数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_ref_get(drv_ref_t *r)
+{
+	kref_get(&r->kref);
+}
+
+/**=============================================================================
+ * @brief           释放一个引用，最后一个引用释放时调用release
+ *
+ * @param[in]       r:引用计数
+ * @param[in]		release:释放状态，参数为r->kref
+ *
+ * @return          1:状态已释放;0:还有其他引用
+ *============================================================================*/
+static inline int drv_ref_put(drv_ref_t *r, void (*release)(struct kref *kref))
+{
+	return kref_put(&r->kref, release);
+}
+
+/**=============================================================================
+ * @brief           开始一次访问总线设备的操作，成功后必须调用drv_ref_leave
+ *
+ * @param[in]       r:引用计数
+ *
+ * @return          0:成功，持有锁;-ERESTARTSYS:被信号打断;-ENODEV:设备已解绑
+ *============================================================================*/
+static inline int drv_ref_enter(drv_ref_t *r)
+{
+	if (mutex_lock_interruptible(&r->lock))
+	{
+		return -ERESTARTSYS;
+	}
+
+	if (r->dead)
+	{
+		mutex_unlock(&r->lock);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           结束drv_ref_enter开始的操作
+ *
+ * @param[in]       r:引用计数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_ref_leave(drv_ref_t *r)
+{
+	mutex_unlock(&r->lock);
+}
+
+/**=============================================================================
+ * @brief           标记设备已解绑，在remove中调用
+ *
+ * 返回时正在进行的操作已经结束，之后的操作都返回-ENODEV
+ *
+ * @param[in]       r:引用计数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void drv_ref_kill(drv_ref_t *r)
+{
+	mutex_lock(&r->lock);
+	r->dead = true;
+	mutex_unlock(&r->lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DRV_REF_H_ */
@@ -0,0 +1,315 @@
+/**
+  ******************************************************************************
+  * @file			gpio_pattern.h
+  * @brief			GPIO波形序列器，一次下发多个(状态,时长)步骤由内核定时播放
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-27
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __GPIO_PATTERN_H_
+#define __GPIO_PATTERN_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define GPIO_PATTERN_MAX_STEPS		256		/*!< 一个波形最多的步骤数 */
+#define GPIO_PATTERN_MIN_STEP_US	50		/*!< 单步最短时长 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 波形中的一步
+*/
+struct gpio_pattern_step {
+	__u32 state;			/*!< 1:打开;0:关闭 */
+	__u32 duration_us;		/*!< 保持时间，us */
+};
+
+/**
+* @brief 波形
+*/
+struct gpio_pattern {
+	__u32 count;			/*!< 步骤数 */
+	__u32 repeat;			/*!< 重复次数，0为一直循环 */
+	__u64 steps;			/*!< 用户空间struct gpio_pattern_step数组地址 */
+};
+
+/* Exported macros -----------------------------------------------------------*/
+#define GPIO_PATTERN_PLAY	_IOW(0xEE, 0x10, struct gpio_pattern)	/*!< 下发并播放波形 */
+#define GPIO_PATTERN_STOP	_IO(0xEE, 0x11)							/*!< 停止播放 */
+
+#ifdef __KERNEL__
+
+#include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+/**
+* @brief 波形序列器，GPIO低电平有效
+*
+* 不经gpiolib驱动的输出(如直接写DR的LED组)用gpio_pattern_set_output
+* 指定输出函数，该函数在定时器回调(硬中断)中调用，不能睡眠
+*/
+typedef struct gpio_pattern_s {
+	struct hrtimer timer;	/*!< 高精度定时器 */
+	spinlock_t lock;		/*!< 保护波形数据 */
+	struct mutex ctrl;		/*!< 串行化停止和下发，保证同一时刻只有一个波形 */
+	int gpio;				/*!< GPIO编号 */
+	void (*output)(struct gpio_pattern_s *pat, u32 on);	/*!< 输出函数，NULL时写gpio */
+	void *priv;				/*!< 输出函数的私有数据 */
+	struct gpio_pattern_step *steps;	/*!< 内核中的波形 */
+	u32 count;				/*!< 步骤数 */
+	u32 repeat;				/*!< 重复次数 */
+	u32 index;				/*!< 下一步 */
+	u32 loops;				/*!< 已播放次数 */
+}gpio_pattern_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           设置输出状态
+ *
+ * @param[in]       pat:序列器
+ * @param[in]		on:1:打开;0:关闭
+ *
+ * @return          none
+ *============================================================================*/
+static inline void gpio_pattern_output(gpio_pattern_t *pat, u32 on)
+{
+	if (pat->output)
+	{
+		pat->output(pat, on);
+	}
+	else
+	{
+		gpio_set_value(pat->gpio, !on);	/*!< 低电平有效 */
+	}
+}
+
+/**=============================================================================
+ * @brief           序列器定时器回调，执行下一步
+ *
+ * @param[in]       timer:到期的定时器
+ *
+ * @return          HRTIMER_RESTART:继续;HRTIMER_NORESTART:播放结束
+ *============================================================================*/
+static inline enum hrtimer_restart gpio_pattern_callback(struct hrtimer *timer)
+{
+	gpio_pattern_t *pat = container_of(timer, gpio_pattern_t, timer);
+	struct gpio_pattern_step *step = NULL;
+	u32 duration_us = 0;
+
+	spin_lock(&pat->lock);
+	if (pat->index >= pat->count)	/*!< 一遍结束 */
+	{
+		pat->index = 0;
+		pat->loops++;
+		if (pat->repeat && (pat->loops >= pat->repeat))
+		{
+			gpio_pattern_output(pat, 0);	/*!< 结束后关闭 */
+			spin_unlock(&pat->lock);
+			return HRTIMER_NORESTART;
+		}
+	}
+
+	step = &pat->steps[pat->index++];
+	gpio_pattern_output(pat, step->state);
+	duration_us = step->duration_us;
+	spin_unlock(&pat->lock);
+
+	/* 以上一步的到期点为基准，整个波形不累计误差 */
+	hrtimer_forward_now(timer, ns_to_ktime((u64)duration_us * NSEC_PER_USEC));
+
+	return HRTIMER_RESTART;
+}
+
+/**=============================================================================
+ * @brief           初始化序列器
+ *
+ * @param[in]       pat:序列器
+ * @param[in]		gpio:GPIO编号
+ *
+ * @return          none
+ *============================================================================*/
+static inline void gpio_pattern_init(gpio_pattern_t *pat, int gpio)
+{
+	memset(pat, 0, sizeof(*pat));
+	spin_lock_init(&pat->lock);
+	mutex_init(&pat->ctrl);
+	hrtimer_init(&pat->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	pat->timer.function = gpio_pattern_callback;
+	pat->gpio = gpio;
+}
+
+/**=============================================================================
+ * @brief           指定输出函数，在gpio_pattern_init之后、开始播放之前调用
+ *
+ * @param[in]       pat:序列器
+ * @param[in]		output:输出函数，在定时器回调中调用
+ * @param[in]		priv:输出函数的私有数据
+ *
+ * @return          none
+ *============================================================================*/
+static inline void gpio_pattern_set_output(gpio_pattern_t *pat,
+								void (*output)(gpio_pattern_t *pat, u32 on), void *priv)
+{
+	pat->output = output;
+	pat->priv = priv;
+}
+
+/**=============================================================================
+ * @brief           停止播放并释放波形，调用者持有pat->ctrl
+ *
+ * 定时器回调只取pat->lock，这里在ctrl下取消定时器不会死锁
+ *
+ * @param[in]       pat:序列器
+ *
+ * @return          none
+ *============================================================================*/
+static inline void __gpio_pattern_stop(gpio_pattern_t *pat)
+{
+	unsigned long flags;
+	struct gpio_pattern_step *steps = NULL;
+
+	hrtimer_cancel(&pat->timer);
+
+	spin_lock_irqsave(&pat->lock, flags);
+	steps = pat->steps;
+	pat->steps = NULL;
+	pat->count = 0;
+	spin_unlock_irqrestore(&pat->lock, flags);
+
+	kfree(steps);
+}
+
+/**=============================================================================
+ * @brief           停止播放并释放波形，之后由调用者直接控制GPIO
+ *
+ * @param[in]       pat:序列器
+ *
+ * @return          none
+ *============================================================================*/
+static inline void gpio_pattern_stop(gpio_pattern_t *pat)
+{
+	mutex_lock(&pat->ctrl);
+	__gpio_pattern_stop(pat);
+	mutex_unlock(&pat->ctrl);
+}
+
+/**=============================================================================
+ * @brief           从用户空间下发波形并开始播放
+ *
+ * 拷贝和检查在锁外完成；停止旧波形、装入新波形和启动定时器在ctrl内完成，
+ * 并发的PLAY依次生效，旧波形都会被释放
+ *
+ * @param[in]       pat:序列器
+ * @param[in]		uarg:用户空间struct gpio_pattern地址
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int gpio_pattern_play(gpio_pattern_t *pat, const void __user *uarg)
+{
+	u32 i = 0;
+	unsigned long flags;
+	struct gpio_pattern desc;
+	struct gpio_pattern_step *steps = NULL;
+
+	if (copy_from_user(&desc, uarg, sizeof(desc)))
+	{
+		return -EFAULT;
+	}
+
+	if ((desc.count == 0) || (desc.count > GPIO_PATTERN_MAX_STEPS))
+	{
+		return -EINVAL;
+	}
+
+	steps = kmalloc_array(desc.count, sizeof(*steps), GFP_KERNEL);
+	if (steps == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	if (copy_from_user(steps, (const void __user *)(unsigned long)desc.steps,
+						desc.count * sizeof(*steps)))
+	{
+		kfree(steps);
+		return -EFAULT;
+	}
+
+	for (i = 0; i < desc.count; i++)
+	{
+		if (steps[i].duration_us < GPIO_PATTERN_MIN_STEP_US)
+		{
+			kfree(steps);
+			return -EINVAL;
+		}
+	}
+
+	mutex_lock(&pat->ctrl);
+	__gpio_pattern_stop(pat);
+
+	spin_lock_irqsave(&pat->lock, flags);
+	pat->steps = steps;
+	pat->count = desc.count;
+	pat->repeat = desc.repeat;
+	pat->index = 0;
+	pat->loops = 0;
+	spin_unlock_irqrestore(&pat->lock, flags);
+
+	hrtimer_start(&pat->timer, ktime_set(0, 0), HRTIMER_MODE_REL);
+	mutex_unlock(&pat->ctrl);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           序列器相关的ioctl处理
+ *
+ * @param[in]       pat:序列器
+ * @param[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;-ENOTTY:不是序列器命令;其他:失败
+ *============================================================================*/
+static inline long gpio_pattern_ioctl(gpio_pattern_t *pat, unsigned int cmd, unsigned long arg)
+{
+	switch (cmd)
+	{
+	case GPIO_PATTERN_PLAY:
+		return gpio_pattern_play(pat, (const void __user *)arg);
+
+	case GPIO_PATTERN_STOP:
+		mutex_lock(&pat->ctrl);
+		__gpio_pattern_stop(pat);
+		gpio_pattern_output(pat, 0);
+		mutex_unlock(&pat->ctrl);
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif /* __KERNEL__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __GPIO_PATTERN_H_ */
@@ -0,0 +1,138 @@
+/**
+  ******************************************************************************
+  * @file			key_state.h
+  * @brief			按键状态页：定时器中更新，mmap给应用程序只读访问
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-24
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 13~16的按键驱动共用，应用程序侧的结构体定义见16_asyncnoti/keystate_app.c
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __KEY_STATE_H_
+#define __KEY_STATE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/compiler.h>
+#include <linux/gfp.h>
+#include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/timekeeping.h>
+#include <linux/types.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 按键状态页，mmap给应用程序只读访问
+*
+* 读者先读seq，为奇数说明正在更新；读完数据后再读seq，前后一致则数据有效
+*/
+typedef struct {
+	u32 seq;				/*!< 序列号，定时器更新前后各加1 */
+	u32 keys;				/*!< 按键状态位图，bit n为1表示KEYn按下 */
+	u32 events;				/*!< 状态变化次数 */
+	u32 reserved;			/*!< 保留 */
+	u64 stamp_ns;			/*!< 最近一次变化的时间(CLOCK_MONOTONIC) */
+}key_state_page_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           申请清零的按键状态页
+ *
+ * @param[in]       none
+ *
+ * @return          状态页;NULL:内存不足
+ *============================================================================*/
+static inline key_state_page_t *key_state_alloc(void)
+{
+	return (key_state_page_t*)get_zeroed_page(GFP_KERNEL);
+}
+
+/**=============================================================================
+ * @brief           释放按键状态页
+ *
+ * @param[in]       state:状态页，可以为NULL
+ *
+ * @return          none
+ *============================================================================*/
+static inline void key_state_free(key_state_page_t *state)
+{
+	free_page((unsigned long)state);
+}
+
+/**=============================================================================
+ * @brief           mmap的实现，把按键状态页只读映射到用户空间
+ *
+ * @param[in]       state:状态页
+ * @param[in]		vma:用户空间虚拟内存区域
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int key_state_mmap(key_state_page_t *state, struct vm_area_struct *vma)
+{
+	if ((vma->vm_pgoff != 0) || (vma->vm_end - vma->vm_start > PAGE_SIZE))
+	{
+		return -EINVAL;
+	}
+
+	if (vma->vm_flags & VM_WRITE)	/*!< 只允许只读映射 */
+	{
+		return -EPERM;
+	}
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_pfn_range(vma, vma->vm_start,
+						virt_to_phys(state) >> PAGE_SHIFT,
+						vma->vm_end - vma->vm_start, vma->vm_page_prot);
+}
+
+/**=============================================================================
+ * @brief           更新按键状态页，只在定时器中调用，只有一个写者
+ *
+ * @param[in]       state:状态页
+ * @param[in]		num:按键号
+ * @param[in]		pressed:是否按下
+ *
+ * @return          none
+ *============================================================================*/
+static inline void key_state_update(key_state_page_t *state, unsigned char num, int pressed)
+{
+	u32 keys = state->keys;
+
+	if (pressed)
+	{
+		keys |= (1U << num);
+	}
+	else
+	{
+		keys &= ~(1U << num);
+	}
+
+	if (keys == state->keys)
+	{
+		return;
+	}
+
+	WRITE_ONCE(state->seq, state->seq + 1);
+	smp_wmb();
+	WRITE_ONCE(state->keys, keys);
+	state->events++;
+	state->stamp_ns = ktime_get_ns();
+	smp_wmb();
+	WRITE_ONCE(state->seq, state->seq + 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __KEY_STATE_H_ */
@@ -0,0 +1,177 @@
+/**
+  ******************************************************************************
+  * @file			led_bank.h
+  * @brief			同一GPIO bank内多个LED的批量更新，一次读-改-写更新全部引脚
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-28
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_BANK_H_
+#define __LED_BANK_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 批量写格式，write()传入8个字节时使用
+*
+* mask中为1的引脚被更新为value中对应位的状态，1为点亮；
+* 传入1个字节时保持原来的格式，非0点亮全部LED，0关闭全部LED
+*/
+struct led_bank_cmd {
+	__u32 mask;				/*!< 要更新的引脚，bit n对应GPIOx_IOn */
+	__u32 value;			/*!< 引脚状态，1为点亮 */
+};
+
+#ifdef __KERNEL__
+
+#include <linux/io.h>
+#include <linux/printk.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+/**
+* @brief 一个GPIO bank中的LED组，LED低电平点亮
+*
+* 更新时不读DR，由shadow改出要写的值：pins中的位是上次写入的值，其他位是
+* 初始化时读到的值。GPIO1_DR中还有别的驱动使用的引脚(如ICM20608的片选
+* GPIO1_IO20)，它们在初始化之后会变化时要打开verify，每次写前回读DR取其他位
+*/
+typedef struct {
+	void __iomem *dr;		/*!< GPIOx_DR映射地址 */
+	spinlock_t lock;		/*!< 保护shadow和DR写 */
+	u32 pins;				/*!< 本驱动管理的引脚 */
+	u32 shadow;				/*!< 上次写入DR的值 */
+	bool verify;			/*!< 写前回读DR：检查pins中的位是否被别人改过，其他位取DR中的值 */
+	unsigned long mismatch;	/*!< 校验失败次数 */
+}led_bank_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           初始化LED组
+ *
+ * @param[in]       bank:LED组
+ * @param[in]		dr:GPIOx_DR映射地址
+ * @param[in]		pins:管理的引脚
+ * @param[in]		verify:每次写前回读DR，同一bank有别的驱动翻转引脚或调试时使用
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_bank_init(led_bank_t *bank, void __iomem *dr, u32 pins, bool verify)
+{
+	spin_lock_init(&bank->lock);
+	bank->dr = dr;
+	bank->pins = pins;
+	bank->verify = verify;
+	bank->mismatch = 0;
+	bank->shadow = readl(dr);	/*!< 唯一一次读DR，pins以外的位以后保持这个值 */
+}
+
+/**=============================================================================
+ * @brief           一次寄存器写更新多个LED
+ *
+ * I.MX6ULL的GPIO没有DR置位/清零别名寄存器，在shadow上只改mask中的位后写回，
+ * 一次writel更新所有LED，不经外设总线读DR。
+ * 打开verify时先在锁内读DR：pins中的位和上次写入的值不同就计数，pins以外的位
+ * 取读到的值，同一bank其他驱动的引脚不会被写回旧值。gpiolib对同一bank的写用的
+ * 是它自己的锁，两边的读-改-写之间仍有很短的窗口，所以LED引脚和gpiolib引脚
+ * 同时高频翻转的场合应把LED放到单独的bank
+ *
+ * @param[in]       bank:LED组
+ * @param[in]		mask:要更新的引脚
+ * @param[in]		value:引脚状态，1为点亮
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_bank_update(led_bank_t *bank, u32 mask, u32 value)
+{
+	u32 val = 0;
+	unsigned long flags;
+
+	mask &= bank->pins;
+	if (mask == 0)
+	{
+		return;
+	}
+
+	spin_lock_irqsave(&bank->lock, flags);
+	val = bank->shadow;
+
+	if (unlikely(bank->verify))
+	{
+		u32 dr = readl(bank->dr);
+
+		if ((dr & bank->pins) != (val & bank->pins))
+		{
+			bank->mismatch++;
+			printk_ratelimited(KERN_WARNING "led_bank: DR %#x, expected %#x in %#x\n",
+								dr & bank->pins, val & bank->pins, bank->pins);
+		}
+		val = (val & bank->pins) | (dr & ~bank->pins);
+	}
+
+	val &= ~mask;
+	val |= (~value & mask);	/*!< 低电平点亮 */
+	writel(val, bank->dr);
+	bank->shadow = val;
+	spin_unlock_irqrestore(&bank->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           解析write()数据并更新LED
+ *
+ * @param[in]       bank:LED组
+ * @param[in]		buf:用户空间数据
+ * @param[in]		cnt:数据长度，1字节或sizeof(struct led_bank_cmd)
+ *
+ * @return          写入的字节数;如果为负值则写入失败
+ *============================================================================*/
+static inline ssize_t led_bank_write(led_bank_t *bank, const char __user *buf, size_t cnt)
+{
+	u8 on = 0;
+	struct led_bank_cmd cmd;
+
+	if (cnt == sizeof(cmd))
+	{
+		if (copy_from_user(&cmd, buf, sizeof(cmd)))
+		{
+			return -EFAULT;
+		}
+	}
+	else if (cnt == sizeof(on))
+	{
+		if (copy_from_user(&on, buf, sizeof(on)))
+		{
+			return -EFAULT;
+		}
+		cmd.mask = bank->pins;
+		cmd.value = on ? bank->pins : 0;
+	}
+	else
+	{
+		return -EINVAL;
+	}
+
+	led_bank_update(bank, cmd.mask, cmd.value);
+
+	return cnt;
+}
+
+#endif /* __KERNEL__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __LED_BANK_H_ */
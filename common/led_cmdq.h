@@ -0,0 +1,252 @@
+/**
+  ******************************************************************************
+  * @file			led_cmdq.h
+  * @brief			LED/蜂鸣器异步命令队列，write()只入队，由工作队列写GPIO
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-02
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_CMDQ_H_
+#define __LED_CMDQ_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include "led_trace.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define LED_CMDQ_LEN		16		/*!< 队列长度，必须是2的幂 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 一条排队的命令
+*/
+typedef struct {
+	u8 value;				/*!< 开关值 */
+	u32 tag;				/*!< 入队者附带的标记，原样交给执行函数 */
+	u64 stamp_ns;			/*!< 入队时间 */
+}led_cmd_t;
+
+typedef struct led_cmdq led_cmdq_t;
+
+/**
+* @brief 在工作队列中执行一条命令，可以睡眠
+*
+* 执行时写者已经返回，不再持有它当时的锁，需要的话由执行函数自己加锁，
+* 并用tag判断命令入队之后设备的归属是否变化(见led_lease_current)
+*/
+typedef void (*led_cmd_apply_t)(led_cmdq_t *q, u8 value, u32 tag);
+
+/**
+* @brief 有界命令队列，满时write()等待或返回-EAGAIN，poll()报告POLLOUT
+*/
+struct led_cmdq {
+	spinlock_t lock;		/*!< 保护队列 */
+	struct work_struct work;	/*!< 取出并执行命令 */
+	wait_queue_head_t wait;	/*!< 等待队列有空位 */
+	led_cmd_apply_t apply;	/*!< 驱动的执行函数 */
+	const char *name;		/*!< 设备名，用于tracepoint */
+	led_cmd_t ring[LED_CMDQ_LEN];	/*!< 命令环形缓冲 */
+	u32 head;				/*!< 写入位置，自由增长 */
+	u32 tail;				/*!< 读出位置，自由增长 */
+};
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           队列空位数，调用者持有lock
+ *
+ * @param[in]       q:命令队列
+ *
+ * @return          空位数
+ *============================================================================*/
+static inline u32 led_cmdq_room(led_cmdq_t *q)
+{
+	return LED_CMDQ_LEN - (q->head - q->tail);
+}
+
+/**=============================================================================
+ * @brief           工作函数，按顺序执行队列中的全部命令
+ *
+ * @param[in]       work:work_struct
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_cmdq_work(struct work_struct *work)
+{
+	led_cmdq_t *q = container_of(work, led_cmdq_t, work);
+	led_cmd_t cmd;
+	unsigned long flags;
+
+	while (1)
+	{
+		spin_lock_irqsave(&q->lock, flags);
+		if (q->head == q->tail)
+		{
+			spin_unlock_irqrestore(&q->lock, flags);
+			break;
+		}
+		cmd = q->ring[q->tail++ & (LED_CMDQ_LEN - 1)];
+		spin_unlock_irqrestore(&q->lock, flags);
+
+		wake_up_interruptible_poll(&q->wait, POLLOUT | POLLWRNORM);
+
+		trace_led_cmd_apply(q->name, cmd.value, ktime_get_ns() - cmd.stamp_ns);
+		q->apply(q, cmd.value, cmd.tag);
+	}
+}
+
+/**=============================================================================
+ * @brief           初始化命令队列
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		name:设备名
+ * @param[in]		apply:执行函数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_cmdq_init(led_cmdq_t *q, const char *name, led_cmd_apply_t apply)
+{
+	memset(q, 0, sizeof(*q));
+	spin_lock_init(&q->lock);
+	INIT_WORK(&q->work, led_cmdq_work);
+	init_waitqueue_head(&q->wait);
+	q->apply = apply;
+	q->name = name;
+}
+
+/**=============================================================================
+ * @brief           等待队列有空位
+ *
+ * 写者要在自己的锁内入队时，用nonblock入队，-EAGAIN时放开锁调用本函数再重试，
+ * 执行函数会拿同一把锁，不能持锁等待
+ *
+ * @param[in]       q:命令队列
+ *
+ * @return          0:有空位;-ERESTARTSYS:被信号打断
+ *============================================================================*/
+static inline int led_cmdq_wait(led_cmdq_t *q)
+{
+	return wait_event_interruptible(q->wait, READ_ONCE(q->head) - READ_ONCE(q->tail) < LED_CMDQ_LEN);
+}
+
+/**=============================================================================
+ * @brief           命令入队，立即返回
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		value:开关值
+ * @param[in]		tag:交给执行函数的标记，不需要时为0
+ * @param[in]		nonblock:队列满时不等待，返回-EAGAIN
+ *
+ * @return          0:成功;-EAGAIN:队列满;-ERESTARTSYS:被信号打断
+ *============================================================================*/
+static inline int led_cmdq_push(led_cmdq_t *q, u8 value, u32 tag, bool nonblock)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&q->lock, flags);
+	while (led_cmdq_room(q) == 0)
+	{
+		spin_unlock_irqrestore(&q->lock, flags);
+		if (nonblock)
+		{
+			return -EAGAIN;
+		}
+		if (led_cmdq_wait(q))
+		{
+			return -ERESTARTSYS;
+		}
+		spin_lock_irqsave(&q->lock, flags);
+	}
+
+	q->ring[q->head & (LED_CMDQ_LEN - 1)].value = value;
+	q->ring[q->head & (LED_CMDQ_LEN - 1)].tag = tag;
+	q->ring[q->head & (LED_CMDQ_LEN - 1)].stamp_ns = ktime_get_ns();
+	q->head++;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	schedule_work(&q->work);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           poll处理，队列有空位时可写
+ *
+ * @param[in]       q:命令队列
+ * @param[in]		filp:设备文件
+ * @param[in]		wait:poll_table
+ *
+ * @return          POLLOUT|POLLWRNORM:可写;0:队列满
+ *============================================================================*/
+static inline unsigned int led_cmdq_poll(led_cmdq_t *q, struct file *filp, struct poll_table_struct *wait)
+{
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(filp, &q->wait, wait);
+
+	spin_lock_irqsave(&q->lock, flags);
+	if (led_cmdq_room(q))
+	{
+		mask |= POLLOUT | POLLWRNORM;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	return mask;
+}
+
+/**=============================================================================
+ * @brief           等待已入队的命令全部执行完，PWM等直接操作GPIO的命令前调用以保持顺序
+ *
+ * 执行函数会加锁时，调用者不能持有同一把锁
+ *
+ * @param[in]       q:命令队列
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_cmdq_flush(led_cmdq_t *q)
+{
+	flush_work(&q->work);
+}
+
+/**=============================================================================
+ * @brief           丢弃未执行的命令并停止工作，卸载驱动时调用
+ *
+ * @param[in]       q:命令队列
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_cmdq_exit(led_cmdq_t *q)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&q->lock, flags);
+	q->tail = q->head;
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	cancel_work_sync(&q->work);
+	wake_up_interruptible_poll(&q->wait, POLLOUT | POLLWRNORM);	/*!< 等待空位的写者重试后发现设备已注销 */
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __LED_CMDQ_H_ */
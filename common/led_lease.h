@@ -0,0 +1,260 @@
+/**
+  ******************************************************************************
+  * @file			led_lease.h
+  * @brief			LED多进程共享访问：驱动按操作加自己的锁，需要独占时通过ioctl租用
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-30
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_LEASE_H_
+#define __LED_LEASE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported macros -----------------------------------------------------------*/
+#define LED_LEASE_ACQUIRE	_IO(0xEE, 0x20)		/*!< 独占LED，其他打开者的操作等待或返回-EAGAIN */
+#define LED_LEASE_RELEASE	_IO(0xEE, 0x21)		/*!< 释放独占，关闭文件时自动释放 */
+
+#ifdef __KERNEL__
+
+#include <linux/fcntl.h>
+#include <linux/fs.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include "lock_stats.h"
+
+/**
+* @brief 共享访问的租用关系
+*
+* 租用只是归属检查，不串行化操作：每次write()/ioctl()和工作队列执行命令时
+* 由驱动持有自己的锁(自旋锁、信号量、互斥体或原子变量)，在锁内用led_lease_check
+* 确认没有被别的打开者租用，被租用时放开驱动的锁用led_lease_wait等待后重试。
+* write()在检查时取得gen随命令入队，执行时用led_lease_current比较，入队之后
+* 租用发生了变化的命令被丢弃。lock只保护owner和gen，持有时间只有几条指令
+*/
+typedef struct {
+	spinlock_t lock;			/*!< 保护owner和gen */
+	struct file *owner;			/*!< 当前租用者，NULL表示未租用 */
+	u32 gen;					/*!< 租用代数，owner每次变化加1 */
+	wait_queue_head_t wait;		/*!< 等待租用释放 */
+	lock_stats_t stats;			/*!< lock的竞争统计 */
+}led_lease_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           初始化
+ *
+ * @param[in]       lease:租用关系
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_lease_init(led_lease_t *lease)
+{
+	spin_lock_init(&lease->lock);
+	lease->owner = NULL;
+	lease->gen = 0;
+	init_waitqueue_head(&lease->wait);
+	lock_stats_init(&lease->stats);
+}
+
+/**=============================================================================
+ * @brief           获取lock并记录竞争统计，可以在驱动的自旋锁内调用
+ *
+ * @param[in]       lease:租用关系
+ *
+ * @return          关中断前的中断状态，交给led_lease_unlock()恢复
+ *============================================================================*/
+static inline unsigned long led_lease_lock(led_lease_t *lease)
+{
+	unsigned long flags;
+	u64 start = lock_stats_begin();
+	bool contended = !spin_trylock_irqsave(&lease->lock, flags);
+
+	if (contended)
+	{
+		spin_lock_irqsave(&lease->lock, flags);
+	}
+	lock_stats_acquired(&lease->stats, start, contended);
+
+	return flags;
+}
+
+/**=============================================================================
+ * @brief           释放lock并记录持有时间
+ *
+ * @param[in]       lease:租用关系
+ * @param[in]		flags:led_lease_lock()的返回值
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_lease_unlock(led_lease_t *lease, unsigned long flags)
+{
+	lock_stats_released(&lease->stats);
+	spin_unlock_irqrestore(&lease->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           检查filp能否操作LED，不睡眠，在驱动的锁内调用
+ *
+ * @param[in]       lease:租用关系
+ * @param[in]		filp:发起操作的设备文件
+ * @param[out]		gen:当前的租用代数，随命令入队，不需要时为NULL
+ *
+ * @return          0:可以操作;-EBUSY:被别的打开者租用，放开驱动的锁后调用led_lease_wait
+ *============================================================================*/
+static inline int led_lease_check(led_lease_t *lease, struct file *filp, u32 *gen)
+{
+	int ret = -EBUSY;
+	unsigned long flags = led_lease_lock(lease);
+
+	if ((lease->owner == NULL) || (lease->owner == filp))
+	{
+		if (gen)
+		{
+			*gen = lease->gen;
+		}
+		ret = 0;
+	}
+	led_lease_unlock(lease, flags);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           等待别的打开者释放租用，不能持有驱动的锁
+ *
+ * 返回0后租用可能又被别人取得，调用者要在驱动的锁内重新led_lease_check
+ *
+ * @param[in]       lease:租用关系
+ * @param[in]		filp:发起操作的设备文件
+ *
+ * @return          0:已释放;-EAGAIN:非阻塞;-ERESTARTSYS:被信号打断
+ *============================================================================*/
+static inline int led_lease_wait(led_lease_t *lease, struct file *filp)
+{
+	if (filp->f_flags & O_NONBLOCK)
+	{
+		return -EAGAIN;
+	}
+
+	return wait_event_interruptible(lease->wait,
+			(READ_ONCE(lease->owner) == NULL) || (READ_ONCE(lease->owner) == filp));
+}
+
+/**=============================================================================
+ * @brief           工作队列执行命令前调用：确认入队后租用没有变化
+ *
+ * @param[in]       lease:租用关系
+ * @param[in]		gen:入队时led_lease_check取得的租用代数
+ *
+ * @return          true:可以执行;false:租用已变化，命令应丢弃
+ *============================================================================*/
+static inline bool led_lease_current(led_lease_t *lease, u32 gen)
+{
+	bool cur = false;
+	unsigned long flags = led_lease_lock(lease);
+
+	cur = (lease->gen == gen);
+	led_lease_unlock(lease, flags);
+
+	return cur;
+}
+
+/**=============================================================================
+ * @brief           关闭文件时释放它持有的租用
+ *
+ * @param[in]       lease:租用关系
+ * @param[in]		filp:关闭的设备文件
+ *
+ * @return          0:成功;-EPERM:该文件没有租用
+ *============================================================================*/
+static inline int led_lease_release(led_lease_t *lease, struct file *filp)
+{
+	int ret = -EPERM;
+	unsigned long flags = led_lease_lock(lease);
+
+	if (lease->owner == filp)
+	{
+		lease->owner = NULL;
+		lease->gen++;
+		ret = 0;
+	}
+	led_lease_unlock(lease, flags);
+
+	if (ret == 0)
+	{
+		wake_up_interruptible_all(&lease->wait);
+	}
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           租用相关的ioctl处理，不需要持有驱动的锁
+ *
+ * 取得租用时已经通过检查的其他操作仍会完成，之后开始的操作都等待租用释放
+ *
+ * @param[in]       lease:租用关系
+ * @param[in]		filp:设备文件
+ * @param[in]		cmd:命令
+ *
+ * @return          0:成功;-ENOTTY:不是租用命令;其他:失败
+ *============================================================================*/
+static inline long led_lease_ioctl(led_lease_t *lease, struct file *filp, unsigned int cmd)
+{
+	int ret = 0;
+	unsigned long flags;
+
+	switch (cmd)
+	{
+	case LED_LEASE_ACQUIRE:
+		while (1)
+		{
+			flags = led_lease_lock(lease);
+			if ((lease->owner == NULL) || (lease->owner == filp))
+			{
+				if (lease->owner != filp)
+				{
+					lease->owner = filp;
+					lease->gen++;
+				}
+				led_lease_unlock(lease, flags);
+				return 0;
+			}
+			led_lease_unlock(lease, flags);
+
+			ret = led_lease_wait(lease, filp);
+			if (ret)
+			{
+				return ret;
+			}
+		}
+
+	case LED_LEASE_RELEASE:
+		return led_lease_release(lease, filp);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif /* __KERNEL__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __LED_LEASE_H_ */
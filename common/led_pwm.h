@@ -0,0 +1,269 @@
+/**
+  ******************************************************************************
+  * @file			led_pwm.h
+  * @brief			GPIO LED软件PWM，hrtimer驱动
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-26
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_PWM_H_
+#define __LED_PWM_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define LED_PWM_DUTY_MAX		1000		/*!< 占空比满量程，千分比 */
+#define LED_PWM_MIN_PERIOD_US	100			/*!< 最小周期，即最高10kHz */
+#define LED_PWM_MAX_PERIOD_US	4000000		/*!< 最大周期4s，亮灭时间以u32 ns保存 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief PWM配置，一次ioctl同时更新周期和占空比
+*/
+struct led_pwm_cfg {
+	__u32 period_us;		/*!< 周期，us，0为关闭PWM回到开关模式 */
+	__u32 duty;				/*!< 亮的占空比，0~LED_PWM_DUTY_MAX */
+};
+
+/* Exported macros -----------------------------------------------------------*/
+#define LED_PWM_SET		_IOW(0xEE, 0x1, struct led_pwm_cfg)	/*!< 设置PWM */
+#define LED_PWM_GET		_IOR(0xEE, 0x2, struct led_pwm_cfg)	/*!< 读取PWM */
+
+#ifdef __KERNEL__
+
+#include <linux/gpio.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+/**
+* @brief 软件PWM引擎，LED低电平点亮
+*/
+typedef struct {
+	struct hrtimer timer;	/*!< 高精度定时器 */
+	struct mutex ctrl;		/*!< 串行化配置和停止，只在进程上下文中使用 */
+	spinlock_t lock;		/*!< 保护配置，与定时器回调互斥 */
+	int gpio;				/*!< LED的GPIO编号 */
+	int level;				/*!< 当前是否点亮 */
+	u32 on_ns;				/*!< 点亮时间 */
+	u32 off_ns;				/*!< 熄灭时间 */
+	struct led_pwm_cfg cfg;	/*!< 当前配置 */
+}led_pwm_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           PWM定时器回调，在亮灭两段之间切换
+ *
+ * @param[in]       timer:到期的定时器
+ *
+ * @return          HRTIMER_RESTART:继续运行
+ *============================================================================*/
+static inline enum hrtimer_restart led_pwm_callback(struct hrtimer *timer)
+{
+	led_pwm_t *pwm = container_of(timer, led_pwm_t, timer);
+	u32 next_ns = 0;
+
+	spin_lock(&pwm->lock);
+	pwm->level = !pwm->level;
+	gpio_set_value(pwm->gpio, !pwm->level);
+	next_ns = pwm->level ? pwm->on_ns : pwm->off_ns;
+	spin_unlock(&pwm->lock);
+
+	/* 以上次到期点为基准，周期不随回调延迟漂移 */
+	hrtimer_forward_now(timer, ns_to_ktime(next_ns));
+
+	return HRTIMER_RESTART;
+}
+
+/**=============================================================================
+ * @brief           初始化PWM引擎
+ *
+ * @param[in]       pwm:PWM引擎
+ * @param[in]		gpio:LED的GPIO编号
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_pwm_init(led_pwm_t *pwm, int gpio)
+{
+	memset(pwm, 0, sizeof(*pwm));
+	mutex_init(&pwm->ctrl);
+	spin_lock_init(&pwm->lock);
+	hrtimer_init(&pwm->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	pwm->timer.function = led_pwm_callback;
+	pwm->gpio = gpio;
+}
+
+/**=============================================================================
+ * @brief           停止PWM，调用者持有ctrl
+ *
+ * @param[in]       pwm:PWM引擎
+ *
+ * @return          none
+ *============================================================================*/
+static inline void __led_pwm_stop(led_pwm_t *pwm)
+{
+	unsigned long flags;
+
+	hrtimer_cancel(&pwm->timer);
+
+	spin_lock_irqsave(&pwm->lock, flags);
+	pwm->cfg.period_us = 0;
+	pwm->cfg.duty = 0;
+	spin_unlock_irqrestore(&pwm->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           停止PWM，之后由调用者直接控制GPIO
+ *
+ * @param[in]       pwm:PWM引擎
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_pwm_stop(led_pwm_t *pwm)
+{
+	mutex_lock(&pwm->ctrl);
+	__led_pwm_stop(pwm);
+	mutex_unlock(&pwm->ctrl);
+}
+
+/**=============================================================================
+ * @brief           应用PWM配置，调用者持有ctrl
+ *
+ * ctrl保证没有并发的stop/apply，定时器只会被回调重新启动，不会自行停止，
+ * 所以在lock中判断的运行状态到hrtimer_start之前不会改变
+ *
+ * @param[in]       pwm:PWM引擎
+ * @param[in]		cfg:新配置
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int __led_pwm_apply(led_pwm_t *pwm, const struct led_pwm_cfg *cfg)
+{
+	unsigned long flags;
+	u64 period_ns = (u64)cfg->period_us * NSEC_PER_USEC;
+	int running = 0;
+
+	if (cfg->duty > LED_PWM_DUTY_MAX)
+	{
+		return -EINVAL;
+	}
+
+	if (cfg->period_us == 0)
+	{
+		__led_pwm_stop(pwm);
+		return 0;
+	}
+
+	if ((cfg->period_us < LED_PWM_MIN_PERIOD_US) || (cfg->period_us > LED_PWM_MAX_PERIOD_US))
+	{
+		return -EINVAL;
+	}
+
+	/* 0%和100%不需要定时器 */
+	if ((cfg->duty == 0) || (cfg->duty == LED_PWM_DUTY_MAX))
+	{
+		hrtimer_cancel(&pwm->timer);
+		spin_lock_irqsave(&pwm->lock, flags);
+		pwm->cfg = *cfg;
+		pwm->level = (cfg->duty != 0);
+		gpio_set_value(pwm->gpio, !pwm->level);
+		spin_unlock_irqrestore(&pwm->lock, flags);
+		return 0;
+	}
+
+	spin_lock_irqsave(&pwm->lock, flags);
+	pwm->cfg = *cfg;
+	pwm->on_ns = div_u64(period_ns * cfg->duty, LED_PWM_DUTY_MAX);
+	pwm->off_ns = period_ns - pwm->on_ns;
+	running = hrtimer_active(&pwm->timer);
+	spin_unlock_irqrestore(&pwm->lock, flags);
+
+	/* 已经在运行时在下一个边沿自然切换到新参数，不打断当前周期 */
+	if (!running)
+	{
+		hrtimer_start(&pwm->timer, ktime_set(0, 0), HRTIMER_MODE_REL);
+	}
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           应用PWM配置
+ *
+ * @param[in]       pwm:PWM引擎
+ * @param[in]		cfg:新配置
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static inline int led_pwm_apply(led_pwm_t *pwm, const struct led_pwm_cfg *cfg)
+{
+	int ret = 0;
+
+	mutex_lock(&pwm->ctrl);
+	ret = __led_pwm_apply(pwm, cfg);
+	mutex_unlock(&pwm->ctrl);
+
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           PWM相关的ioctl处理
+ *
+ * @param[in]       pwm:PWM引擎
+ * @param[in]		cmd:命令
+ * @param[in]		arg:参数
+ *
+ * @return          0:成功;-ENOTTY:不是PWM命令;其他:失败
+ *============================================================================*/
+static inline long led_pwm_ioctl(led_pwm_t *pwm, unsigned int cmd, unsigned long arg)
+{
+	struct led_pwm_cfg cfg;
+	unsigned long flags;
+
+	switch (cmd)
+	{
+	case LED_PWM_SET:
+		if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg)))
+		{
+			return -EFAULT;
+		}
+		return led_pwm_apply(pwm, &cfg);
+
+	case LED_PWM_GET:
+		spin_lock_irqsave(&pwm->lock, flags);
+		cfg = pwm->cfg;
+		spin_unlock_irqrestore(&pwm->lock, flags);
+		if (copy_to_user((void __user *)arg, &cfg, sizeof(cfg)))
+		{
+			return -EFAULT;
+		}
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+#endif /* __KERNEL__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __LED_PWM_H_ */
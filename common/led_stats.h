@@ -0,0 +1,227 @@
+/**
+  ******************************************************************************
+  * @file			led_stats.h
+  * @brief			LED/蜂鸣器驱动write()路径的内核侧计数，通过debugfs导出
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-29
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LED_STATS_H_
+#define __LED_STATS_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define LED_STATS_BUCKETS		24		/*!< 耗时直方图桶数，按2的幂划分ns */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief write()路径计数，在/sys/kernel/debug/<驱动名>/stats中查看，写入任意内容清零
+*/
+typedef struct {
+	struct dentry *dir;		/*!< debugfs目录，其他调试文件也可以放在这里 */
+	spinlock_t lock;		/*!< 保护计数 */
+	u64 writes;				/*!< write()次数 */
+	u64 errors;				/*!< 失败次数 */
+	u64 total_ns;			/*!< 累计耗时 */
+	u64 min_ns;				/*!< 最短耗时 */
+	u64 max_ns;				/*!< 最长耗时 */
+	unsigned long hist[LED_STATS_BUCKETS];	/*!< 耗时直方图 */
+}led_stats_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           清零计数
+ *
+ * @param[in]       stats:计数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_stats_reset(led_stats_t *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->writes = 0;
+	stats->errors = 0;
+	stats->total_ns = 0;
+	stats->min_ns = U64_MAX;
+	stats->max_ns = 0;
+	memset(stats->hist, 0, sizeof(stats->hist));
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           write()开始，记录时间戳
+ *
+ * @param[in]       none
+ *
+ * @return          开始时间
+ *============================================================================*/
+static inline u64 led_stats_begin(void)
+{
+	return ktime_get_ns();
+}
+
+/**=============================================================================
+ * @brief           write()结束，累加一次调用
+ *
+ * @param[in]       stats:计数
+ * @param[in]		start:led_stats_begin()的返回值
+ * @param[in]		ret:write()的返回值
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_stats_end(led_stats_t *stats, u64 start, ssize_t ret)
+{
+	unsigned long flags;
+	u64 ns = ktime_get_ns() - start;
+	int bucket = ns ? min_t(int, ilog2(ns), LED_STATS_BUCKETS - 1) : 0;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->writes++;
+	if (ret < 0)
+	{
+		stats->errors++;
+	}
+	stats->total_ns += ns;
+	if (ns < stats->min_ns)
+	{
+		stats->min_ns = ns;
+	}
+	if (ns > stats->max_ns)
+	{
+		stats->max_ns = ns;
+	}
+	stats->hist[bucket]++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           debugfs stats文件输出
+ *
+ * @param[in]       m:seq_file
+ * @param[in]		v:未使用
+ *
+ * @return          0:成功
+ *============================================================================*/
+static inline int led_stats_show(struct seq_file *m, void *v)
+{
+	int i = 0;
+	unsigned long flags;
+	led_stats_t *stats = m->private;
+	led_stats_t snap;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	snap = *stats;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	seq_printf(m, "writes:   %llu\n", snap.writes);
+	seq_printf(m, "errors:   %llu\n", snap.errors);
+	seq_printf(m, "total_ns: %llu\n", snap.total_ns);
+	seq_printf(m, "avg_ns:   %llu\n", snap.writes ? div64_u64(snap.total_ns, snap.writes) : 0);
+	seq_printf(m, "min_ns:   %llu\n", snap.writes ? snap.min_ns : 0);
+	seq_printf(m, "max_ns:   %llu\n", snap.max_ns);
+	for (i = 0; i < LED_STATS_BUCKETS; i++)
+	{
+		if (snap.hist[i])
+		{
+			seq_printf(m, "[%10lu, %10lu)ns %lu\n",
+						i ? (1UL << i) : 0UL, 1UL << (i + 1), snap.hist[i]);
+		}
+	}
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           debugfs stats文件打开
+ *============================================================================*/
+static inline int led_stats_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, led_stats_show, inode->i_private);
+}
+
+/**=============================================================================
+ * @brief           debugfs stats文件写入，任意内容都清零计数
+ *============================================================================*/
+static inline ssize_t led_stats_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
+{
+	struct seq_file *m = filp->private_data;
+
+	led_stats_reset(m->private);
+
+	return cnt;
+}
+
+static const struct file_operations led_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = led_stats_open,
+	.read = seq_read,
+	.write = led_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**=============================================================================
+ * @brief           初始化计数并创建debugfs文件
+ *
+ * debugfs不可用时只是看不到计数，不影响驱动本身，所以这里不返回错误
+ *
+ * @param[in]       stats:计数
+ * @param[in]		name:debugfs目录名，一般为驱动名
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_stats_init(led_stats_t *stats, const char *name)
+{
+	memset(stats, 0, sizeof(*stats));
+	spin_lock_init(&stats->lock);
+	stats->min_ns = U64_MAX;
+
+	stats->dir = debugfs_create_dir(name, NULL);
+	if (IS_ERR_OR_NULL(stats->dir))
+	{
+		stats->dir = NULL;
+		return;
+	}
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, stats->dir, stats, &led_stats_fops);
+}
+
+/**=============================================================================
+ * @brief           删除debugfs文件
+ *
+ * @param[in]       stats:计数
+ *
+ * @return          none
+ *============================================================================*/
+static inline void led_stats_exit(led_stats_t *stats)
+{
+	debugfs_remove_recursive(stats->dir);
+	stats->dir = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __LED_STATS_H_ */
@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file			led_trace.h
+  * @brief			LED/蜂鸣器驱动的tracepoint，代替每次write()的printk
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-02
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 驱动中只能有一个源文件在包含本文件前定义CREATE_TRACE_POINTS，
+  * Makefile中需要加上ccflags-y += -I$(src)/../common。
+  * 使用：echo 1 > /sys/kernel/debug/tracing/events/led/enable
+  ******************************************************************************
+**/
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM led
+
+#if !defined(__LED_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define __LED_TRACE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/tracepoint.h>
+
+/* Exported events -----------------------------------------------------------*/
+/**
+* @brief write()收到一个开关值
+*/
+TRACE_EVENT(led_write,
+	TP_PROTO(const char *name, u8 value),
+	TP_ARGS(name, value),
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(u8, value)
+	),
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->value = value;
+	),
+	TP_printk("%s value=%u", __get_str(name), __entry->value)
+);
+
+/**
+* @brief 工作队列把排队的开关值写到GPIO
+*/
+TRACE_EVENT(led_cmd_apply,
+	TP_PROTO(const char *name, u8 value, u64 delay_ns),
+	TP_ARGS(name, value, delay_ns),
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(u8, value)
+		__field(u64, delay_ns)
+	),
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->value = value;
+		__entry->delay_ns = delay_ns;
+	),
+	TP_printk("%s value=%u delay=%lluns", __get_str(name), __entry->value,
+				(unsigned long long)__entry->delay_ns)
+);
+
+#endif /* __LED_TRACE_H_ */
+
+/* 以下必须在保护宏之外 */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE led_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,275 @@
+/**
+  ******************************************************************************
+  * @file			lock_stats.h
+  * @brief			锁竞争统计：获取次数、竞争次数、等待和持有时间，通过debugfs导出
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-05-31
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LOCK_STATS_H_
+#define __LOCK_STATS_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define LOCK_STATS_BUCKETS		32		/*!< 直方图桶数，按2的幂划分ns，最大约4s */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+* @brief 一把互斥类锁的统计，持锁期间只有一个持有者，所以只记录一个持有起点
+*
+* 调用顺序：lock_stats_begin() -> 获取锁 -> lock_stats_acquired() ->
+* 临界区 -> lock_stats_released() -> 释放锁
+*/
+typedef struct {
+	spinlock_t lock;		/*!< 保护计数，读debugfs时取一致的快照 */
+	u64 acquired;			/*!< 获取次数 */
+	u64 contended;			/*!< 第一次尝试没有拿到锁的次数 */
+	u64 wait_total_ns;		/*!< 累计等待时间 */
+	u64 wait_max_ns;		/*!< 最长等待时间 */
+	u64 hold_total_ns;		/*!< 累计持有时间 */
+	u64 hold_max_ns;		/*!< 最长持有时间 */
+	u64 hold_start;			/*!< 当前持有者拿到锁的时间 */
+	unsigned long wait_hist[LOCK_STATS_BUCKETS];	/*!< 竞争时的等待时间直方图 */
+	unsigned long hold_hist[LOCK_STATS_BUCKETS];	/*!< 持有时间直方图 */
+}lock_stats_t;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**=============================================================================
+ * @brief           ns换算为直方图桶
+ *
+ * @param[in]       ns:时间
+ *
+ * @return          桶序号
+ *============================================================================*/
+static inline int lock_stats_bucket(u64 ns)
+{
+	return ns ? min_t(int, ilog2(ns), LOCK_STATS_BUCKETS - 1) : 0;
+}
+
+/**=============================================================================
+ * @brief           清零统计
+ *
+ * @param[in]       st:统计
+ *
+ * @return          none
+ *============================================================================*/
+static inline void lock_stats_reset(lock_stats_t *st)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->lock, flags);
+	st->acquired = 0;
+	st->contended = 0;
+	st->wait_total_ns = 0;
+	st->wait_max_ns = 0;
+	st->hold_total_ns = 0;
+	st->hold_max_ns = 0;
+	memset(st->wait_hist, 0, sizeof(st->wait_hist));
+	memset(st->hold_hist, 0, sizeof(st->hold_hist));
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           开始获取锁，记录时间戳
+ *
+ * @param[in]       none
+ *
+ * @return          开始时间
+ *============================================================================*/
+static inline u64 lock_stats_begin(void)
+{
+	return ktime_get_ns();
+}
+
+/**=============================================================================
+ * @brief           已拿到锁，记录等待时间
+ *
+ * @param[in]       st:统计
+ * @param[in]		start:lock_stats_begin()的返回值
+ * @param[in]		contended:第一次trylock是否失败
+ *
+ * @return          none
+ *============================================================================*/
+static inline void lock_stats_acquired(lock_stats_t *st, u64 start, bool contended)
+{
+	unsigned long flags;
+	u64 now = ktime_get_ns();
+	u64 wait = now - start;
+
+	spin_lock_irqsave(&st->lock, flags);
+	st->acquired++;
+	st->hold_start = now;
+	if (contended)
+	{
+		st->contended++;
+		st->wait_total_ns += wait;
+		if (wait > st->wait_max_ns)
+		{
+			st->wait_max_ns = wait;
+		}
+		st->wait_hist[lock_stats_bucket(wait)]++;
+	}
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           即将释放锁，记录持有时间
+ *
+ * @param[in]       st:统计
+ *
+ * @return          none
+ *============================================================================*/
+static inline void lock_stats_released(lock_stats_t *st)
+{
+	unsigned long flags;
+	u64 hold = 0;
+
+	spin_lock_irqsave(&st->lock, flags);
+	hold = ktime_get_ns() - st->hold_start;
+	st->hold_total_ns += hold;
+	if (hold > st->hold_max_ns)
+	{
+		st->hold_max_ns = hold;
+	}
+	st->hold_hist[lock_stats_bucket(hold)]++;
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
+/**=============================================================================
+ * @brief           输出一个直方图
+ *
+ * @param[in]       m:seq_file
+ * @param[in]		name:直方图名称
+ * @param[in]		hist:直方图
+ *
+ * @return          none
+ *============================================================================*/
+static inline void lock_stats_show_hist(struct seq_file *m, const char *name, const unsigned long *hist)
+{
+	int i = 0;
+
+	seq_printf(m, "%s:\n", name);
+	for (i = 0; i < LOCK_STATS_BUCKETS; i++)
+	{
+		if (hist[i])
+		{
+			seq_printf(m, "  [%10lu, %10lu)ns %lu\n",
+						i ? (1UL << i) : 0UL, (i < 31) ? (1UL << (i + 1)) : ~0UL, hist[i]);
+		}
+	}
+}
+
+/**=============================================================================
+ * @brief           debugfs文件输出
+ *
+ * @param[in]       m:seq_file
+ * @param[in]		v:未使用
+ *
+ * @return          0:成功
+ *============================================================================*/
+static inline int lock_stats_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	lock_stats_t *st = m->private;
+	lock_stats_t snap;
+
+	spin_lock_irqsave(&st->lock, flags);
+	snap = *st;
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	seq_printf(m, "acquired:      %llu\n", snap.acquired);
+	seq_printf(m, "contended:     %llu\n", snap.contended);
+	seq_printf(m, "wait_avg_ns:   %llu\n", snap.contended ? div64_u64(snap.wait_total_ns, snap.contended) : 0);
+	seq_printf(m, "wait_max_ns:   %llu\n", snap.wait_max_ns);
+	seq_printf(m, "hold_avg_ns:   %llu\n", snap.acquired ? div64_u64(snap.hold_total_ns, snap.acquired) : 0);
+	seq_printf(m, "hold_max_ns:   %llu\n", snap.hold_max_ns);
+	lock_stats_show_hist(m, "wait", snap.wait_hist);
+	lock_stats_show_hist(m, "hold", snap.hold_hist);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           debugfs文件打开
+ *============================================================================*/
+static inline int lock_stats_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, lock_stats_show, inode->i_private);
+}
+
+/**=============================================================================
+ * @brief           debugfs文件写入，任意内容都清零统计
+ *============================================================================*/
+static inline ssize_t lock_stats_write(struct file *filp, const char __user *buf, size_t cnt, loff_t *offt)
+{
+	struct seq_file *m = filp->private_data;
+
+	lock_stats_reset(m->private);
+
+	return cnt;
+}
+
+static const struct file_operations lock_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = lock_stats_open,
+	.read = seq_read,
+	.write = lock_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**=============================================================================
+ * @brief           初始化统计
+ *
+ * @param[in]       st:统计
+ *
+ * @return          none
+ *============================================================================*/
+static inline void lock_stats_init(lock_stats_t *st)
+{
+	memset(st, 0, sizeof(*st));
+	spin_lock_init(&st->lock);
+}
+
+/**=============================================================================
+ * @brief           在debugfs目录下创建统计文件，随目录一起删除
+ *
+ * @param[in]       st:统计
+ * @param[in]		name:文件名
+ * @param[in]		dir:debugfs目录，为NULL时不创建
+ *
+ * @return          none
+ *============================================================================*/
+static inline void lock_stats_debugfs(lock_stats_t *st, const char *name, struct dentry *dir)
+{
+	if (dir)
+	{
+		debugfs_create_file(name, S_IRUGO | S_IWUSR, dir, st, &lock_stats_fops);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __LOCK_STATS_H_ */
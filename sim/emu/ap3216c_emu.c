@@ -0,0 +1,420 @@
+/**
+  ******************************************************************************
+  * @file			ap3216c_emu.c
+  * @brief			AP3216C模拟器，注册一个虚拟I2C适配器，0x1E上挂"xli,ap3216c"
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-09
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 按ap3216c.h中的寄存器响应读写，SYSTEMCONG选择工作模式，
+  * 每个转换周期更新一次IR/ALS/PS数据寄存器，超出阈值时置位INTSTATUS，
+  * INTCLEAR为0时读数据寄存器清中断，为1时向INTSTATUS写1清中断。
+  * 第n次转换：ir = (n * 16) & 0x3FF，als = (u16)(n * step)，ps = (n * 8) & 0x3FF，
+  * ir >= 0x3F0时IR_OF置位，ps超过PS上限时OBJ置位
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/errno.h>
+#include <linux/i2c.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#include "ap3216c.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define EMU_NAME				"ap3216c-emu"	/*!< 适配器名 */
+#define EMU_REG_NUM				0x40			/*!< 寄存器个数 */
+
+#define MODE_MASK				0x07			/*!< SYSTEMCONG */
+#define MODE_DOWN				0x00
+#define MODE_ALS				0x01
+#define MODE_PS_IR				0x02
+#define MODE_ALL				0x03
+#define MODE_RESET				0x04
+#define MODE_ONCE				0x04			/*!< 5~7为单次模式 */
+#define INT_ALS					0x01			/*!< INTSTATUS */
+#define INT_PS					0x02
+#define INTCLEAR_MANUAL			0x01			/*!< INTCLEAR，1:写1清除 */
+#define IR_OF					0x80			/*!< IRDATALOW */
+#define PS_IR_OF				0x40			/*!< PSDATALOW */
+#define PS_OBJ					0x80			/*!< PSDATAHIGH */
+
+#define ALS_THRES_L				0x1A			/*!< ALS下限低字节，0x1B为高字节 */
+#define ALS_THRES_H				0x1C			/*!< ALS上限低字节，0x1D为高字节 */
+#define PS_THRES_L				0x2A			/*!< PS下限低2位，0x2B为高8位 */
+#define PS_THRES_H				0x2C			/*!< PS上限低2位，0x2D为高8位 */
+
+/* Private macro -------------------------------------------------------------*/
+#define REG16(emu, r)			((u16)(emu)->regs[(r) + 1] << 8 | (emu)->regs[r])
+#define REG10(emu, r)			((u16)(emu)->regs[(r) + 1] << 2 | ((emu)->regs[r] & 0x03))
+
+/* Private typedef -----------------------------------------------------------*/
+/* 模拟器状态，传输由I2C核心的总线锁串行化，不需要另外加锁 */
+typedef struct {
+	struct i2c_adapter adap;		/*!< 虚拟I2C适配器 */
+	struct i2c_client *client;		/*!< 0x1E上的AP3216C */
+	struct dentry *dir;				/*!< debugfs目录 */
+	u8 regs[EMU_REG_NUM];			/*!< 寄存器 */
+	u8 addr;						/*!< 当前寄存器地址 */
+	u8 mode;						/*!< 计时所用的工作模式 */
+	u32 period_ns;					/*!< 计时所用的转换周期 */
+	u64 t0;							/*!< 转换时钟起点，ns */
+	u64 due;						/*!< 自t0以来已完成的转换数 */
+	u64 n;							/*!< 下一次转换的序号，决定波形 */
+	bool fresh;						/*!< 最近一次转换的数据还没有被读过 */
+	u64 conversions;				/*!< 统计：完成的转换数 */
+	u64 missed;						/*!< 统计：没被读过就被覆盖的转换数 */
+}ap3216c_emu_t;
+
+/* Private variables ---------------------------------------------------------*/
+static ap3216c_emu_t ap_emu;
+
+static uint odr = 0;	/*!< 转换频率，0表示按模式取手册中的转换时间 */
+module_param(odr, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(odr, "conversion rate in Hz, 0 = datasheet timing of the selected mode");
+
+static uint step = 256;	/*!< 相邻两次转换ALS的增量 */
+module_param(step, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(step, "per-conversion increment of the synthetic ALS ramp");
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           复位寄存器，阈值复位为不产生中断
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_reset(ap3216c_emu_t *emu)
+{
+	memset(emu->regs, 0, sizeof(emu->regs));
+	emu->regs[ALS_THRES_H] = 0xFF;
+	emu->regs[ALS_THRES_H + 1] = 0xFF;
+	emu->regs[PS_THRES_H] = 0x03;
+	emu->regs[PS_THRES_H + 1] = 0xFF;
+	emu->fresh = false;
+}
+
+/**=============================================================================
+ * @brief           模式对应的转换周期
+ *
+ * @param[in]       mode:工作模式
+ *
+ * @return          周期，ns;0:不转换
+ *============================================================================*/
+static u32 emu_period(u8 mode)
+{
+	if (odr)
+	{
+		return NSEC_PER_SEC / odr;
+	}
+
+	switch (mode & ~MODE_ONCE)
+	{
+	case MODE_ALS:		return 100000000;	/*!< ALS 100ms */
+	case MODE_PS_IR:	return 12500000;	/*!< PS+IR 12.5ms */
+	case MODE_ALL:		return 112500000;	/*!< ALS+PS+IR 112.5ms */
+	default:			return 0;
+	}
+}
+
+/**=============================================================================
+ * @brief           完成一次转换：更新数据寄存器和中断状态
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_convert(ap3216c_emu_t *emu)
+{
+	u8 mode = emu->mode & ~MODE_ONCE;
+	u16 ir = (emu->n * 16) & 0x3FF;
+	u16 als = (u16)(emu->n * step);
+	u16 ps = (emu->n * 8) & 0x3FF;
+	u8 of = (ir >= 0x3F0) ? IR_OF : 0;
+
+	if (mode & MODE_ALS)
+	{
+		emu->regs[AP3216C_ALSDATALOW] = als & 0xFF;
+		emu->regs[AP3216C_ALSDATAHIGH] = als >> 8;
+		if ((als < REG16(emu, ALS_THRES_L)) || (als > REG16(emu, ALS_THRES_H)))
+		{
+			emu->regs[AP3216C_INTSTATUS] |= INT_ALS;
+		}
+	}
+	if (mode & MODE_PS_IR)
+	{
+		emu->regs[AP3216C_IRDATALOW] = of | (ir & 0x03);
+		emu->regs[AP3216C_IRDATAHIGH] = ir >> 2;
+		emu->regs[AP3216C_PSDATALOW] = (of ? PS_IR_OF : 0) | (ps & 0x0F);
+		emu->regs[AP3216C_PSDATAHIGH] = ((ps > REG10(emu, PS_THRES_H)) ? PS_OBJ : 0) | (ps >> 4);
+		if ((ps < REG10(emu, PS_THRES_L)) || (ps > REG10(emu, PS_THRES_H)))
+		{
+			emu->regs[AP3216C_INTSTATUS] |= INT_PS;
+		}
+	}
+
+	emu->n++;
+	emu->conversions++;
+}
+
+/**=============================================================================
+ * @brief           补齐从上次访问到现在应完成的转换
+ *
+ * 只有最后一次转换的数据可见，之前的都计入missed
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_sync(ap3216c_emu_t *emu)
+{
+	u64 now = ktime_get_ns();
+	u8 mode = emu->regs[AP3216C_SYSTEMCONG] & MODE_MASK;
+	u32 period = emu_period(mode);
+	u64 due = 0;
+	u64 cnt = 0;
+
+	/* 模式或周期变化时重新计时 */
+	if ((mode != emu->mode) || (period != emu->period_ns))
+	{
+		emu->mode = mode;
+		emu->period_ns = period;
+		emu->t0 = now;
+		emu->due = 0;
+		return;
+	}
+	if (period == 0)
+	{
+		return;
+	}
+
+	due = div64_u64(now - emu->t0, period);
+	cnt = due - emu->due;
+	emu->due = due;
+	if (cnt == 0)
+	{
+		return;
+	}
+
+	/* 单次模式转换一次后回到掉电 */
+	if (mode & MODE_ONCE)
+	{
+		cnt = 1;
+		emu->regs[AP3216C_SYSTEMCONG] &= ~MODE_MASK;
+	}
+
+	emu->missed += cnt - 1 + (emu->fresh ? 1 : 0);
+	emu->conversions += cnt - 1;
+	emu->n += cnt - 1;
+	emu_convert(emu);
+	emu->fresh = true;
+}
+
+/**=============================================================================
+ * @brief           读一个寄存器，地址自增
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          寄存器值
+ *============================================================================*/
+static u8 emu_read(ap3216c_emu_t *emu)
+{
+	u8 reg = emu->addr;
+	u8 val = emu->regs[reg];
+	bool auto_clear = !(emu->regs[AP3216C_INTCLEAR] & INTCLEAR_MANUAL);
+
+	switch (reg)
+	{
+	case AP3216C_IRDATALOW ... AP3216C_IRDATAHIGH:
+		emu->fresh = false;
+		break;
+	case AP3216C_ALSDATALOW ... AP3216C_ALSDATAHIGH:
+		emu->fresh = false;
+		if (auto_clear)
+		{
+			emu->regs[AP3216C_INTSTATUS] &= ~INT_ALS;
+		}
+		break;
+	case AP3216C_PSDATALOW ... AP3216C_PSDATAHIGH:
+		emu->fresh = false;
+		if (auto_clear)
+		{
+			emu->regs[AP3216C_INTSTATUS] &= ~INT_PS;
+		}
+		break;
+	default:
+		break;
+	}
+	emu->addr = (reg + 1) % EMU_REG_NUM;
+
+	return val;
+}
+
+/**=============================================================================
+ * @brief           写一个寄存器，地址自增
+ *
+ * @param[in]       emu:模拟器
+ * @param[in]		val:写入值
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_write(ap3216c_emu_t *emu, u8 val)
+{
+	u8 reg = emu->addr;
+
+	switch (reg)
+	{
+	case AP3216C_SYSTEMCONG:
+		if ((val & MODE_MASK) == MODE_RESET)	/*!< 软件复位，完成后为掉电模式 */
+		{
+			emu_reset(emu);
+			break;
+		}
+		emu->regs[reg] = val & MODE_MASK;
+		break;
+	case AP3216C_INTSTATUS:
+		if (emu->regs[AP3216C_INTCLEAR] & INTCLEAR_MANUAL)
+		{
+			emu->regs[reg] &= ~val;
+		}
+		break;
+	case AP3216C_IRDATALOW ... AP3216C_PSDATAHIGH:
+		break;
+	default:
+		emu->regs[reg] = val;
+		break;
+	}
+	emu->addr = (reg + 1) % EMU_REG_NUM;
+}
+
+/**=============================================================================
+ * @brief           I2C传输，写消息的第一个字节为寄存器地址
+ *
+ * @param[in]       adap:适配器
+ * @param[in]		msgs:消息
+ * @param[in]		num:消息个数
+ *
+ * @return          完成的消息数;-ENXIO:地址上没有设备
+ *============================================================================*/
+static int emu_xfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+	ap3216c_emu_t *emu = i2c_get_adapdata(adap);
+	int i = 0;
+	int j = 0;
+
+	emu_sync(emu);
+
+	for (i = 0; i < num; i++)
+	{
+		if (msgs[i].addr != AP3216C_ADDR)
+		{
+			return -ENXIO;
+		}
+
+		if (msgs[i].flags & I2C_M_RD)
+		{
+			for (j = 0; j < msgs[i].len; j++)
+			{
+				msgs[i].buf[j] = emu_read(emu);
+			}
+		}
+		else if (msgs[i].len)
+		{
+			emu->addr = msgs[i].buf[0] % EMU_REG_NUM;
+			for (j = 1; j < msgs[i].len; j++)
+			{
+				emu_write(emu, msgs[i].buf[j]);
+			}
+		}
+	}
+
+	return num;
+}
+
+/**=============================================================================
+ * @brief           适配器功能，SMBus由核心用I2C消息模拟
+ *
+ * @param[in]       adap:适配器
+ *
+ * @return          功能位
+ *============================================================================*/
+static u32 emu_functionality(struct i2c_adapter *adap)
+{
+	return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm emu_algo = {
+	.master_xfer = emu_xfer,
+	.functionality = emu_functionality,
+};
+
+/**=============================================================================
+ * @brief           模块入口函数
+ *
+ * @param[in]       none
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int __init ap3216c_emu_init(void)
+{
+	int ret = 0;
+	struct i2c_board_info info = {
+		I2C_BOARD_INFO("xli,ap3216c", AP3216C_ADDR),
+	};
+
+	emu_reset(&ap_emu);
+	ap_emu.adap.owner = THIS_MODULE;
+	ap_emu.adap.algo = &emu_algo;
+	strlcpy(ap_emu.adap.name, EMU_NAME, sizeof(ap_emu.adap.name));
+	i2c_set_adapdata(&ap_emu.adap, &ap_emu);
+
+	ret = i2c_add_adapter(&ap_emu.adap);
+	if (ret < 0)
+	{
+		return ret;
+	}
+
+	ap_emu.client = i2c_new_device(&ap_emu.adap, &info);
+	if (ap_emu.client == NULL)
+	{
+		i2c_del_adapter(&ap_emu.adap);
+		return -ENODEV;
+	}
+
+	ap_emu.dir = debugfs_create_dir(EMU_NAME, NULL);
+	debugfs_create_u64("conversions", S_IRUGO, ap_emu.dir, &ap_emu.conversions);
+	debugfs_create_u64("missed", S_IRUGO, ap_emu.dir, &ap_emu.missed);
+
+	printk("ap3216c emulator on i2c-%d\r\n", ap_emu.adap.nr);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           模块出口函数
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void __exit ap3216c_emu_exit(void)
+{
+	debugfs_remove_recursive(ap_emu.dir);
+	i2c_unregister_device(ap_emu.client);
+	i2c_del_adapter(&ap_emu.adap);
+}
+
+module_init(ap3216c_emu_init);
+module_exit(ap3216c_emu_exit);
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("xieli");
@@ -0,0 +1,458 @@
+/**
+  ******************************************************************************
+  * @file			icm20608_emu.c
+  * @brief			ICM20608模拟器，注册一个虚拟SPI控制器，片选0上挂"xli,icm20608"
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-09
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 按icm20608.h中的寄存器响应读写，采样按ODR随时间产生，访问时补齐：
+  * 数据寄存器为最新一次采样，INT_STATUS读清，FIFO 512字节，
+  * FIFO_COUNT/FIFO_R_W可读出，满时按CONFIG.FIFO_MODE覆盖最旧或丢弃新数据，
+  * 并置位FIFO_OFLOW_INT。
+  * 第n次采样的第k个通道(按寄存器顺序ax ay az temp gx gy gz)为
+  * (s16)(n * step + k * 0x2000)，读者可据此校验丢样和乱序
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/errno.h>
+#include <linux/platform_device.h>
+#include <linux/spi/spi.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#include "icm20608.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define EMU_NAME				"icm20608-emu"	/*!< 平台设备名 */
+#define EMU_FIFO_SIZE			512				/*!< FIFO字节数 */
+#define EMU_REG_NUM				128				/*!< 寄存器个数 */
+#define EMU_CHANNELS			7				/*!< ax ay az temp gx gy gz */
+
+#define PWR1_DEVICE_RESET		0x80			/*!< PWR_MGMT_1 */
+#define PWR1_SLEEP				0x40
+#define USER_FIFO_EN			0x40			/*!< USER_CTRL */
+#define USER_FIFO_RST			0x04
+#define CONFIG_FIFO_MODE		0x40			/*!< CONFIG，1:满时丢弃新数据 */
+#define FIFO_EN_TEMP			0x80			/*!< FIFO_EN */
+#define FIFO_EN_XG				0x40
+#define FIFO_EN_YG				0x20
+#define FIFO_EN_ZG				0x10
+#define FIFO_EN_ACCEL			0x08
+#define INT_FIFO_OFLOW			0x10			/*!< INT_STATUS */
+#define INT_DATA_RDY			0x01
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* 模拟器状态，消息由SPI核心逐条串行处理，不需要加锁 */
+typedef struct {
+	struct platform_device *pdev;	/*!< 控制器的父设备 */
+	struct spi_master *master;		/*!< 虚拟SPI控制器 */
+	struct spi_device *spi;			/*!< 片选0上的ICM20608 */
+	struct dentry *dir;				/*!< debugfs目录 */
+	u8 regs[EMU_REG_NUM];			/*!< 寄存器 */
+	u8 addr;						/*!< 当前寄存器地址 */
+	bool read;						/*!< 当前为读操作 */
+	bool addr_phase;				/*!< 下一个字节为地址 */
+	u8 fifo[EMU_FIFO_SIZE];			/*!< FIFO */
+	u32 fifo_out;					/*!< FIFO读位置 */
+	u32 fifo_len;					/*!< FIFO字节数 */
+	u32 rate;						/*!< 当前采样率，Hz */
+	u64 t0;							/*!< 采样时钟起点，ns */
+	u64 due;						/*!< 自t0以来已处理的采样数 */
+	u64 n;							/*!< 下一个采样的序号，决定波形 */
+	u64 samples;					/*!< 统计：产生的采样数 */
+	u64 fifo_dropped;				/*!< 统计：FIFO满丢掉的字节数 */
+	u64 skipped;					/*!< 统计：长时间未访问，追赶时直接跳过的采样数 */
+}icm20608_emu_t;
+
+/* Private variables ---------------------------------------------------------*/
+static icm20608_emu_t *icm_emu;
+
+static uint odr = 0;	/*!< 采样率，0表示按SMPLRT_DIV计算1000/(1+div) */
+module_param(odr, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(odr, "sample rate in Hz, 0 = 1000 / (1 + SMPLRT_DIV)");
+
+static uint step = 64;	/*!< 相邻采样的增量 */
+module_param(step, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(step, "per-sample increment of the synthetic ramp");
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           复位寄存器和FIFO
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_reset(icm20608_emu_t *emu)
+{
+	memset(emu->regs, 0, sizeof(emu->regs));
+	emu->regs[ICM20_PWR_MGMT_1] = PWR1_SLEEP;
+	emu->regs[ICM20_WHO_AM_I] = ICM20608G_ID;
+	emu->fifo_out = 0;
+	emu->fifo_len = 0;
+	emu->t0 = ktime_get_ns();
+	emu->due = 0;
+}
+
+/**=============================================================================
+ * @brief           写入一个字节到FIFO
+ *
+ * @param[in]       emu:模拟器
+ * @param[in]		val:数据
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_fifo_put(icm20608_emu_t *emu, u8 val)
+{
+	if (emu->fifo_len == EMU_FIFO_SIZE)
+	{
+		emu->regs[ICM20_INT_STATUS] |= INT_FIFO_OFLOW;
+		emu->fifo_dropped++;
+		if (emu->regs[ICM20_CONFIG] & CONFIG_FIFO_MODE)
+		{
+			return;
+		}
+		emu->fifo_out = (emu->fifo_out + 1) % EMU_FIFO_SIZE;
+		emu->fifo_len--;
+	}
+	emu->fifo[(emu->fifo_out + emu->fifo_len) % EMU_FIFO_SIZE] = val;
+	emu->fifo_len++;
+}
+
+/**=============================================================================
+ * @brief           产生一次采样：更新数据寄存器，按FIFO_EN写入FIFO
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_sample(icm20608_emu_t *emu)
+{
+	/* FIFO_EN中每个通道对应的位，顺序与数据寄存器一致 */
+	static const u8 fifo_bit[EMU_CHANNELS] = {
+		FIFO_EN_ACCEL, FIFO_EN_ACCEL, FIFO_EN_ACCEL, FIFO_EN_TEMP,
+		FIFO_EN_XG, FIFO_EN_YG, FIFO_EN_ZG,
+	};
+	bool to_fifo = (emu->regs[ICM20_USER_CTRL] & USER_FIFO_EN) != 0;
+	u8 *out = &emu->regs[ICM20_ACCEL_XOUT_H];
+	s16 val = 0;
+	int k = 0;
+
+	for (k = 0; k < EMU_CHANNELS; k++)
+	{
+		val = (s16)(emu->n * step + k * 0x2000);
+		out[2 * k] = (u16)val >> 8;
+		out[2 * k + 1] = (u16)val & 0xFF;
+		if (to_fifo && (emu->regs[ICM20_FIFO_EN] & fifo_bit[k]))
+		{
+			emu_fifo_put(emu, out[2 * k]);
+			emu_fifo_put(emu, out[2 * k + 1]);
+		}
+	}
+	emu->regs[ICM20_INT_STATUS] |= INT_DATA_RDY;
+	emu->n++;
+	emu->samples++;
+}
+
+/**=============================================================================
+ * @brief           补齐从上次访问到现在应产生的采样
+ *
+ * 长时间没有访问时，比FIFO能容纳的更早的采样不会被看到，直接跳过，
+ * 只计入skipped，波形序号照常前进
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_sync(icm20608_emu_t *emu)
+{
+	u64 now = ktime_get_ns();
+	u32 rate = odr ? odr : 1000u / (1 + emu->regs[ICM20_SMPLRT_DIV]);
+	u64 due = 0;
+	u64 cnt = 0;
+
+	/* 休眠时不采样，采样率变化时重新计时 */
+	if ((emu->regs[ICM20_PWR_MGMT_1] & PWR1_SLEEP) || (rate != emu->rate))
+	{
+		emu->rate = rate;
+		emu->t0 = now;
+		emu->due = 0;
+		return;
+	}
+
+	due = div64_u64((now - emu->t0) * rate, NSEC_PER_SEC);
+	cnt = due - emu->due;
+	emu->due = due;
+	if (cnt > EMU_FIFO_SIZE / 2 + 1)	/*!< 每个采样至少2字节 */
+	{
+		emu->skipped += cnt - (EMU_FIFO_SIZE / 2 + 1);
+		emu->n += cnt - (EMU_FIFO_SIZE / 2 + 1);
+		cnt = EMU_FIFO_SIZE / 2 + 1;
+	}
+	while (cnt--)
+	{
+		emu_sample(emu);
+	}
+}
+
+/**=============================================================================
+ * @brief           读一个寄存器，FIFO_R_W地址不自增
+ *
+ * @param[in]       emu:模拟器
+ *
+ * @return          寄存器值
+ *============================================================================*/
+static u8 emu_read(icm20608_emu_t *emu)
+{
+	u8 reg = emu->addr;
+	u8 val = emu->regs[reg];
+
+	switch (reg)
+	{
+	case ICM20_FIFO_R_W:
+		if (emu->fifo_len)
+		{
+			val = emu->fifo[emu->fifo_out];
+			emu->fifo_out = (emu->fifo_out + 1) % EMU_FIFO_SIZE;
+			emu->fifo_len--;
+		}
+		return val;
+	case ICM20_FIFO_COUNTH:
+		val = emu->fifo_len >> 8;
+		break;
+	case ICM20_FIFO_COUNTL:
+		val = emu->fifo_len & 0xFF;
+		break;
+	case ICM20_INT_STATUS:
+		emu->regs[reg] = 0;		/*!< 读清 */
+		break;
+	default:
+		break;
+	}
+	emu->addr = (reg + 1) % EMU_REG_NUM;
+
+	return val;
+}
+
+/**=============================================================================
+ * @brief           写一个寄存器，只读寄存器忽略
+ *
+ * @param[in]       emu:模拟器
+ * @param[in]		val:写入值
+ *
+ * @return          none
+ *============================================================================*/
+static void emu_write(icm20608_emu_t *emu, u8 val)
+{
+	u8 reg = emu->addr;
+
+	switch (reg)
+	{
+	case ICM20_PWR_MGMT_1:
+		if (val & PWR1_DEVICE_RESET)
+		{
+			emu_reset(emu);
+			return;
+		}
+		emu->regs[reg] = val;
+		break;
+	case ICM20_USER_CTRL:
+		if (val & USER_FIFO_RST)
+		{
+			emu->fifo_out = 0;
+			emu->fifo_len = 0;
+		}
+		emu->regs[reg] = val & ~USER_FIFO_RST;
+		break;
+	case ICM20_FIFO_R_W:
+		emu_fifo_put(emu, val);
+		return;
+	case ICM20_INT_STATUS:
+	case ICM20_ACCEL_XOUT_H ... ICM20_GYRO_ZOUT_L:
+	case ICM20_FIFO_COUNTH:
+	case ICM20_FIFO_COUNTL:
+	case ICM20_WHO_AM_I:
+		break;
+	default:
+		emu->regs[reg] = val;
+		break;
+	}
+	emu->addr = (reg + 1) % EMU_REG_NUM;
+}
+
+/**=============================================================================
+ * @brief           处理一条SPI消息
+ *
+ * 片选之后第一个字节为地址，BIT7为1表示读。驱动可以在一条消息里连续传输，
+ * 也可以像22_spi那样地址和数据分两条消息(片选由驱动用GPIO保持)，
+ * 所以只含地址的消息之后，下一条消息继续为数据
+ *
+ * @param[in]       master:SPI控制器
+ * @param[in]		msg:消息
+ *
+ * @return          0
+ *============================================================================*/
+static int emu_transfer_one_message(struct spi_master *master, struct spi_message *msg)
+{
+	icm20608_emu_t *emu = spi_master_get_devdata(master);
+	struct spi_transfer *t = NULL;
+	const u8 *tx = NULL;
+	u8 *rx = NULL;
+	unsigned int i = 0;
+	u8 byte = 0;
+	bool addr_only = emu->addr_phase;
+
+	emu_sync(emu);
+
+	list_for_each_entry(t, &msg->transfers, transfer_list)
+	{
+		tx = t->tx_buf;
+		rx = t->rx_buf;
+		for (i = 0; i < t->len; i++)
+		{
+			if (emu->addr_phase)
+			{
+				byte = tx ? tx[i] : 0xFF;
+				emu->addr = byte & 0x7F;
+				emu->read = (byte & 0x80) != 0;
+				emu->addr_phase = false;
+				if (rx)
+				{
+					rx[i] = 0;
+				}
+				continue;
+			}
+
+			addr_only = false;
+			if (emu->read)
+			{
+				if (rx)
+				{
+					rx[i] = emu_read(emu);
+				}
+			}
+			else
+			{
+				emu_write(emu, tx ? tx[i] : 0xFF);
+				if (rx)
+				{
+					rx[i] = 0;
+				}
+			}
+		}
+		msg->actual_length += t->len;
+	}
+
+	emu->addr_phase = !addr_only;
+	msg->status = 0;
+	spi_finalize_current_message(master);
+
+	return 0;
+}
+
+/**=============================================================================
+ * @brief           模块入口函数
+ *
+ * @param[in]       none
+ *
+ * @return          0:成功;其他:失败
+ *============================================================================*/
+static int __init icm20608_emu_init(void)
+{
+	int ret = 0;
+	struct platform_device *pdev = NULL;
+	struct spi_master *master = NULL;
+	struct spi_board_info info = {
+		.modalias = "xli,icm20608",
+		.max_speed_hz = 8000000,
+		.chip_select = 0,
+		.mode = SPI_MODE_0,
+	};
+
+	pdev = platform_device_register_simple(EMU_NAME, -1, NULL, 0);
+	if (IS_ERR(pdev))
+	{
+		return PTR_ERR(pdev);
+	}
+
+	master = spi_alloc_master(&pdev->dev, sizeof(icm20608_emu_t));
+	if (master == NULL)
+	{
+		ret = -ENOMEM;
+		goto fail_master;
+	}
+	master->bus_num = -1;
+	master->num_chipselect = 1;
+	master->mode_bits = SPI_CPOL | SPI_CPHA;
+	master->bits_per_word_mask = SPI_BPW_MASK(8);
+	master->transfer_one_message = emu_transfer_one_message;
+
+	icm_emu = spi_master_get_devdata(master);
+	icm_emu->pdev = pdev;
+	icm_emu->master = master;
+	icm_emu->addr_phase = true;
+	emu_reset(icm_emu);
+
+	ret = spi_register_master(master);
+	if (ret < 0)
+	{
+		spi_master_put(master);
+		goto fail_master;
+	}
+
+	icm_emu->spi = spi_new_device(master, &info);
+	if (icm_emu->spi == NULL)
+	{
+		ret = -ENODEV;
+		goto fail_device;
+	}
+
+	icm_emu->dir = debugfs_create_dir(EMU_NAME, NULL);
+	debugfs_create_u64("samples", S_IRUGO, icm_emu->dir, &icm_emu->samples);
+	debugfs_create_u64("fifo_dropped", S_IRUGO, icm_emu->dir, &icm_emu->fifo_dropped);
+	debugfs_create_u64("skipped", S_IRUGO, icm_emu->dir, &icm_emu->skipped);
+	debugfs_create_u32("fifo_len", S_IRUGO, icm_emu->dir, &icm_emu->fifo_len);
+
+	printk("icm20608 emulator on spi%d.0\r\n", master->bus_num);
+
+	return 0;
+
+fail_device:
+	spi_unregister_master(master);
+fail_master:
+	platform_device_unregister(pdev);
+	return ret;
+}
+
+/**=============================================================================
+ * @brief           模块出口函数
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void __exit icm20608_emu_exit(void)
+{
+	struct platform_device *pdev = icm_emu->pdev;
+
+	debugfs_remove_recursive(icm_emu->dir);
+	spi_unregister_device(icm_emu->spi);
+	spi_unregister_master(icm_emu->master);	/*!< 释放控制器，emu随之释放 */
+	platform_device_unregister(pdev);
+}
+
+module_init(icm20608_emu_init);
+module_exit(icm20608_emu_exit);
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("xieli");
@@ -0,0 +1,214 @@
+#!/bin/sh
+################################################################################
+# @file			selftest.sh
+# @brief		在模拟板(或开发板)上依次加载每个驱动，做功能检查并运行bench
+# @author		Xli
+# @email		xieliyzh@163.com
+# @version		1.0.0
+# @date			2020-06-08
+# @copyright	2020, EVECCA Co.,Ltd. All rights reserved
+#
+# 目录结构与sim.sh生成的rootfs一致：/xli/<模块目录>/下为.ko和应用。
+# LED和蜂鸣器通过devmem读回GPIO数据寄存器检查引脚电平(低电平有效)；
+# 按键引脚在QEMU中无法从外部驱动，只检查加载、设备节点和卸载；
+# AP3216C和ICM20608由sim/emu下的模拟器提供。
+# 每个bench的输出以"BENCH <名称>"开头原样打印，便于和上一次的日志比较
+################################################################################
+
+X=${X:-/xli}
+PASS=0
+FAIL=0
+SKIP=0
+
+GPIO1_DR=0x0209C000		# LED: GPIO1_IO03
+GPIO5_DR=0x020AC000		# BEEP: GPIO5_IO01
+
+pass() { echo "PASS $1"; PASS=$((PASS + 1)); }
+fail() { echo "FAIL $1: $2"; FAIL=$((FAIL + 1)); }
+skip() { echo "SKIP $1: $2"; SKIP=$((SKIP + 1)); }
+
+# 等待$1寄存器的第$2位变为$3，驱动用工作队列写GPIO时不是立即生效
+wait_bit()
+{
+	i=0
+	while [ $i -lt 20 ]; do
+		v=$(devmem $1 32)
+		[ $(( (v >> $2) & 1 )) -eq $3 ] && return 0
+		usleep 50000
+		i=$((i + 1))
+	done
+	return 1
+}
+
+# 加载模块，$1为目录，其余为.ko文件名(不含后缀)
+load()
+{
+	dir=$1; shift
+	for m in "$@"; do
+		insmod "$X/$dir/$m.ko" || return 1
+	done
+}
+
+# 卸载模块，顺序与加载相反
+unload()
+{
+	shift
+	rev=
+	for m in "$@"; do
+		rev="$m $rev"
+	done
+	for m in $rev; do
+		rmmod $m || return 1
+	done
+}
+
+# 写开/关后检查引脚，$1测试名，$2寄存器，$3位，其余为不带0/1参数的应用命令
+check_out()
+{
+	name=$1; reg=$2; bit=$3; shift 3
+	"$@" 1 > /dev/null && wait_bit $reg $bit 0 || { fail $name "on"; return 1; }
+	"$@" 0 > /dev/null && wait_bit $reg $bit 1 || { fail $name "off"; return 1; }
+	pass $name
+}
+
+# 输出类模块：加载、开关检查、卸载
+test_out()
+{
+	name=$1; dev=$2; reg=$3; bit=$4; mods=$5; shift 5
+	load $name $mods || { fail $name "insmod"; return; }
+	if [ -c $dev ]; then
+		check_out $name $reg $bit "$@" $dev
+	else
+		fail $name "no $dev"
+	fi
+	unload $name $mods || fail $name "rmmod"
+}
+
+# 只检查加载、设备节点和卸载
+test_node()
+{
+	name=$1; dev=$2; mods=$3
+	load $name $mods || { fail $name "insmod"; return; }
+	[ -e $dev ] && pass $name || fail $name "no $dev"
+	unload $name $mods || fail $name "rmmod"
+}
+
+# 运行一个bench，返回值非0记为失败
+bench()
+{
+	name=$1; shift
+	echo "BENCH $name: $*"
+	"$@" && pass "bench $name" || fail "bench $name" "exit $?"
+}
+
+#-------------------------------------------------------------------------------
+# 解析和按键状态机的微基准，与驱动使用同一份代码
+#-------------------------------------------------------------------------------
+bench decode $X/bench/decode_rate -n 1000000
+
+#-------------------------------------------------------------------------------
+# 1_chrdevbase：数据通路和吞吐
+#-------------------------------------------------------------------------------
+load 1_chrdevbase chrdevbase
+if [ -c /dev/chrdevbase ]; then
+	bench chrdev_verify $X/bench/chrdev_rate -d /dev/chrdevbase -t 16 -V
+	bench chrdev_read $X/bench/chrdev_rate -d /dev/chrdevbase -t 256 -b 65536
+	bench chrdev_poll $X/bench/chrdev_rate -d /dev/chrdevbase -t 256 -b 4096 -N
+	bench chrdev_splice $X/bench/chrdev_rate -d /dev/chrdevbase -t 256 -b 65536 -S
+else
+	fail 1_chrdevbase "insmod"
+fi
+unload 1_chrdevbase chrdevbase
+
+#-------------------------------------------------------------------------------
+# 2~10、12、17、18：LED
+#-------------------------------------------------------------------------------
+test_out 2_led /dev/led $GPIO1_DR 3 led $X/2_led/app
+test_out 3_newchrled /dev/newchrled $GPIO1_DR 3 newchrled $X/3_newchrled/app
+test_out 4_dtsled /dev/dtsled $GPIO1_DR 3 dtsled $X/4_dtsled/app
+test_out 7_atomic /dev/gpioled $GPIO1_DR 3 atomic $X/7_atomic/atomic_app
+test_out 8_spinlock /dev/gpioled $GPIO1_DR 3 spinlock $X/8_spinlock/spinlock_app
+test_out 9_semaphore /dev/gpioled $GPIO1_DR 3 semaphore $X/9_semaphore/semaphore_app
+test_out 17_platform /dev/platled $GPIO1_DR 3 "led_dev led_drv" $X/17_platform/led_app
+test_out 18_dtsplatform /dev/dtsplatled $GPIO1_DR 3 led_drv $X/18_dtsplatform/led_app
+
+load 5_gpioled gpioled
+if [ -c /dev/gpioled ]; then
+	check_out 5_gpioled $GPIO1_DR 3 $X/5_gpioled/app /dev/gpioled
+	bench led_toggle_byte $X/bench/led_toggle -d /dev/gpioled -m byte -n 100000
+else
+	fail 5_gpioled "insmod"
+fi
+unload 5_gpioled gpioled
+
+load 10_mutex mutex
+if [ -c /dev/gpioled ]; then
+	check_out 10_mutex $GPIO1_DR 3 $X/10_mutex/mutex_app /dev/gpioled
+	bench lock_open $X/bench/lock_stress -d /dev/gpioled -m open -t 4 -n 10000
+	bench lock_write $X/bench/lock_stress -d /dev/gpioled -m write -t 4 -n 10000
+else
+	fail 10_mutex "insmod"
+fi
+unload 10_mutex mutex
+
+test_node 12_timer /dev/timer timer
+
+#-------------------------------------------------------------------------------
+# 6、19：蜂鸣器
+#-------------------------------------------------------------------------------
+test_out 6_beep /dev/beep $GPIO5_DR 1 beep $X/6_beep/app
+test_out 19_miscbeep /dev/miscbeep $GPIO5_DR 1 miscbeep $X/19_miscbeep/miscbeep_app
+
+#-------------------------------------------------------------------------------
+# 11、13~16、20：按键
+#-------------------------------------------------------------------------------
+test_node 11_key /dev/key key
+test_node 13_irq /dev/keyirq key_irq
+test_node 14_blockio /dev/blockio blockio
+test_node 15_noblockio /dev/noblockio noblockio
+test_node 16_asyncnoti /dev/asyncnoti asyncnoti
+
+load 20_input keyinput
+if grep -qs keyinput /sys/class/input/*/name; then
+	pass 20_input
+else
+	fail 20_input "no input device"
+fi
+unload 20_input keyinput
+
+#-------------------------------------------------------------------------------
+# 21、22：传感器，由sim/emu下的模拟器提供总线和器件，没有模拟器时跳过
+#-------------------------------------------------------------------------------
+if [ -f $X/sim/emu/ap3216c_emu.ko ] && [ -f $X/sim/emu/icm20608_emu.ko ]; then
+	load sim/emu ap3216c_emu icm20608_emu
+	load 21_i2c ap3216c
+	load 22_spi icm20608
+
+	# 每条记录分别为short[3]和int[7]
+	[ "$(dd if=/dev/ap3216c bs=6 count=4 2>/dev/null | wc -c)" -eq 24 ] \
+		&& pass 21_i2c || fail 21_i2c "read"
+	[ "$(dd if=/dev/icm20608 bs=28 count=4 2>/dev/null | wc -c)" -eq 112 ] \
+		&& pass 22_spi || fail 22_spi "read"
+
+	# 采集守护进程：ICM20608 1ms、AP3216C 100ms，统计客户端2秒内收到的消息
+	$X/acqd/acqd -m /acqd -i /dev/icm20608:1 -a /dev/ap3216c:100 > /dev/null &
+	pid=$!
+	usleep 500000
+	cnt=$(timeout 2 $X/acqd/acqd_client -m /acqd | grep -c "^icm20608")
+	kill $pid
+	wait $pid 2> /dev/null
+	echo "BENCH acqd_shm: icm20608 messages in 2s = $cnt"
+	echo "BENCH emu: $(cat /sys/kernel/debug/icm20608-emu/samples) samples," \
+		"$(cat /sys/kernel/debug/icm20608-emu/skipped) skipped," \
+		"$(cat /sys/kernel/debug/ap3216c-emu/missed) ap3216c missed"
+	[ "$cnt" -gt 0 ] && pass "bench acqd_shm" || fail "bench acqd_shm" "no messages"
+
+	unload 22_spi icm20608
+	unload 21_i2c ap3216c
+	unload sim/emu ap3216c_emu icm20608_emu
+else
+	skip 21_i2c "no emulator"
+	skip 22_spi "no emulator"
+fi
+
+echo "SELFTEST pass=$PASS fail=$FAIL skip=$SKIP "
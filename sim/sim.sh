@@ -0,0 +1,93 @@
+#!/bin/sh
+################################################################################
+# @file			sim.sh
+# @brief		在QEMU(mcimx6ul-evk)中编译并运行全部驱动的功能和性能回归测试
+# @author		Xli
+# @email		xieliyzh@163.com
+# @version		1.0.0
+# @date			2020-06-08
+# @copyright	2020, EVECCA Co.,Ltd. All rights reserved
+#
+# 用法：sim/sim.sh [build|dtb|rootfs|run|all]，默认all
+#
+# 环境变量：
+#   KERNELDIR		开发板使用的内核源码树，需已编译出zImage
+#   CROSS_COMPILE	交叉编译器前缀，默认arm-linux-gnueabihf-
+#   BUSYBOX			静态链接的ARM busybox，用作initramfs
+#   QEMU			默认qemu-system-arm
+#   OUT				输出目录，默认sim/out
+#
+# 驱动和应用不做任何修改，按开发板的方式编译，在模拟的i.MX6UL上加载运行，
+# 测试脚本见selftest.sh，结果最后一行为"SELFTEST pass=N fail=N skip=N"，
+# 有失败时本脚本返回非0
+################################################################################
+
+set -e
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+KERNELDIR=${KERNELDIR:-/home/xieli/linux/linux_xli}
+CROSS_COMPILE=${CROSS_COMPILE:-arm-linux-gnueabihf-}
+QEMU=${QEMU:-qemu-system-arm}
+OUT=${OUT:-$TOP/sim/out}
+ROOT=$OUT/rootfs
+
+export ARCH=arm CROSS_COMPILE KERNELDIR
+
+# 驱动、应用和bench都由顶层Makefile编译，应用静态链接，安装到$ROOT/xli
+build()
+{
+	rm -rf "$ROOT/xli"
+	make -C "$TOP" -s -j"$(nproc)" O="$OUT/build" DESTDIR="$ROOT" LDFLAGS=-static install
+}
+
+dtb()
+{
+	mkdir -p "$OUT"
+	cpp -nostdinc -undef -D__DTS__ -x assembler-with-cpp \
+		-I "$KERNELDIR/arch/arm/boot/dts" -I "$KERNELDIR/include" \
+		"$TOP/sim/imx6ull-sim.dts" > "$OUT/imx6ull-sim.dts.tmp"
+	"$KERNELDIR/scripts/dtc/dtc" -I dts -O dtb -o "$OUT/imx6ull-sim.dtb" "$OUT/imx6ull-sim.dts.tmp"
+}
+
+rootfs()
+{
+	[ -x "$BUSYBOX" ] || { echo "BUSYBOX not set"; exit 1; }
+
+	mkdir -p "$ROOT/bin" "$ROOT/dev" "$ROOT/proc" "$ROOT/sys" "$ROOT/tmp" "$ROOT/dev/shm"
+	cp "$BUSYBOX" "$ROOT/bin/busybox"
+	cp "$TOP/sim/selftest.sh" "$ROOT/xli/selftest.sh"
+	cat > "$ROOT/init" <<-'EOF'
+	#!/bin/busybox sh
+	/bin/busybox --install -s /bin
+	export PATH=/bin
+	mount -t proc proc /proc
+	mount -t sysfs sysfs /sys
+	mount -t devtmpfs devtmpfs /dev
+	mkdir -p /dev/shm && mount -t tmpfs tmpfs /dev/shm
+	mount -t debugfs debugfs /sys/kernel/debug
+	sh /xli/selftest.sh
+	poweroff -f
+	EOF
+	chmod +x "$ROOT/init"
+	(cd "$ROOT" && find . | cpio -o -H newc --quiet | gzip -9) > "$OUT/initramfs.cpio.gz"
+}
+
+run()
+{
+	$QEMU -M mcimx6ul-evk -m 512M -nographic -no-reboot \
+		-kernel "$KERNELDIR/arch/arm/boot/zImage" \
+		-dtb "$OUT/imx6ull-sim.dtb" \
+		-initrd "$OUT/initramfs.cpio.gz" \
+		-append "console=ttymxc0,115200 rdinit=/init" | tee "$OUT/console.log"
+
+	grep -q "^SELFTEST .*fail=0 " "$OUT/console.log"
+}
+
+case "${1:-all}" in
+build)	build ;;
+dtb)	dtb ;;
+rootfs)	rootfs ;;
+run)	run ;;
+all)	build; dtb; rootfs; run ;;
+*)		echo "Usage: $0 [build|dtb|rootfs|run|all]"; exit 1 ;;
+esac
@@ -0,0 +1,226 @@
+/**
+  ******************************************************************************
+  * @file			decode_test.c
+  * @brief			驱动中与硬件无关代码的主机单元测试：AP3216C/ICM20608数据解析和按键状态机
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-14
+  * @copyright		2020, EVECCA Co.,Ltd. All rights reserved
+  *
+  * 与bench/decode_rate.c一样直接包含驱动使用的头文件，用固定的寄存器值检查输出，
+  * 全部通过返回0，否则打印失败的检查并返回1。由顶层Makefile的host目标编译运行：
+  * gcc -O2 -Wall decode_test.c -I../21_i2c -I../22_spi -I../20_input -o decode_test
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stdio.h"
+#include "limits.h"
+#include "ap3216c.h"
+#include "icm20608.h"
+#include "key_fsm.h"
+
+/* Private constants ---------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/**
+* @brief 检查一个整数结果，失败时打印位置和实际值，继续执行后面的检查
+*/
+#define CHECK_EQ(actual, expected) \
+	check_eq(__FILE__, __LINE__, #actual, (long)(actual), (long)(expected))
+
+/* Private typedef -----------------------------------------------------------*/
+/**
+* @brief 按键状态机的一步：输入电平和时间，期望的动作
+*/
+typedef struct {
+	int down;				/*!< 消抖后的电平 */
+	unsigned long now;		/*!< 时间 */
+	unsigned int act;		/*!< 期望的KEY_FSM_xxx */
+}fsm_step_t;
+
+/* Private variables ---------------------------------------------------------*/
+static int checks;		/*!< 检查次数 */
+static int failures;	/*!< 失败次数 */
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           比较一个结果
+ *
+ * @param[in]       file:源文件
+ * @param[in]		line:行号
+ * @param[in]		expr:表达式
+ * @param[in]		actual:实际值
+ * @param[in]		expected:期望值
+ *
+ * @return          none
+ *============================================================================*/
+static void check_eq(const char *file, int line, const char *expr, long actual, long expected)
+{
+	checks++;
+	if (actual != expected)
+	{
+		failures++;
+		printf("%s:%d: %s = %ld, expected %ld\r\n", file, line, expr, actual, expected);
+	}
+}
+
+/**=============================================================================
+ * @brief           AP3216C：10位IR/PS的拼接、无关位屏蔽和IR_OF
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void test_ap3216c(void)
+{
+	unsigned short out[3];
+
+	/* 全满量程：IR = 0xFF<<2 | 3，PS = 0x3F<<4 | 0xF */
+	const unsigned char full[6] = {0x03, 0xFF, 0x34, 0x12, 0x0F, 0x3F};
+	/* 低字节IR只取bit1:0，PS低字节只取bit3:0，PS高字节的bit7:6是标志位 */
+	const unsigned char flags[6] = {0x7E, 0x01, 0x00, 0x00, 0xF5, 0xC2};
+	/* IR_OF置位时IR和PS无效，ALS不受影响 */
+	const unsigned char overflow[6] = {0x83, 0xFF, 0x01, 0x00, 0x0F, 0x3F};
+	/* ALS为完整的16位，高字节在后 */
+	const unsigned char als[6] = {0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00};
+
+	ap3216c_decode(full, out);
+	CHECK_EQ(out[0], 1023);
+	CHECK_EQ(out[1], 0x1234);
+	CHECK_EQ(out[2], 1023);
+
+	ap3216c_decode(flags, out);
+	CHECK_EQ(out[0], (1 << 2) | 2);
+	CHECK_EQ(out[1], 0);
+	CHECK_EQ(out[2], (2 << 4) | 5);
+
+	ap3216c_decode(overflow, out);
+	CHECK_EQ(out[0], 0);
+	CHECK_EQ(out[1], 1);
+	CHECK_EQ(out[2], 0);
+
+	ap3216c_decode(als, out);
+	CHECK_EQ(out[0], 0);
+	CHECK_EQ(out[1], 65535);
+	CHECK_EQ(out[2], 0);
+}
+
+/**=============================================================================
+ * @brief           ICM20608：大端16位的符号扩展和通道顺序
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void test_icm20608(void)
+{
+	int rec[7];
+
+	/* 寄存器顺序ax ay az temp gx gy gz */
+	const unsigned char raw[14] = {
+		0x7F, 0xFF,		/*!< ax = 32767 */
+		0x80, 0x00,		/*!< ay = -32768 */
+		0xFF, 0xFF,		/*!< az = -1 */
+		0x01, 0x00,		/*!< temp = 256 */
+		0x00, 0x01,		/*!< gx = 1 */
+		0xFF, 0x38,		/*!< gy = -200 */
+		0x12, 0x34,		/*!< gz = 4660 */
+	};
+
+	icm20608_decode(raw, rec);
+	CHECK_EQ(rec[0], 1);
+	CHECK_EQ(rec[1], -200);
+	CHECK_EQ(rec[2], 4660);
+	CHECK_EQ(rec[3], 32767);
+	CHECK_EQ(rec[4], -32768);
+	CHECK_EQ(rec[5], -1);
+	CHECK_EQ(rec[6], 256);
+}
+
+/**=============================================================================
+ * @brief           从初始状态依次执行一组步骤
+ *
+ * @param[in]       name:序列名，失败时打印
+ * @param[in]		hold:长按时间
+ * @param[in]		steps:步骤
+ * @param[in]		cnt:步骤数
+ *
+ * @return          none
+ *============================================================================*/
+static void run_fsm(const char *name, unsigned long hold, const fsm_step_t *steps, int cnt)
+{
+	int i = 0;
+	int before = failures;
+	key_fsm_t fsm = {0};
+
+	for (i = 0; i < cnt; i++)
+	{
+		CHECK_EQ(key_fsm_step(&fsm, steps[i].down, steps[i].now, hold), steps[i].act);
+	}
+
+	if (failures != before)
+	{
+		printf("  in key_fsm sequence \"%s\"\r\n", name);
+	}
+}
+
+/**=============================================================================
+ * @brief           按键状态机：短按、长按、不检测长按、抖动和时间回绕
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void test_key_fsm(void)
+{
+	const fsm_step_t no_hold[] = {
+		{1, 0, KEY_FSM_PRESS},
+		{1, 500, 0},
+		{0, 600, KEY_FSM_RELEASE},
+	};
+	const fsm_step_t short_press[] = {
+		{1, 0, KEY_FSM_PRESS | KEY_FSM_REARM},
+		{0, 30, KEY_FSM_RELEASE},
+	};
+	const fsm_step_t long_press[] = {
+		{1, 0, KEY_FSM_PRESS | KEY_FSM_REARM},
+		{1, 50, KEY_FSM_REARM},				/*!< 抖动使定时器提前到期 */
+		{1, 100, KEY_FSM_LONG},
+		{1, 150, 0},						/*!< 长按只上报一次 */
+		{0, 200, KEY_FSM_LONG_UP | KEY_FSM_RELEASE},
+		{1, 300, KEY_FSM_PRESS | KEY_FSM_REARM},	/*!< 下一次按下重新计时 */
+		{0, 310, KEY_FSM_RELEASE},
+	};
+	const fsm_step_t wrap[] = {
+		{1, ULONG_MAX - 10, KEY_FSM_PRESS | KEY_FSM_REARM},
+		{1, ULONG_MAX, KEY_FSM_REARM},
+		{1, 88, KEY_FSM_REARM},
+		{1, 89, KEY_FSM_LONG},
+		{0, 90, KEY_FSM_LONG_UP | KEY_FSM_RELEASE},
+	};
+
+	run_fsm("no hold", 0, no_hold, sizeof(no_hold) / sizeof(no_hold[0]));
+	run_fsm("short press", 100, short_press, sizeof(short_press) / sizeof(short_press[0]));
+	run_fsm("long press", 100, long_press, sizeof(long_press) / sizeof(long_press[0]));
+	run_fsm("wrap", 100, wrap, sizeof(wrap) / sizeof(wrap[0]));
+}
+
+/**=============================================================================
+ * @brief           主程序
+ *
+ * @param[in]       none
+ *
+ * @return          0:全部通过;1:有失败
+ *============================================================================*/
+int main(void)
+{
+	test_ap3216c();
+	test_icm20608();
+	test_key_fsm();
+
+	printf("decode_test: %d checks, %d failed\r\n", checks, failures);
+
+	return failures ? 1 : 0;
+}